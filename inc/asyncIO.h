@@ -0,0 +1,75 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __ASYNCIO__H
+#define __ASYNCIO__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include <stdio.h>
+#include "CL/cl.h"
+#include "macros.h"
+
+/******************************************************************************
+* Buffer pools of an AsyncIO. Reads and writes draw on separate pools, so     *
+* that pending reads can never starve the writes that free the pipeline.     *
+******************************************************************************/
+#define IO_POOL_READ        0
+#define IO_POOL_WRITE       1
+
+/* Called once per request, from an I/O thread or the submitting thread; must not block */
+typedef void (*IoCallback)(void *arg, cl_uint buffer, size_t bytes, bool ok);
+
+struct AsyncIOState;
+
+/******************************************************************************
+* Whole file reads and writes from a pool of page aligned buffers. Built with*
+* USE_LIBURING, requests are submitted to an io_uring with the buffers       *
+* registered; without it, or if the ring can not be set up, a pool of I/O    *
+* threads serves them with stdio.                                             *
+******************************************************************************/
+typedef struct AsyncIO
+{
+    cl_uchar **buffers;
+    size_t bufferSize;
+    cl_uint numBuffers;
+    const char *backend;        /**< "io_uring" or "threads" */
+    size_t bytesRead;           /**< Completed transfers, updated by the I/O threads */
+    size_t bytesWritten;
+    struct AsyncIOState *state;
+} AsyncIO;
+
+bool createAsyncIO(cl_uint numReadBuffers, cl_uint numWriteBuffers, size_t bufferSize,
+                AsyncIO *aio);
+cl_uint acquireIoBuffer(AsyncIO *aio, cl_uint pool);
+void releaseIoBuffer(AsyncIO *aio, cl_uint buffer);
+bool submitFileRead(AsyncIO *aio, const char *filename, cl_uint buffer,
+                IoCallback callback, void *arg);
+bool submitFileWrite(AsyncIO *aio, const char *filename, cl_uint buffer, size_t bytes,
+                IoCallback callback, void *arg);
+void waitAsyncIO(AsyncIO *aio);
+void destroyAsyncIO(AsyncIO *aio);
+
+#endif
@@ -0,0 +1,39 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __BATCHFILTER__H
+#define __BATCHFILTER__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "medianFilter.h"
+#include "utils.h"
+
+bool runBatch(DeviceInfo *infoDeviceOcl, const char *batchInput, const char *outDir,
+                cl_uint filterSize, cl_uint bitWidth, cl_uint deviceNum, cl_int useLds,
+                cl_int usePacked, cl_uint numReaders, cl_uint numWriters, cl_uint prefetch,
+                cl_uint verify, cl_uint rawWidth, cl_uint rawHeight);
+
+#endif
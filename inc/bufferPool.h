@@ -0,0 +1,83 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __BUFFERPOOL__H
+#define __BUFFERPOOL__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "CL/cl.h"
+
+/* Host blocks below a page are aligned to a cache line, larger ones to a page */
+#define BUFFER_POOL_LINE_SIZE   64
+#define BUFFER_POOL_PAGE_SIZE   4096
+
+/* Kinds of blocks */
+#define POOL_HOST               0   /**< Aligned host memory */
+#define POOL_PINNED             1   /**< CL_MEM_ALLOC_HOST_PTR buffer, mapped while pooled */
+#define POOL_DEVICE             2   /**< Device buffer */
+#define POOL_KINDS              3
+
+/******************************************************************************
+* A block checked out of the pool. Its size is the size class of the request.*
+******************************************************************************/
+typedef struct PoolBlock
+{
+    cl_uchar *host;             /**< Host or mapped pointer, NULL for device blocks */
+    cl_mem mem;                 /**< Buffer of pinned and device blocks */
+    size_t size;
+    cl_uint kind;
+} PoolBlock;
+
+typedef struct BufferPoolStats
+{
+    cl_ulong requests;
+    cl_ulong hits;              /**< Requests served by a free block */
+    size_t bytesHeld;           /**< All blocks, free or checked out */
+    size_t bytesFree;
+    size_t peakBytesHeld;
+} BufferPoolStats;
+
+/* Free lists, hidden from C callers */
+struct BufferPoolState;
+
+typedef struct BufferPool
+{
+    cl_context ctx;             /**< NULL for a pool of host blocks only */
+    cl_command_queue queue;     /**< Maps and unmaps pinned blocks */
+    size_t maxFreeBytes;        /**< Free blocks beyond this are released, 0 keeps all */
+    struct BufferPoolState *state;
+} BufferPool;
+
+size_t getPoolSizeClass(size_t size);
+bool createBufferPool(cl_context ctx, cl_command_queue queue, size_t maxFreeBytes,
+                BufferPool *pool);
+bool acquirePoolBlock(BufferPool *pool, cl_uint kind, size_t size, PoolBlock *block);
+void releasePoolBlock(BufferPool *pool, PoolBlock *block);
+void getBufferPoolStats(const BufferPool *pool, BufferPoolStats *stats);
+void printBufferPoolStats(const BufferPoolStats *stats);
+void destroyBufferPool(BufferPool *pool);
+
+#endif
@@ -0,0 +1,62 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __CONTEXTPOOL__H
+#define __CONTEXTPOOL__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "CL/cl.h"
+#include "ipp.h"
+
+/******************************************************************************
+* Resources one caller uses exclusively while it holds the context            *
+******************************************************************************/
+typedef struct MedianContext
+{
+    cl_command_queue queue;
+    cl_kernel kernel;           /**< Instance with its own arguments */
+    cl_mem input;
+    cl_mem output;
+    Ipp8u *ippBuffer;
+} MedianContext;
+
+/* Lock-free free list of the contexts, hidden from C callers */
+struct ContextPoolState;
+
+typedef struct MedianContextPool
+{
+    MedianContext *contexts;
+    cl_uint numContexts;
+    struct ContextPoolState *state;
+} MedianContextPool;
+
+bool createMedianContextPool(cl_uint numContexts, MedianContextPool *pool);
+MedianContext *acquireMedianContext(const MedianContextPool *pool);
+void releaseMedianContext(const MedianContextPool *pool, MedianContext *context);
+cl_ulong getMedianContextPoolWaits(const MedianContextPool *pool);
+void destroyMedianContextPool(MedianContextPool *pool);
+
+#endif
@@ -0,0 +1,153 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __IMAGEIO__H
+#define __IMAGEIO__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include <stdio.h>
+#include "CL/cl.h"
+#include "macros.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/******************************************************************************
+* Memory mapping of a whole file, read only unless made by createMappedFile.  *
+* A borrowed file is a caller's buffer holding the file, e.g. read with      *
+* asyncIO.h; it is neither mapped nor freed here.                            *
+******************************************************************************/
+typedef struct MappedFile
+{
+    cl_uchar *data;
+    size_t size;
+    cl_int borrowed;
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+/******************************************************************************
+* Supported file formats, chosen by the file name extension                   *
+******************************************************************************/
+#define IMAGE_FORMAT_BMP    0       /**< Uncompressed 8, 24 or 32 bit BMP */
+#define IMAGE_FORMAT_PGM    1       /**< Binary (P5) PGM, 8 or 16 bit samples */
+#define IMAGE_FORMAT_RAW    2       /**< Headerless 8 or 16 bit little endian */
+#define IMAGE_FORMAT_TIFF   3       /**< Uncompressed TIFF, see tiffIO.h */
+#define IMAGE_FORMAT_Y4M    4       /**< YUV4MPEG2 video, see y4mIO.h */
+
+#define BMP_PALETTE_ENTRIES 256     /**< Entries indexed by 8 bit BMP pixels */
+
+/******************************************************************************
+* Image file decoded straight from its mapping. Rows are kept in file order:  *
+* bottom-up for BMP files (the order SDKBitMap uses), top-down otherwise.     *
+******************************************************************************/
+typedef struct MappedImage
+{
+    MappedFile file;
+    cl_uint format;             /**< IMAGE_FORMAT_* */
+    cl_uint width;
+    cl_uint height;
+    cl_uint bitsPerPixel;       /**< Bits of one pixel in the file */
+    cl_uint sampleBits;         /**< Significant bits of a sample, e.g. 12 */
+    cl_int bigEndian;           /**< 16 bit samples are big endian (PGM) */
+    cl_int topDown;             /**< First row in the file is the top row */
+    size_t rowStride;           /**< Bytes per file row, including padding */
+    const cl_uchar *pixels;     /**< First pixel row in the mapping */
+    cl_uchar palette[4 * BMP_PALETTE_ENTRIES];  /**< 8 bit BMP only, zero past its entries */
+} MappedImage;
+
+/******************************************************************************
+* Rows are encoded into page aligned staging buffers of about this size and  *
+* written with one call per buffer                                            *
+******************************************************************************/
+#define WRITE_BUFFER_SIZE   (4 << 20)
+#define WRITE_BUFFER_ALIGN  4096
+
+struct ImageWriterThread;
+
+/******************************************************************************
+* Single channel image written a strip of rows at a time straight from the   *
+* filter output. BMP files are 8 bit palettized gray, PGM and raw files keep *
+* 16 bit samples. With a background thread, a full staging buffer is written *
+* while the caller fills the other one.                                      *
+******************************************************************************/
+typedef struct ImageWriter
+{
+    FILE *fp;
+    cl_uint format;             /**< IMAGE_FORMAT_* */
+    cl_uint width;
+    cl_uint height;
+    cl_uint bitsPerPixel;       /**< Bits of one pixel in the file */
+    cl_uint sampleBits;         /**< Significant bits of the samples written */
+    cl_int topDown;             /**< Rows are given top row first */
+    long long headerSize;
+    size_t rowBytes;            /**< Bytes per file row, including padding */
+    cl_uint rowsWritten;
+    cl_uchar *staging[2];       /**< Encoded rows, page aligned */
+    cl_uint stagingRows;        /**< Capacity of a staging buffer in rows */
+    cl_uint active;             /**< Staging buffer being filled */
+    cl_uint stagedRows;
+    cl_uint firstStagedRow;     /**< File row of the first staged row */
+    struct ImageWriterThread *thread;   /**< NULL for synchronous writes */
+    bool failed;
+} ImageWriter;
+
+bool mapFile(const char *filename, MappedFile *file);
+bool createMappedFile(const char *filename, size_t size, MappedFile *file);
+void unmapFile(MappedFile *file);
+
+cl_uint getImageFormat(const char *filename);
+
+bool openBmp(const char *filename, MappedImage *image);
+bool openPgm(const char *filename, MappedImage *image);
+bool openRaw(const char *filename, cl_uint width, cl_uint height,
+                cl_uint bitsPerPixel, MappedImage *image);
+bool openImage(const char *filename, cl_uint rawWidth, cl_uint rawHeight,
+                cl_uint rawBits, MappedImage *image);
+bool openImageBuffer(const char *filename, const cl_uchar *data, size_t size,
+                cl_uint rawWidth, cl_uint rawHeight, cl_uint rawBits, MappedImage *image);
+bool decodeImageChannel(const MappedImage *image, cl_uint channel, cl_uchar *dst,
+                size_t dstPitch, cl_uint bitWidth);
+bool decodeImageRows(const MappedImage *image, cl_uint channel, cl_uint firstRow,
+                cl_uint numRows, cl_uchar *dst, size_t dstPitch, cl_uint bitWidth);
+void releaseImageRows(const MappedImage *image, cl_uint firstRow, cl_uint numRows);
+void closeImage(MappedImage *image);
+
+bool createImageWriter(const char *filename, cl_uint width, cl_uint height,
+                cl_uint sampleBits, cl_int topDown, cl_int background, ImageWriter *writer);
+bool writeImageRows(ImageWriter *writer, const cl_uchar *src, size_t srcPitch,
+                cl_uint numRows, cl_uint bitWidth);
+bool closeImageWriter(ImageWriter *writer);
+bool encodeImageFile(const char *filename, cl_uint width, cl_uint height,
+                cl_uint sampleBits, cl_int topDown, const cl_uchar *src, size_t srcPitch,
+                cl_uint bitWidth, cl_uchar *dst, size_t capacity, size_t *fileSize);
+
+#endif
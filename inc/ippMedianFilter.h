@@ -27,6 +27,7 @@
 
 #include "ipp.h"
 #include "CL\cl.h"
+#include "medianImage.h"
 
 bool initIppMedianFilter(cl_uint filterSize, cl_uint width, cl_uint height, cl_uint bitWidth,
                     Ipp8u** pBuffer);
@@ -34,4 +35,11 @@ bool initIppMedianFilter(cl_uint filterSize, cl_uint width, cl_uint height, cl_u
 bool runIppMedianFilter(cl_uchar *inputImg, cl_uint filterSize, cl_uchar *outputImg, cl_uint width, cl_uint height, cl_uint bitWidth,
                   Ipp8u* pBuffer);
 
+bool runIppMedianFilterPitched(const cl_uchar *inputImg, size_t inputPitch, cl_uint filterSize,
+                  cl_uchar *outputImg, size_t outputPitch, cl_uint width, cl_uint height,
+                  cl_uint bitWidth, Ipp8u* pBuffer);
+
+bool runIppMedianFilterImage(const MedianImage *src, const MedianImage *dst,
+                  cl_uint filterSize, Ipp8u* pBuffer);
+
 #endif  
@@ -0,0 +1,279 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __MEDIANCORE__H
+#define __MEDIANCORE__H
+
+/* Inline building blocks of the native engines, shared by cpuMedianFilter.cpp
+ * and the header-only medianFilterTemplate.h */
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "CL/cl.h"
+#include "medianImage.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/* Number of row pixels pushed through the sorting network together */
+#define CPU_MEDIAN_CHUNK 64
+
+/* Side of the square tiles of runCpuMedianFilterTiled */
+#define CPU_MEDIAN_TILE 64
+
+/* Smallest number of output pixels worth a thread of its own */
+#define CPU_MEDIAN_BLOCK_PIXELS (1 << 16)
+
+/***************************************************************************************
+* Sorting networks of medianFilter.cl; the median ends up in p[4] and p[12].
+* CMP(a, b) leaves the smaller of a and b in a.
+***************************************************************************************/
+#define MEDIAN_3_NETWORK(CMP, p) \
+    CMP(p[1], p[2]); CMP(p[4], p[5]); CMP(p[7], p[8]); CMP(p[0], p[1]); \
+    CMP(p[3], p[4]); CMP(p[6], p[7]); CMP(p[1], p[2]); CMP(p[4], p[5]); \
+    CMP(p[7], p[8]); CMP(p[0], p[3]); CMP(p[5], p[8]); CMP(p[4], p[7]); \
+    CMP(p[3], p[6]); CMP(p[1], p[4]); CMP(p[2], p[5]); CMP(p[4], p[7]); \
+    CMP(p[4], p[2]); CMP(p[6], p[4]); CMP(p[4], p[2]);
+
+#define MEDIAN_5_NETWORK(CMP, p) \
+    CMP(p[0], p[1]) ; CMP(p[3], p[4]) ; CMP(p[2], p[4]) ;       \
+    CMP(p[2], p[3]) ; CMP(p[6], p[7]) ; CMP(p[5], p[7]) ;       \
+    CMP(p[5], p[6]) ; CMP(p[9], p[10]) ; CMP(p[8], p[10]) ;     \
+    CMP(p[8], p[9]) ; CMP(p[12], p[13]) ; CMP(p[11], p[13]) ;   \
+    CMP(p[11], p[12]) ; CMP(p[15], p[16]) ; CMP(p[14], p[16]) ; \
+    CMP(p[14], p[15]) ; CMP(p[18], p[19]) ; CMP(p[17], p[19]) ; \
+    CMP(p[17], p[18]) ; CMP(p[21], p[22]) ; CMP(p[20], p[22]) ; \
+    CMP(p[20], p[21]) ; CMP(p[23], p[24]) ; CMP(p[2], p[5]) ;   \
+    CMP(p[3], p[6]) ; CMP(p[0], p[6]) ; CMP(p[0], p[3]) ;       \
+    CMP(p[4], p[7]) ; CMP(p[1], p[7]) ; CMP(p[1], p[4]) ;       \
+    CMP(p[11], p[14]) ; CMP(p[8], p[14]) ; CMP(p[8], p[11]) ;   \
+    CMP(p[12], p[15]) ; CMP(p[9], p[15]) ; CMP(p[9], p[12]) ;   \
+    CMP(p[13], p[16]) ; CMP(p[10], p[16]) ; CMP(p[10], p[13]) ; \
+    CMP(p[20], p[23]) ; CMP(p[17], p[23]) ; CMP(p[17], p[20]) ; \
+    CMP(p[21], p[24]) ; CMP(p[18], p[24]) ; CMP(p[18], p[21]) ; \
+    CMP(p[19], p[22]) ; CMP(p[8], p[17]) ; CMP(p[9], p[18]) ;   \
+    CMP(p[0], p[18]) ; CMP(p[0], p[9]) ; CMP(p[10], p[19]) ;    \
+    CMP(p[1], p[19]) ; CMP(p[1], p[10]) ; CMP(p[11], p[20]) ;   \
+    CMP(p[2], p[20]) ; CMP(p[2], p[11]) ; CMP(p[12], p[21]) ;   \
+    CMP(p[3], p[21]) ; CMP(p[3], p[12]) ; CMP(p[13], p[22]) ;   \
+    CMP(p[4], p[22]) ; CMP(p[4], p[13]) ; CMP(p[14], p[23]) ;   \
+    CMP(p[5], p[23]) ; CMP(p[5], p[14]) ; CMP(p[15], p[24]) ;   \
+    CMP(p[6], p[24]) ; CMP(p[6], p[15]) ; CMP(p[7], p[16]) ;    \
+    CMP(p[7], p[19]) ; CMP(p[13], p[21]) ; CMP(p[15], p[23]) ;  \
+    CMP(p[7], p[13]) ; CMP(p[7], p[15]) ; CMP(p[1], p[9]) ;     \
+    CMP(p[3], p[11]) ; CMP(p[5], p[17]) ; CMP(p[11], p[17]) ;   \
+    CMP(p[9], p[17]) ; CMP(p[4], p[10]) ; CMP(p[6], p[12]) ;    \
+    CMP(p[7], p[14]) ; CMP(p[4], p[6]) ; CMP(p[4], p[7]) ;      \
+    CMP(p[12], p[14]) ; CMP(p[10], p[14]) ; CMP(p[6], p[7]) ;   \
+    CMP(p[10], p[12]) ; CMP(p[6], p[10]) ; CMP(p[6], p[17]) ;   \
+    CMP(p[12], p[17]) ; CMP(p[7], p[17]) ; CMP(p[7], p[10]) ;   \
+    CMP(p[12], p[18]) ; CMP(p[7], p[12]) ; CMP(p[10], p[18]) ;  \
+    CMP(p[12], p[20]) ; CMP(p[10], p[20]) ; CMP(p[10], p[12]) ;
+
+/* Compare-exchange of window elements a and b for all pixels of a run. The
+ * elements never overlap, __restrict spares the compiler its alias checks. */
+template <typename T>
+inline void sortMedianRun(T *__restrict a, T *__restrict b)
+{
+    for (cl_uint i = 0; i < CPU_MEDIAN_CHUNK; i++)
+    {
+        T lo = std::min(a[i], b[i]);
+        b[i] = std::max(a[i], b[i]);
+        a[i] = lo;
+    }
+}
+
+#define MEDIAN_CMP_RUN(a, b) sortMedianRun<T>(a, b)
+
+/******************************************************************************
+* Puts the median of a KernelW x KernelH window in p[KernelW * KernelH / 2].  *
+* 3x3 and 5x5 use the networks of the kernels; other windows are sorted by   *
+* odd-even transposition, unrolled for their size by the compiler.           *
+******************************************************************************/
+template <typename T, cl_uint KernelW, cl_uint KernelH>
+struct MedianNetwork
+{
+    static inline void sort(T **p)
+    {
+        const cl_uint n = KernelW * KernelH;
+        for (cl_uint round = 0; round < n; round++)
+        {
+            for (cl_uint i = round & 1; i + 1 < n; i += 2)
+                MEDIAN_CMP_RUN(p[i], p[i + 1]);
+        }
+    }
+};
+
+template <typename T>
+struct MedianNetwork<T, 3, 3>
+{
+    static inline void sort(T **p)
+    {
+        MEDIAN_3_NETWORK(MEDIAN_CMP_RUN, p)
+    }
+};
+
+template <typename T>
+struct MedianNetwork<T, 5, 5>
+{
+    static inline void sort(T **p)
+    {
+        MEDIAN_5_NETWORK(MEDIAN_CMP_RUN, p)
+    }
+};
+
+#undef MEDIAN_CMP_RUN
+
+/**
+*******************************************************************************
+*  @fn     filterMedianRow
+*  @brief  Filters one output row. Window element (i, j) of a run of pixels 
+*          is a contiguous copy of input row i at offset j.
+*
+*  @param[in] rows     : KernelH padded input rows, each at its left border
+*  @param[out] out     : output row
+*  @param[in] width    : image width
+*  @param[in] window   : KernelW * KernelH runs of scratch
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint KernelW, cl_uint KernelH>
+inline void filterMedianRow(const T *const *rows, T *out, cl_uint width,
+                T (*window)[CPU_MEDIAN_CHUNK])
+{
+    T *p[KernelW * KernelH];
+    for (cl_uint k = 0; k < KernelW * KernelH; k++)
+        p[k] = window[k];
+
+    for (cl_uint col = 0; col < width; col += CPU_MEDIAN_CHUNK)
+    {
+        /* The last run is partial; the network still sorts all lanes */
+        cl_uint run = std::min((cl_uint)CPU_MEDIAN_CHUNK, width - col);
+        for (cl_uint i = 0; i < KernelH; i++)
+        {
+            for (cl_uint j = 0; j < KernelW; j++)
+                memcpy(window[i * KernelW + j], rows[i] + col + j, run * sizeof(T));
+        }
+
+        MedianNetwork<T, KernelW, KernelH>::sort(p);
+        memcpy(out + col, window[KernelW * KernelH / 2], run * sizeof(T));
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     filterMedianTiles
+*  @brief  Filters tiles [firstTile, endTile) in row-major tile order. Each
+*          tile is loaded with its halo into a contiguous block, bordered by
+*          the Border mode at the image edges, and filtered from there 
+*          straight into dst, so all rows of the window lie within a few KB
+*          however wide the image is.
+*
+*  @param[in] src        : source
+*  @param[in] dst        : destination of the same size
+*  @param[in] tileSize   : tile side in pixels
+*  @param[in] firstTile  : first tile
+*  @param[in] endTile    : tile after the last one
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint KernelW, cl_uint KernelH, cl_uint Border>
+void filterMedianTiles(const MedianImage *src, const MedianImage *dst, cl_uint tileSize,
+                cl_uint firstTile, cl_uint endTile)
+{
+    const cl_int radiusX = KernelW / 2;
+    const cl_int radiusY = KernelH / 2;
+    cl_uint tilesX = (src->width + tileSize - 1) / tileSize;
+    size_t blockPitch = tileSize + KernelW - 1;
+    std::vector<T> block(blockPitch * (tileSize + KernelH - 1));
+    T window[KernelW * KernelH][CPU_MEDIAN_CHUNK];
+    const T *rows[KernelH];
+    memset(window, 0, sizeof(window));
+
+    for (cl_uint tile = firstTile; tile < endTile; tile++)
+    {
+        cl_uint col = tile % tilesX * tileSize;
+        cl_uint row = tile / tilesX * tileSize;
+        cl_uint width = std::min(tileSize, src->width - col);
+        cl_uint height = std::min(tileSize, src->height - row);
+
+        copyMedianHalo<Border>(src, (cl_int)col - radiusX, (cl_int)row - radiusY,
+                        width + KernelW - 1, height + KernelH - 1, (cl_uchar *)&block[0],
+                        blockPitch);
+        for (cl_uint y = 0; y < height; y++)
+        {
+            for (cl_uint i = 0; i < KernelH; i++)
+                rows[i] = &block[(y + i) * blockPitch];
+            filterMedianRow<T, KernelW, KernelH>(rows,
+                            (T *)getMedianImagePixel(dst, col, row + y), width, window);
+        }
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     runMedianTiles
+*  @brief  Splits the tiles of the image into ranges, one per thread
+*
+*  @param[in] src         : source
+*  @param[in] dst         : destination of the same size
+*  @param[in] tileSize    : tile side in pixels
+*  @param[in] maxThreads  : number of threads available, at least 1
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint KernelW, cl_uint KernelH, cl_uint Border>
+void runMedianTiles(const MedianImage *src, const MedianImage *dst, cl_uint tileSize,
+                cl_uint maxThreads)
+{
+    cl_uint numTiles = ((src->width + tileSize - 1) / tileSize)
+                    * ((src->height + tileSize - 1) / tileSize);
+    size_t blocks = (size_t)src->width * src->height / CPU_MEDIAN_BLOCK_PIXELS;
+    cl_uint numThreads = (cl_uint)std::min((size_t)maxThreads, std::max(blocks, (size_t)1));
+    if (numThreads > numTiles)
+        numThreads = numTiles;
+    if (numThreads <= 1)
+    {
+        filterMedianTiles<T, KernelW, KernelH, Border>(src, dst, tileSize, 0, numTiles);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (cl_uint t = 0; t < numThreads; t++)
+    {
+        cl_uint firstTile = (cl_uint)((size_t)numTiles * t / numThreads);
+        cl_uint endTile = (cl_uint)((size_t)numTiles * (t + 1) / numThreads);
+        threads.push_back(std::thread(filterMedianTiles<T, KernelW, KernelH, Border>, src,
+                        dst, tileSize, firstTile, endTile));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+#endif
@@ -30,6 +30,7 @@
  ******************************************************************************/
 #include "macros.h"
 #include "CL/cl.h"
+#include "medianImage.h"
 
 #define MEDIANFILTER_KERNEL_SOURCE  "medianFilter.cl"
 #define MEDIANFILTER_KERNEL_3x3     "medianFilter3"
@@ -39,14 +40,74 @@
 #define LOCAL_YRES  16
 
 #define MEDIANFILTER_KERNEL "medianFilter"
+#define MEDIANFILTER_KERNEL_CPU "medianFilterCpu"
+#define MEDIANFILTER_KERNEL_PACKED "medianFilterPacked"
 
+/* Number of 8 bit output pixels packed into one work-item by the packed kernel */
+#define PACKED_PIXELS 4
+
+/* Number of consecutive row pixels filtered by one work-item of the CPU kernel */
+#define CPU_SEGMENT 256
+
+/******************************************************************************
+* Compile time configuration of the median filter kernel                      *
+******************************************************************************/
+typedef struct MedianKernelConfig
+{
+    cl_uint filtSize;
+    cl_uint bitWidth;
+    cl_int useLds;
+    cl_device_type deviceType;
+
+    /* 8 bit GPU kernels process PACKED_PIXELS outputs per work-item */
+    cl_int usePacked;
+
+    /* When fixedWidth is non-zero the dimensions and the pitch are baked  
+     * into the program instead of being read from the kernel arguments */
+    cl_uint fixedWidth;
+    cl_uint fixedHeight;
+    cl_uint fixedPitch;
+
+    /* Fixed resolution programs are cached as binaries in the working directory */
+    cl_int cacheBinary;
+} MedianKernelConfig;
+
+/******************************************************************************
+* Layout of the kernel output. Pixel (row, col) is written to                 *
+* output[offset + row * pitch + col]. A non-zero halo means the output is     *
+* padded and the kernel fills the halo according to border.                   *
+******************************************************************************/
+#define OUT_BORDER_NONE         0   /* must match OUT_BORDER_* in the kernel */
+#define OUT_BORDER_ZERO         1
+#define OUT_BORDER_REPLICATE    2
+
+typedef struct MedianOutputLayout
+{
+    cl_uint pitch;
+    cl_uint offset;
+    cl_uint border;
+    cl_uint halo;
+} MedianOutputLayout;
+
+void initMedianOutputLayout(MedianOutputLayout *layout, cl_uint width,
+                cl_uint halo, cl_uint border);
 bool buildMedianFilterKernel(cl_context oclCtx, cl_device_id oclDevice,
-                cl_kernel *medianFilterKernel, cl_uint filtSize,
-                cl_uint bitWidth, cl_int useLds);
+                cl_kernel *medianFilterKernel, const MedianKernelConfig *config);
+bool createMedianFilterKernelInstance(cl_kernel medianFilter, cl_kernel *instance);
+void printMedianFilterKernelInfo(cl_kernel medianFilter, cl_device_id oclDevice);
 bool setMedianFilterKernelArgs(cl_kernel medianFilter, cl_mem input,
                 cl_mem output, cl_uint width, cl_uint height,
-                cl_uint paddedWidth);
+                cl_uint paddedWidth, const MedianOutputLayout *outLayout);
+bool setMedianFilterKernelIoArgs(cl_kernel medianFilter, cl_mem input,
+                cl_mem output, const MedianOutputLayout *outLayout);
 bool runMedianFilterKernel(cl_command_queue oclQueue, cl_kernel medianFilter,
-                cl_uint width, cl_uint height, cl_event *ev);
+                cl_uint width, cl_uint height, const MedianKernelConfig *config,
+                cl_event *ev);
+bool enqueueMedianFilterImage(cl_command_queue oclQueue, cl_kernel medianFilter,
+                cl_mem input, cl_mem output, const MedianImage *src, const MedianImage *dst,
+                const MedianKernelConfig *config, cl_event *ev);
+bool enqueueMedianBorder(cl_command_queue oclQueue, cl_mem buffer,
+                const MedianOutputLayout *layout, cl_uint width, cl_uint height,
+                cl_uint bitWidth, cl_uint mode, cl_uint value);
 
 #endif  
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __MEDIANFILTERTEMPLATE__H
+#define __MEDIANFILTERTEMPLATE__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "CL/cl.h"
+#include "medianCore.h"
+#include <stdio.h>
+#include <thread>
+
+namespace median
+{
+
+/******************************************************************************
+* Median filter with its pixel type, window and border mode fixed at compile *
+* time. run() filters the ROI of a MedianImage into another like            *
+* runCpuMedianFilterTiled, through the same inline tile loop, on all        *
+* hardware threads. Neighbours are read from the halo of the source; beyond *
+* it they follow Border, the borderMode of the source is not consulted.     *
+* Everything is inline, no source file of the sample needs to be linked.    *
+******************************************************************************/
+template <typename PixelT, cl_uint KernelW, cl_uint KernelH, cl_uint Border>
+class MedianFilter
+{
+public:
+    static const cl_uint BIT_WIDTH = sizeof(PixelT) * 8;
+
+    static_assert(sizeof(PixelT) == 1 || sizeof(PixelT) == 2, "8 or 16 bit pixels only");
+    static_assert((KernelW & 1) && (KernelH & 1), "Kernel sides must be odd");
+    static_assert(Border <= MEDIAN_BORDER_WRAP, "Unknown border mode");
+
+    /**
+    ***************************************************************************
+    *  @fn     run
+    *  @brief  Filters the ROI of src into the ROI of dst
+    *
+    *  @param[in] src  : source, padded or not
+    *  @param[in] dst  : destination of the same size
+    *
+    *  @return bool : true if successful; otherwise false.
+    ***************************************************************************
+    */
+    static bool run(const MedianImage *src, const MedianImage *dst)
+    {
+        if (src->width != dst->width || src->height != dst->height)
+        {
+            printf("Source %dx%d and destination %dx%d differ in size\n", src->width,
+                            src->height, dst->width, dst->height);
+            return false;
+        }
+        if (src->bitWidth != BIT_WIDTH || dst->bitWidth != BIT_WIDTH)
+        {
+            printf("Images are not %d bit\n", BIT_WIDTH);
+            return false;
+        }
+        if (src->width == 0 || src->height == 0)
+            return true;
+
+        cl_uint numThreads = std::thread::hardware_concurrency();
+        runMedianTiles<PixelT, KernelW, KernelH, Border>(src, dst, CPU_MEDIAN_TILE,
+                        numThreads ? numThreads : 1);
+        return true;
+    }
+};
+
+/* An instantiation of MedianFilter<...>::run */
+typedef bool (*MedianFilterFn)(const MedianImage *src, const MedianImage *dst);
+
+/******************************************************************************
+* The instantiations for one pixel type and window, one per border mode.     *
+* Looked up once, e.g. per plan, so executions only index it by the border   *
+* mode of their source.                                                       *
+******************************************************************************/
+typedef struct MedianFilterTable
+{
+    MedianFilterFn run[MEDIAN_BORDER_WRAP + 1];     /**< By MEDIAN_BORDER_* */
+} MedianFilterTable;
+
+#define MEDIAN_TEMPLATE_BORDERS(T, W, H) \
+    { { &MedianFilter<T, W, H, MEDIAN_BORDER_CONSTANT>::run,    \
+        &MedianFilter<T, W, H, MEDIAN_BORDER_REPLICATE>::run,   \
+        &MedianFilter<T, W, H, MEDIAN_BORDER_REFLECT_101>::run, \
+        &MedianFilter<T, W, H, MEDIAN_BORDER_WRAP>::run } }
+
+/**
+*******************************************************************************
+*  @fn     getFilterTable
+*  @brief  Maps runtime parameters onto the compiled instantiations. 8 and 16
+*          bit pixels with 3 or 5 pixel wide and high windows are compiled.
+*
+*  @param[in] bitWidth  : 8 or 16
+*  @param[in] kernelW   : window width, 3 or 5
+*  @param[in] kernelH   : window height, 3 or 5
+*  @param[out] table    : instantiations by border mode
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+inline bool getFilterTable(cl_uint bitWidth, cl_uint kernelW, cl_uint kernelH,
+                MedianFilterTable *table)
+{
+    /* By [16 bit][kernelH == 5][kernelW == 5] */
+    static const MedianFilterTable tables[2][2][2] =
+    {
+        {
+            { MEDIAN_TEMPLATE_BORDERS(cl_uchar, 3, 3), MEDIAN_TEMPLATE_BORDERS(cl_uchar, 5, 3) },
+            { MEDIAN_TEMPLATE_BORDERS(cl_uchar, 3, 5), MEDIAN_TEMPLATE_BORDERS(cl_uchar, 5, 5) }
+        },
+        {
+            { MEDIAN_TEMPLATE_BORDERS(cl_ushort, 3, 3), MEDIAN_TEMPLATE_BORDERS(cl_ushort, 5, 3) },
+            { MEDIAN_TEMPLATE_BORDERS(cl_ushort, 3, 5), MEDIAN_TEMPLATE_BORDERS(cl_ushort, 5, 5) }
+        }
+    };
+
+    if (!(bitWidth == 8 || bitWidth == 16))
+    {
+        printf("Un-supported bitWidth, only 8 and 16 bits are supported\n");
+        return false;
+    }
+    if (!(kernelW == 3 || kernelW == 5) || !(kernelH == 3 || kernelH == 5))
+    {
+        printf("Unsupported window %dx%d, only 3 and 5 are supported\n", kernelW, kernelH);
+        return false;
+    }
+    *table = tables[bitWidth == 16][kernelH == 5][kernelW == 5];
+    return true;
+}
+
+#undef MEDIAN_TEMPLATE_BORDERS
+
+}
+
+#endif
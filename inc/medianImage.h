@@ -0,0 +1,233 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __MEDIANIMAGE__H
+#define __MEDIANIMAGE__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "CL/cl.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Neighbours beyond the ROI and halo of a source */
+#define MEDIAN_BORDER_CONSTANT      0   /**< borderValue, 0 by default */
+#define MEDIAN_BORDER_REPLICATE     1   /**< aaa|abcd|ddd */
+#define MEDIAN_BORDER_REFLECT_101   2   /**< dcb|abcd|cba */
+#define MEDIAN_BORDER_WRAP          3   /**< bcd|abcd|abc */
+
+/******************************************************************************
+* A region of interest inside a caller's buffer. Pixel (col, row) of the ROI  *
+* is data[(y + row) * pitch + x + col]. The halo extents are the pixels      *
+* around the ROI that belong to the buffer and may be read as neighbours.    *
+* Views of a sub-rectangle share the buffer; nothing is copied. Neighbours   *
+* beyond the halo, e.g. around an unpadded image, follow the border mode,    *
+* applied to the ROI and halo as a whole.                                    *
+******************************************************************************/
+typedef struct MedianImage
+{
+    cl_uchar *data;             /**< Base of the buffer */
+    size_t pitch;               /**< Row pitch in pixels */
+    cl_uint bitWidth;           /**< 8 or 16 bit samples */
+    cl_uint x;                  /**< ROI offset in pixels */
+    cl_uint y;
+    cl_uint width;              /**< ROI size */
+    cl_uint height;
+    cl_uint haloLeft;
+    cl_uint haloTop;
+    cl_uint haloRight;
+    cl_uint haloBottom;
+    cl_uint borderMode;         /**< MEDIAN_BORDER_* */
+    cl_uint borderValue;        /**< Constant border pixel */
+} MedianImage;
+
+void initMedianImage(MedianImage *image, cl_uchar *data, cl_uint width, cl_uint height,
+                size_t pitch, cl_uint bitWidth);
+void initPaddedMedianImage(MedianImage *image, cl_uchar *data, cl_uint width,
+                cl_uint height, size_t pitch, cl_uint bitWidth, cl_uint border);
+bool getMedianImageView(const MedianImage *image, cl_uint x, cl_uint y, cl_uint width,
+                cl_uint height, MedianImage *view);
+void setMedianImageBorder(MedianImage *image, cl_uint mode, cl_uint value);
+bool checkMedianImages(const MedianImage *src, const MedianImage *dst, cl_uint filterSize);
+bool overlapMedianImages(const MedianImage *src, const MedianImage *dst, cl_uint filterSize);
+void fillMedianHalo(const MedianImage *image, cl_int col, cl_int row, cl_uint width,
+                cl_uint height, cl_uchar *out, size_t outPitch);
+void fillMedianImageBorder(const MedianImage *image);
+
+/**
+*******************************************************************************
+*  @fn     getMedianImagePixel
+*  @brief  Address of a pixel relative to the ROI; negative or past-the-end
+*          coordinates address the halo
+*
+*  @param[in] image  : image
+*  @param[in] col    : column relative to the ROI
+*  @param[in] row    : row relative to the ROI
+*
+*  @return cl_uchar* : pixel address
+*******************************************************************************
+*/
+inline cl_uchar *getMedianImagePixel(const MedianImage *image, cl_int col, cl_int row)
+{
+    ptrdiff_t offset = ((ptrdiff_t)image->y + row) * (ptrdiff_t)image->pitch
+                    + (ptrdiff_t)image->x + col;
+    return image->data + offset * (ptrdiff_t)(image->bitWidth / 8);
+}
+
+/**
+*******************************************************************************
+*  @fn     mapMedianBorderT
+*  @brief  Maps a coordinate outside 0..size-1 to the pixel the border mode
+*          takes from inside. The mode is a compile time constant.
+*
+*  @param[in] coord  : coordinate, may be outside
+*  @param[in] size   : extent, at least 1
+*
+*  @return cl_int : coordinate inside, or -1 for a constant border pixel
+*******************************************************************************
+*/
+template <cl_uint Border>
+inline cl_int mapMedianBorderT(cl_int coord, cl_int size)
+{
+    if (coord >= 0 && coord < size)
+        return coord;
+    if (Border == MEDIAN_BORDER_REPLICATE)
+        return (coord < 0) ? 0 : size - 1;
+    if (Border == MEDIAN_BORDER_REFLECT_101)
+    {
+        if (size == 1)
+            return 0;
+        cl_int period = 2 * size - 2;
+        coord %= period;
+        if (coord < 0)
+            coord += period;
+        return (coord < size) ? coord : period - coord;
+    }
+    if (Border == MEDIAN_BORDER_WRAP)
+    {
+        coord %= size;
+        return (coord < 0) ? coord + size : coord;
+    }
+    return -1;
+}
+
+/**
+*******************************************************************************
+*  @fn     mapMedianBorder
+*  @brief  mapMedianBorderT for a mode chosen at run time
+*
+*  @param[in] coord  : coordinate, may be outside
+*  @param[in] size   : extent, at least 1
+*  @param[in] mode   : MEDIAN_BORDER_*
+*
+*  @return cl_int : coordinate inside, or -1 for a constant border pixel
+*******************************************************************************
+*/
+inline cl_int mapMedianBorder(cl_int coord, cl_int size, cl_uint mode)
+{
+    switch (mode)
+    {
+    case MEDIAN_BORDER_REPLICATE:
+        return mapMedianBorderT<MEDIAN_BORDER_REPLICATE>(coord, size);
+    case MEDIAN_BORDER_REFLECT_101:
+        return mapMedianBorderT<MEDIAN_BORDER_REFLECT_101>(coord, size);
+    case MEDIAN_BORDER_WRAP:
+        return mapMedianBorderT<MEDIAN_BORDER_WRAP>(coord, size);
+    default:
+        return mapMedianBorderT<MEDIAN_BORDER_CONSTANT>(coord, size);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     copyMedianHalo
+*  @brief  fillMedianHalo with the border mode a compile time constant; the
+*          borderMode of the image is not consulted
+*
+*  @param[in] image     : image
+*  @param[in] col       : left column relative to the ROI
+*  @param[in] row       : top row relative to the ROI
+*  @param[in] width     : rectangle width
+*  @param[in] height    : rectangle height
+*  @param[out] out      : width x height pixels
+*  @param[in] outPitch  : row pitch of out in pixels
+*
+*  @return void
+*******************************************************************************
+*/
+template <cl_uint Border>
+inline void copyMedianHalo(const MedianImage *image, cl_int col, cl_int row, cl_uint width,
+                cl_uint height, cl_uchar *out, size_t outPitch)
+{
+    size_t bytesPerPixel = image->bitWidth / 8;
+    cl_int left = -(cl_int)image->haloLeft;
+    cl_int right = (cl_int)(image->width + image->haloRight);
+    cl_int top = -(cl_int)image->haloTop;
+    cl_int bottom = (cl_int)(image->height + image->haloBottom);
+    cl_int x0 = (col > left) ? col : left;
+    cl_int x1 = (col + (cl_int)width < right) ? col + (cl_int)width : right;
+    cl_uchar value8 = (cl_uchar)image->borderValue;
+    cl_ushort value16 = (cl_ushort)image->borderValue;
+    const cl_uchar *value = (bytesPerPixel == 1) ? &value8 : (const cl_uchar *)&value16;
+
+    for (cl_uint i = 0; i < height; i++)
+    {
+        cl_uchar *dst = out + i * outPitch * bytesPerPixel;
+        cl_int y = mapMedianBorderT<Border>(row + (cl_int)i - top, bottom - top);
+        if (y < 0)
+        {
+            for (cl_uint j = 0; j < width; j++)
+                memcpy(dst + j * bytesPerPixel, value, bytesPerPixel);
+            continue;
+        }
+        y += top;
+
+        /* Pixels inside the extent are copied at once, only the border is mapped */
+        if (x0 < x1)
+            memcpy(dst + (x0 - col) * bytesPerPixel, getMedianImagePixel(image, x0, y),
+                            (x1 - x0) * bytesPerPixel);
+        for (cl_uint j = 0; j < width; j++)
+        {
+            cl_int x = col + (cl_int)j;
+            if (x0 < x1 && x == x0)
+            {
+                j += x1 - x0 - 1;
+                continue;
+            }
+            x = mapMedianBorderT<Border>(x - left, right - left);
+            memcpy(dst + j * bytesPerPixel,
+                            (x < 0) ? value : getMedianImagePixel(image, x + left, y),
+                            bytesPerPixel);
+        }
+    }
+}
+
+/* Filters a source with a full filterSize / 2 halo into a destination */
+typedef bool (*MedianRegionFilter)(const MedianImage *src, const MedianImage *dst,
+                cl_uint filterSize, void *arg);
+bool runMedianFilterRegions(const MedianImage *src, const MedianImage *dst,
+                cl_uint filterSize, MedianRegionFilter filter, void *arg);
+
+#endif
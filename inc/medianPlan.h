@@ -0,0 +1,83 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __MEDIANPLAN__H
+#define __MEDIANPLAN__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "medianFilter.h"
+#include "ippMedianFilter.h"
+#include "contextPool.h"
+#include "medianFilterTemplate.h"
+#include "utils.h"
+
+/* Sample types, equal to the bit width used throughout the sample */
+#define MEDIAN_TYPE_8U          8
+#define MEDIAN_TYPE_16U         16
+
+#define MEDIAN_ENGINE_OPENCL    0
+#define MEDIAN_ENGINE_IPP       1
+#define MEDIAN_ENGINE_CPU       2
+#define MEDIAN_ENGINE_CPU_TILED 3   /**< cpu engine over cache sized tiles */
+#define MEDIAN_ENGINE_TEMPLATE  4   /**< median::MedianFilter instantiations */
+
+/* Options of the OpenCL engine, none by default */
+#define MEDIAN_PLAN_FIXED_RES   0x1 /**< Compile the resolution into the program */
+#define MEDIAN_PLAN_PACKED      0x2 /**< Packed kernel for 8 bit images on GPUs */
+
+/******************************************************************************
+* A median filter for one image geometry. Kernels, device buffers and ipp     *
+* scratch are created with the plan and reused by every execution. Each      *
+* context of the pool has its own set, so as many threads as there are       *
+* contexts execute the plan concurrently.                                    *
+******************************************************************************/
+typedef struct MedianPlan
+{
+    cl_uint width;
+    cl_uint height;
+    cl_uint pitch;              /**< Row pitch of the padded source of executeMedianPlan */
+    cl_uint type;               /**< MEDIAN_TYPE_* */
+    cl_uint filterSize;
+    cl_uint engine;             /**< MEDIAN_ENGINE_* */
+
+    DeviceInfo *device;         /**< OpenCL engine: initialized context */
+    MedianKernelConfig config;
+    cl_kernel kernel;           /**< Built kernel the contexts are instances of */
+    median::MedianFilterTable filters;  /**< Template engine: run by border mode */
+
+    MedianContextPool pool;
+} MedianPlan;
+
+bool createMedianPlan(cl_uint width, cl_uint height, cl_uint pitch, cl_uint type,
+                cl_uint filterSize, cl_uint engine, cl_uint numContexts, cl_uint flags,
+                DeviceInfo *infoDeviceOcl, MedianPlan *plan);
+bool executeMedianPlan(const MedianPlan *plan, const cl_uchar *src, cl_uchar *dst);
+bool executeMedianPlanImage(const MedianPlan *plan, const MedianImage *src,
+                const MedianImage *dst);
+void destroyMedianPlan(MedianPlan *plan);
+const char *getMedianEngineName(cl_uint engine);
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __TIFFIO__H
+#define __TIFFIO__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "imageIO.h"
+
+/******************************************************************************
+* Uncompressed, chunky TIFF file decoded straight from its mapping. A chunk   *
+* is a tile of tiled files or a strip of striped files; strips are handled as *
+* tiles of full image width.                                                  *
+******************************************************************************/
+typedef struct TiffImage
+{
+    MappedFile file;
+    cl_int bigEndian;           /**< "MM" byte order */
+    cl_uint width;
+    cl_uint height;
+    cl_uint bitsPerSample;      /**< 8 or 16 */
+    cl_uint samplesPerPixel;
+    cl_int tiled;
+    cl_uint chunkWidth;         /**< Tile width, or image width for strips */
+    cl_uint chunkHeight;        /**< Tile length, or rows per strip */
+    cl_uint chunksAcross;
+    cl_uint chunksDown;
+    size_t *chunkOffsets;       /**< File offset of each chunk, row major */
+} TiffImage;
+
+/******************************************************************************
+* Little endian, single sample TIFF with the chunk layout of its input. The   *
+* file is created at its final size and mapped, so chunks can be written by  *
+* several threads at once.                                                    *
+******************************************************************************/
+typedef struct TiffWriter
+{
+    MappedFile file;
+    cl_uint width;
+    cl_uint height;
+    cl_uint bitsPerSample;      /**< 8 or 16 */
+    cl_int tiled;
+    cl_uint chunkWidth;
+    cl_uint chunkHeight;
+    cl_uint chunksAcross;
+    cl_uint chunksDown;
+    size_t dataOffset;          /**< File offset of the first chunk */
+    size_t chunkBytes;          /**< Bytes reserved per chunk */
+} TiffWriter;
+
+bool openTiff(const char *filename, TiffImage *tiff);
+bool decodeTiffRegion(const TiffImage *tiff, cl_uint channel, cl_uint x0, cl_uint y0,
+                cl_uint width, cl_uint height, cl_uchar *dst, size_t dstPitch,
+                cl_uint bitWidth);
+void closeTiff(TiffImage *tiff);
+
+bool createTiffWriter(const char *filename, cl_uint width, cl_uint height,
+                cl_uint bitsPerSample, cl_int tiled, cl_uint chunkWidth,
+                cl_uint chunkHeight, TiffWriter *writer);
+bool writeTiffChunk(TiffWriter *writer, cl_uint chunkX, cl_uint chunkY,
+                const cl_uchar *src, size_t srcPitch, cl_uint bitWidth);
+bool closeTiffWriter(TiffWriter *writer);
+
+#endif
@@ -35,14 +35,22 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifdef _WIN32
 #include <windows.h>
+#include <psapi.h>
 #elif defined __MACH__
 #include <mach/mach_time.h>
+#include <sys/resource.h>
+#include <unistd.h>
 #else
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <linux/limits.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 
+/* Transparent huge page size of x86-64 Linux */
+#define HUGE_PAGE_SIZE (2 << 20)
+
 /******************************************************************************
 * Timer structure                                                             *
 ******************************************************************************/
@@ -62,12 +70,19 @@ typedef struct DeviceInfo
 {
     cl_platform_id mPlatform;
     cl_device_id mDevice;
+    cl_device_type mDeviceType;
     cl_context mCtx;
     cl_command_queue mQueue;
 } DeviceInfo;
 
 void timerStart(timer* mytimer);
 double timerCurrent(timer* mytimer);
+size_t getPeakRss();
+cl_uint getNumCpus();
+void *alignedMalloc(size_t size, size_t alignment);
+void alignedFree(void *ptr);
+void *hugePageMalloc(size_t size);
+size_t getHugePageRss();
 bool initOpenCl(DeviceInfo *infoDeviceOcl, cl_uint deviceNum);
 
 #endif
\ No newline at end of file
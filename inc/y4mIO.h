@@ -0,0 +1,62 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+#ifndef __Y4MIO__H
+#define __Y4MIO__H
+
+/*****************************************************************************
+ * Include files                                                              *
+ ******************************************************************************/
+#include "imageIO.h"
+
+#define Y4M_MAX_PLANES      3
+#define Y4M_MAX_HEADER      256
+
+/******************************************************************************
+* YUV4MPEG2 stream of planar frames: 4:2:0, 4:2:2, 4:4:4 or mono, with 8 bit *
+* samples or 9 to 16 bit little endian samples. Frames are read and written  *
+* sequentially, so pipes work as well as files.                              *
+******************************************************************************/
+typedef struct Y4mStream
+{
+    FILE *fp;
+    cl_uint width;
+    cl_uint height;
+    cl_uint numPlanes;          /**< 3, or 1 for mono */
+    cl_uint planeWidth[Y4M_MAX_PLANES];
+    cl_uint planeHeight[Y4M_MAX_PLANES];
+    cl_uint sampleBits;         /**< 8 to 16 */
+    cl_uint bytesPerSample;     /**< 1 or 2 */
+    char header[Y4M_MAX_HEADER];    /**< Stream header line, copied to outputs */
+} Y4mStream;
+
+bool openY4m(const char *filename, Y4mStream *y4m);
+bool readY4mFrame(Y4mStream *y4m, cl_uchar *planes[Y4M_MAX_PLANES],
+                const cl_uint pitches[Y4M_MAX_PLANES], bool *endOfStream);
+bool createY4mWriter(const char *filename, const Y4mStream *format, Y4mStream *writer);
+bool writeY4mFrame(Y4mStream *writer, cl_uchar *planes[Y4M_MAX_PLANES],
+                const cl_uint pitches[Y4M_MAX_PLANES]);
+bool closeY4m(Y4mStream *y4m);
+
+#endif
@@ -0,0 +1,556 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <asyncIO.cpp>
+*
+* @brief Asynchronous whole file reads and writes for the batch pipeline, on
+*        io_uring when built with USE_LIBURING and on a pool of I/O threads
+*        otherwise.
+*
+********************************************************************************
+*/
+#include "asyncIO.h"
+#include "utils.h"
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef USE_LIBURING
+#include <liburing.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define IO_BUFFER_ALIGN     4096
+#define IO_MAX_THREADS      16
+#define IO_MAX_CHUNK        (1u << 30)  /**< Largest single ring operation */
+
+typedef struct IoRequest
+{
+    bool write;
+    std::string filename;
+    cl_uint buffer;
+    size_t bytes;               /**< Bytes to transfer */
+    size_t done;                /**< Bytes transferred so far */
+    int fd;
+    IoCallback callback;
+    void *arg;
+} IoRequest;
+
+struct AsyncIOState
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<cl_uint> freeBuffers[2];
+    std::vector<cl_uint> bufferPool;    /**< Pool of each buffer */
+    cl_uint pending;                    /**< Submitted, not yet completed requests */
+    bool stop;
+    std::deque<IoRequest *> queue;      /**< Requests for the I/O threads */
+    std::vector<std::thread> threads;
+#ifdef USE_LIBURING
+    bool useRing;
+    bool registered;                    /**< Buffers are registered with the ring */
+    struct io_uring ring;
+    std::mutex ringLock;                /**< Serializes submissions */
+#endif
+};
+
+/**
+*******************************************************************************
+*  @fn     completeRequest
+*  @brief  Reports a finished request to its caller and retires it
+*
+*  @param[in/out] aio  : I/O context
+*  @param[in] request  : finished request
+*  @param[in] ok       : the whole transfer succeeded
+*
+*  @return void
+*******************************************************************************
+*/
+static void completeRequest(AsyncIO *aio, IoRequest *request, bool ok)
+{
+    AsyncIOState *state = aio->state;
+#ifdef USE_LIBURING
+    if (request->fd >= 0)
+        close(request->fd);
+#endif
+    if (!ok)
+        printf("Unable to %s %s\n", request->write ? "write" : "read", request->filename.c_str());
+
+    request->callback(request->arg, request->buffer, request->done, ok);
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (ok && request->write)
+            aio->bytesWritten += request->done;
+        else if (ok)
+            aio->bytesRead += request->done;
+        state->pending--;
+        state->cond.notify_all();
+    }
+    delete request;
+}
+
+/**
+*******************************************************************************
+*  @fn     ioThread
+*  @brief  Serves queued requests with blocking stdio calls until the 
+*          context is destroyed
+*
+*  @param[in/out] aio : I/O context
+*
+*  @return void
+*******************************************************************************
+*/
+static void ioThread(AsyncIO *aio)
+{
+    AsyncIOState *state = aio->state;
+
+    for (;;)
+    {
+        IoRequest *request;
+        {
+            std::unique_lock<std::mutex> guard(state->lock);
+            while (state->queue.empty() && !state->stop)
+                state->cond.wait(guard);
+            if (state->queue.empty())
+                return;
+            request = state->queue.front();
+            state->queue.pop_front();
+        }
+
+        cl_uchar *data = aio->buffers[request->buffer];
+        FILE *fp = fopen(request->filename.c_str(), request->write ? "wb" : "rb");
+        bool ok = (fp != NULL);
+        if (ok && request->write)
+        {
+            request->done = fwrite(data, 1, request->bytes, fp);
+            ok = (request->done == request->bytes);
+        }
+        else if (ok)
+        {
+            /* A file filling the buffer must end there */
+            request->done = fread(data, 1, aio->bufferSize, fp);
+            ok = !ferror(fp) && (request->done < aio->bufferSize || fgetc(fp) == EOF);
+        }
+        if (fp)
+            ok = (fclose(fp) == 0) && ok;
+
+        completeRequest(aio, request, ok);
+    }
+}
+
+#ifdef USE_LIBURING
+/**
+*******************************************************************************
+*  @fn     queueRingRequest
+*  @brief  Submits the remaining part of a request to the ring
+*
+*  @param[in/out] aio  : I/O context
+*  @param[in] request  : request with an open file
+*
+*  @return void
+*******************************************************************************
+*/
+static void queueRingRequest(AsyncIO *aio, IoRequest *request)
+{
+    AsyncIOState *state = aio->state;
+    std::lock_guard<std::mutex> guard(state->ringLock);
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&state->ring);
+    while (sqe == NULL)
+    {
+        io_uring_submit(&state->ring);
+        sqe = io_uring_get_sqe(&state->ring);
+    }
+
+    cl_uchar *data = aio->buffers[request->buffer] + request->done;
+    size_t left = request->bytes - request->done;
+    unsigned len = (left < IO_MAX_CHUNK) ? (unsigned)left : IO_MAX_CHUNK;
+    if (request->write && state->registered)
+        io_uring_prep_write_fixed(sqe, request->fd, data, len, request->done, request->buffer);
+    else if (request->write)
+        io_uring_prep_write(sqe, request->fd, data, len, request->done);
+    else if (state->registered)
+        io_uring_prep_read_fixed(sqe, request->fd, data, len, request->done, request->buffer);
+    else
+        io_uring_prep_read(sqe, request->fd, data, len, request->done);
+    io_uring_sqe_set_data(sqe, request);
+    io_uring_submit(&state->ring);
+}
+
+/**
+*******************************************************************************
+*  @fn     ringCompletionThread
+*  @brief  Reaps ring completions, resubmits short transfers and completes 
+*          requests. Ends on a completion without a request.
+*
+*  @param[in/out] aio : I/O context
+*
+*  @return void
+*******************************************************************************
+*/
+static void ringCompletionThread(AsyncIO *aio)
+{
+    AsyncIOState *state = aio->state;
+
+    for (;;)
+    {
+        struct io_uring_cqe *cqe;
+        int err = io_uring_wait_cqe(&state->ring, &cqe);
+        if (err == -EINTR)
+            continue;
+        if (err < 0)
+            return;
+
+        IoRequest *request = (IoRequest *)io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+        io_uring_cqe_seen(&state->ring, cqe);
+        if (request == NULL)
+            return;
+
+        if (result < 0 || (result == 0 && request->done < request->bytes))
+        {
+            completeRequest(aio, request, false);
+            continue;
+        }
+        request->done += result;
+        if (request->done < request->bytes)
+            queueRingRequest(aio, request);
+        else
+            completeRequest(aio, request, true);
+    }
+}
+#endif
+
+/**
+*******************************************************************************
+*  @fn     createAsyncIO
+*  @brief  Allocates the buffer pools and starts the io_uring or the I/O 
+*          threads
+*
+*  @param[in] numReadBuffers   : buffers of IO_POOL_READ
+*  @param[in] numWriteBuffers  : buffers of IO_POOL_WRITE
+*  @param[in] bufferSize       : size of every buffer, the largest file handled
+*  @param[out] aio             : I/O context
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createAsyncIO(cl_uint numReadBuffers, cl_uint numWriteBuffers, size_t bufferSize,
+                AsyncIO *aio)
+{
+    aio->numBuffers = numReadBuffers + numWriteBuffers;
+    aio->bufferSize = (bufferSize + IO_BUFFER_ALIGN - 1) & ~(size_t)(IO_BUFFER_ALIGN - 1);
+    aio->bytesRead = 0;
+    aio->bytesWritten = 0;
+    aio->state = new AsyncIOState;
+    aio->buffers = (cl_uchar **)calloc(aio->numBuffers, sizeof(cl_uchar *));
+    CHECK_RESULT(aio->buffers == NULL, "Malloc failed.\n");
+
+    AsyncIOState *state = aio->state;
+    state->pending = 0;
+    state->stop = false;
+    for (cl_uint i = 0; i < aio->numBuffers; i++)
+    {
+        aio->buffers[i] = (cl_uchar *)alignedMalloc(aio->bufferSize, IO_BUFFER_ALIGN);
+        CHECK_RESULT(aio->buffers[i] == NULL, "Unable to allocate %d I/O buffers of %lu bytes",
+                        aio->numBuffers, (unsigned long)aio->bufferSize);
+        cl_uint pool = (i < numReadBuffers) ? IO_POOL_READ : IO_POOL_WRITE;
+        state->bufferPool.push_back(pool);
+        state->freeBuffers[pool].push_back(i);
+    }
+
+#ifdef USE_LIBURING
+    /* Every buffer has at most one operation in flight */
+    state->useRing = (io_uring_queue_init(aio->numBuffers, &state->ring, 0) == 0);
+    if (state->useRing)
+    {
+        std::vector<struct iovec> iov(aio->numBuffers);
+        for (cl_uint i = 0; i < aio->numBuffers; i++)
+        {
+            iov[i].iov_base = aio->buffers[i];
+            iov[i].iov_len = aio->bufferSize;
+        }
+        /* Registration pins the buffers and may exceed RLIMIT_MEMLOCK */
+        state->registered = (io_uring_register_buffers(&state->ring, iov.data(),
+                        aio->numBuffers) == 0);
+        state->threads.push_back(std::thread(ringCompletionThread, aio));
+        aio->backend = state->registered ? "io_uring, registered buffers" : "io_uring";
+        return true;
+    }
+#endif
+
+    cl_uint numThreads = (aio->numBuffers < IO_MAX_THREADS) ? aio->numBuffers : IO_MAX_THREADS;
+    for (cl_uint i = 0; i < numThreads; i++)
+        state->threads.push_back(std::thread(ioThread, aio));
+    aio->backend = "threads";
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     acquireIoBuffer
+*  @brief  Takes a buffer from a pool, waiting until one is released
+*
+*  @param[in/out] aio  : I/O context
+*  @param[in] pool     : IO_POOL_READ or IO_POOL_WRITE
+*
+*  @return cl_uint : buffer index
+*******************************************************************************
+*/
+cl_uint acquireIoBuffer(AsyncIO *aio, cl_uint pool)
+{
+    AsyncIOState *state = aio->state;
+    std::unique_lock<std::mutex> guard(state->lock);
+    while (state->freeBuffers[pool].empty())
+        state->cond.wait(guard);
+
+    cl_uint buffer = state->freeBuffers[pool].back();
+    state->freeBuffers[pool].pop_back();
+    return buffer;
+}
+
+/**
+*******************************************************************************
+*  @fn     releaseIoBuffer
+*  @brief  Returns a buffer to its pool
+*
+*  @param[in/out] aio  : I/O context
+*  @param[in] buffer   : buffer index
+*
+*  @return void
+*******************************************************************************
+*/
+void releaseIoBuffer(AsyncIO *aio, cl_uint buffer)
+{
+    AsyncIOState *state = aio->state;
+    std::lock_guard<std::mutex> guard(state->lock);
+    state->freeBuffers[state->bufferPool[buffer]].push_back(buffer);
+    state->cond.notify_all();
+}
+
+/**
+*******************************************************************************
+*  @fn     submitRequest
+*  @brief  Starts a request on the ring or queues it for the I/O threads
+*
+*  @param[in/out] aio  : I/O context
+*  @param[in] request  : new request
+*
+*  @return bool : true if the request was started; otherwise false and the
+*                 request is deleted without a callback.
+*******************************************************************************
+*/
+static bool submitRequest(AsyncIO *aio, IoRequest *request)
+{
+    AsyncIOState *state = aio->state;
+    request->done = 0;
+    request->fd = -1;
+
+#ifdef USE_LIBURING
+    if (state->useRing)
+    {
+        if (request->write)
+        {
+            request->fd = open(request->filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        else
+        {
+            struct stat st;
+            request->fd = open(request->filename.c_str(), O_RDONLY);
+            if (request->fd >= 0 && (fstat(request->fd, &st) != 0
+                            || (size_t)st.st_size > aio->bufferSize))
+            {
+                close(request->fd);
+                request->fd = -1;
+            }
+            else if (request->fd >= 0)
+            {
+                request->bytes = (size_t)st.st_size;
+            }
+        }
+        if (request->fd < 0)
+        {
+            printf("Unable to %s %s\n", request->write ? "create" : "read", request->filename.c_str());
+            delete request;
+            return false;
+        }
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->pending++;
+    }
+
+#ifdef USE_LIBURING
+    if (state->useRing)
+    {
+        if (request->bytes == 0)
+            completeRequest(aio, request, true);
+        else
+            queueRingRequest(aio, request);
+        return true;
+    }
+#endif
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    state->queue.push_back(request);
+    state->cond.notify_all();
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     submitFileRead
+*  @brief  Starts reading a whole file, of at most bufferSize bytes, into a
+*          buffer. The callback receives the file size.
+*
+*  @param[in/out] aio   : I/O context
+*  @param[in] filename  : file to read
+*  @param[in] buffer    : buffer acquired from IO_POOL_READ
+*  @param[in] callback  : completion callback
+*  @param[in] arg       : callback argument
+*
+*  @return bool : true if the read was started; otherwise false.
+*******************************************************************************
+*/
+bool submitFileRead(AsyncIO *aio, const char *filename, cl_uint buffer,
+                IoCallback callback, void *arg)
+{
+    IoRequest *request = new IoRequest;
+    request->write = false;
+    request->filename = filename;
+    request->buffer = buffer;
+    request->bytes = aio->bufferSize;
+    request->callback = callback;
+    request->arg = arg;
+    return submitRequest(aio, request);
+}
+
+/**
+*******************************************************************************
+*  @fn     submitFileWrite
+*  @brief  Starts writing the first bytes of a buffer as a new file
+*
+*  @param[in/out] aio   : I/O context
+*  @param[in] filename  : file to create
+*  @param[in] buffer    : buffer holding the file contents
+*  @param[in] bytes     : file size
+*  @param[in] callback  : completion callback
+*  @param[in] arg       : callback argument
+*
+*  @return bool : true if the write was started; otherwise false.
+*******************************************************************************
+*/
+bool submitFileWrite(AsyncIO *aio, const char *filename, cl_uint buffer, size_t bytes,
+                IoCallback callback, void *arg)
+{
+    IoRequest *request = new IoRequest;
+    request->write = true;
+    request->filename = filename;
+    request->buffer = buffer;
+    request->bytes = bytes;
+    request->callback = callback;
+    request->arg = arg;
+    return submitRequest(aio, request);
+}
+
+/**
+*******************************************************************************
+*  @fn     waitAsyncIO
+*  @brief  Waits until all submitted requests have completed
+*
+*  @param[in/out] aio : I/O context
+*
+*  @return void
+*******************************************************************************
+*/
+void waitAsyncIO(AsyncIO *aio)
+{
+    AsyncIOState *state = aio->state;
+    std::unique_lock<std::mutex> guard(state->lock);
+    while (state->pending > 0)
+        state->cond.wait(guard);
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyAsyncIO
+*  @brief  Waits for pending requests, stops the I/O threads and frees the
+*          buffers
+*
+*  @param[in/out] aio : I/O context
+*
+*  @return void
+*******************************************************************************
+*/
+void destroyAsyncIO(AsyncIO *aio)
+{
+    AsyncIOState *state = aio->state;
+    if (state == NULL)
+        return;
+
+    waitAsyncIO(aio);
+#ifdef USE_LIBURING
+    if (state->useRing)
+    {
+        /* A request free completion ends the completion thread */
+        {
+            std::lock_guard<std::mutex> guard(state->ringLock);
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&state->ring);
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, NULL);
+            io_uring_submit(&state->ring);
+        }
+        state->threads[0].join();
+        io_uring_queue_exit(&state->ring);
+        state->threads.clear();
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->stop = true;
+        state->cond.notify_all();
+    }
+    for (size_t i = 0; i < state->threads.size(); i++)
+        state->threads[i].join();
+
+    for (cl_uint i = 0; i < aio->numBuffers; i++)
+        alignedFree(aio->buffers[i]);
+    free(aio->buffers);
+    delete state;
+    aio->buffers = NULL;
+    aio->state = NULL;
+}
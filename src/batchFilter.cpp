@@ -0,0 +1,895 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <batchFilter.cpp>
+*
+* @brief Filters a directory or list of images with one OpenCL context and
+*        kernel. Files are read and written asynchronously (asyncIO.h) from
+*        pooled buffers; decoder threads decode the next images while the
+*        current one is filtered, writer threads encode the results. Host
+*        and device image buffers are recycled through a buffer pool.
+*
+********************************************************************************
+*/
+#include "batchFilter.h"
+#include "imageIO.h"
+#include "ippMedianFilter.h"
+#include "asyncIO.h"
+#include "bufferPool.h"
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <dirent.h>
+#endif
+
+/* Room for an output header larger than the input one, e.g. a full BMP palette */
+#define BATCH_IO_HEADER_SLACK   2048
+
+/******************************************************************************
+* One image travelling through the pipeline. Its buffers are pinned blocks   *
+* of the job's pool, checked out by the decoder and returned once filtered   *
+* (input) or written (output), so images of one size recycle the same ones.  *
+******************************************************************************/
+typedef struct BatchFrame
+{
+    struct BatchJob *job;
+    cl_uint index;              /**< Position in the input list */
+    cl_uint ioBuffer;           /**< Read buffer holding the input file */
+    size_t ioBytes;             /**< Input file size */
+    cl_uint rows;
+    cl_uint cols;
+    cl_uint paddedCols;
+    cl_uint sampleBits;
+    cl_int topDown;
+    PoolBlock input;            /**< Padded input */
+    PoolBlock output;
+} BatchFrame;
+
+/******************************************************************************
+* Blocking queue of frames between two stages                                 *
+******************************************************************************/
+typedef struct FrameQueue
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<BatchFrame *> frames;
+    bool closed;
+} FrameQueue;
+
+/******************************************************************************
+* State shared by all stages                                                  *
+******************************************************************************/
+typedef struct BatchJob
+{
+    std::vector<std::string> inputs;
+    std::string outDir;
+    cl_uint filterSize;
+    cl_uint bitWidth;
+    cl_uint rawWidth;
+    cl_uint rawHeight;
+    cl_uint verify;
+    AsyncIO aio;
+    BufferPool pool;
+    std::atomic<bool> stopReads;
+    std::atomic<cl_uint> readsLeft;     /**< Reads in flight, plus one until all are submitted */
+    std::atomic<cl_uint> readersLeft;   /**< The last decoder closes the decoded queue */
+    FrameQueue freeFrames;
+    FrameQueue loaded;          /**< Frames whose input file is in a read buffer */
+    FrameQueue decoded;
+    FrameQueue filtered;
+    std::mutex statsLock;
+    double readTime;            /**< Busy time of all decoders, in seconds */
+    double writeTime;           /**< Busy time of all writers, in seconds */
+    cl_uint failures;
+} BatchJob;
+
+static void pushFrame(FrameQueue *queue, BatchFrame *frame)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->frames.push_back(frame);
+    queue->cond.notify_one();
+}
+
+/* Returns NULL once the queue is closed and empty */
+static BatchFrame *popFrame(FrameQueue *queue)
+{
+    std::unique_lock<std::mutex> guard(queue->lock);
+    while (queue->frames.empty() && !queue->closed)
+        queue->cond.wait(guard);
+    if (queue->frames.empty())
+        return NULL;
+
+    BatchFrame *frame = queue->frames.front();
+    queue->frames.pop_front();
+    return frame;
+}
+
+static void closeQueue(FrameQueue *queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->closed = true;
+    queue->cond.notify_all();
+}
+
+/**
+*******************************************************************************
+*  @fn     recycleFrame
+*  @brief  Returns the buffers of a frame to the pool and the frame to the
+*          free frames
+*
+*  @param[in/out] job    : shared state
+*  @param[in/out] frame  : frame
+*
+*  @return void
+*******************************************************************************
+*/
+static void recycleFrame(BatchJob *job, BatchFrame *frame)
+{
+    releasePoolBlock(&job->pool, &frame->input);
+    releasePoolBlock(&job->pool, &frame->output);
+    pushFrame(&job->freeFrames, frame);
+}
+
+/**
+*******************************************************************************
+*  @fn     countFailure
+*  @brief  Records an image that could not be processed
+*
+*  @param[in/out] job : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void countFailure(BatchJob *job)
+{
+    std::lock_guard<std::mutex> guard(job->statsLock);
+    job->failures++;
+}
+
+/**
+*******************************************************************************
+*  @fn     decodeFrame
+*  @brief  Decodes the input file in the read buffer of a frame into its
+*          padded input
+*
+*  @param[in] job        : shared state
+*  @param[in/out] frame  : frame to fill
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool decodeFrame(BatchJob *job, BatchFrame *frame)
+{
+    MappedImage image;
+    const char *name = job->inputs[frame->index].c_str();
+    if (!openImageBuffer(name, job->aio.buffers[frame->ioBuffer], frame->ioBytes,
+                    job->rawWidth, job->rawHeight, job->bitWidth, &image))
+        return false;
+
+    cl_uint filterRadius = job->filterSize / 2;
+    size_t bytesPerPixel = job->bitWidth / 8;
+
+    frame->rows = image.height;
+    frame->cols = image.width;
+    frame->paddedCols = image.width + job->filterSize - 1;
+    frame->sampleBits = (image.sampleBits < job->bitWidth) ? image.sampleBits : job->bitWidth;
+    frame->topDown = image.topDown;
+
+    size_t inputSize = (size_t)frame->paddedCols * (frame->rows + job->filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)frame->cols * frame->rows * bytesPerPixel;
+    bool decoded = acquirePoolBlock(&job->pool, POOL_PINNED, inputSize, &frame->input)
+                    && acquirePoolBlock(&job->pool, POOL_PINNED, outputSize, &frame->output);
+    if (decoded)
+    {
+        memset(frame->input.host, 0, inputSize);
+        decoded = decodeImageChannel(&image, 0, frame->input.host
+                        + (filterRadius * frame->paddedCols + filterRadius) * bytesPerPixel,
+                        frame->paddedCols, job->bitWidth);
+    }
+    closeImage(&image);
+    return decoded;
+}
+
+/**
+*******************************************************************************
+*  @fn     finishRead
+*  @brief  Retires one read, closing the loaded queue after the last one
+*
+*  @param[in/out] job : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void finishRead(BatchJob *job)
+{
+    if (--job->readsLeft == 0)
+        closeQueue(&job->loaded);
+}
+
+/**
+*******************************************************************************
+*  @fn     readDone
+*  @brief  Read completion: hands the frame to the decoders
+*
+*  @param[in] arg     : frame
+*  @param[in] buffer  : read buffer
+*  @param[in] bytes   : file size
+*  @param[in] ok      : the file was read
+*
+*  @return void
+*******************************************************************************
+*/
+static void readDone(void *arg, cl_uint buffer, size_t bytes, bool ok)
+{
+    BatchFrame *frame = (BatchFrame *)arg;
+    BatchJob *job = frame->job;
+
+    frame->ioBytes = bytes;
+    if (ok)
+    {
+        pushFrame(&job->loaded, frame);
+    }
+    else
+    {
+        releaseIoBuffer(&job->aio, buffer);
+        countFailure(job);
+        pushFrame(&job->freeFrames, frame);
+    }
+    finishRead(job);
+}
+
+/**
+*******************************************************************************
+*  @fn     submitThread
+*  @brief  Submits the reads of the inputs in order, as free frames and read
+*          buffers become available
+*
+*  @param[in/out] job : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void submitThread(BatchJob *job)
+{
+    for (cl_uint index = 0; index < job->inputs.size() && !job->stopReads; index++)
+    {
+        BatchFrame *frame = popFrame(&job->freeFrames);
+        if (frame == NULL)
+            break;
+
+        frame->index = index;
+        frame->ioBuffer = acquireIoBuffer(&job->aio, IO_POOL_READ);
+        job->readsLeft++;
+        if (!submitFileRead(&job->aio, job->inputs[index].c_str(), frame->ioBuffer,
+                        readDone, frame))
+        {
+            releaseIoBuffer(&job->aio, frame->ioBuffer);
+            countFailure(job);
+            pushFrame(&job->freeFrames, frame);
+            finishRead(job);
+        }
+    }
+    finishRead(job);
+}
+
+/**
+*******************************************************************************
+*  @fn     decoderThread
+*  @brief  Decodes loaded input files into their frames
+*
+*  @param[in/out] job : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void decoderThread(BatchJob *job)
+{
+    double busy = 0;
+    BatchFrame *frame;
+
+    while ((frame = popFrame(&job->loaded)) != NULL)
+    {
+        timer t;
+        timerStart(&t);
+        bool decoded = decodeFrame(job, frame);
+        releaseIoBuffer(&job->aio, frame->ioBuffer);
+        busy += timerCurrent(&t);
+
+        if (decoded)
+        {
+            pushFrame(&job->decoded, frame);
+        }
+        else
+        {
+            printf("Failed to read %s\n", job->inputs[frame->index].c_str());
+            countFailure(job);
+            recycleFrame(job, frame);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(job->statsLock);
+        job->readTime += busy;
+    }
+    if (--job->readersLeft == 0)
+        closeQueue(&job->decoded);
+}
+
+/**
+*******************************************************************************
+*  @fn     getOutputName
+*  @brief  Output path of an input: its file name inside the output directory
+*
+*  @param[in] job    : shared state
+*  @param[in] index  : input list index
+*
+*  @return std::string : output path
+*******************************************************************************
+*/
+static std::string getOutputName(const BatchJob *job, cl_uint index)
+{
+    const std::string &input = job->inputs[index];
+    size_t slash = input.find_last_of("/\\");
+    return job->outDir + "/" + ((slash == std::string::npos) ? input : input.substr(slash + 1));
+}
+
+/**
+*******************************************************************************
+*  @fn     writeDone
+*  @brief  Write completion: returns the write buffer
+*
+*  @param[in] arg     : shared state
+*  @param[in] buffer  : write buffer
+*  @param[in] ok      : the whole file was written
+*
+*  @return void
+*******************************************************************************
+*/
+static void writeDone(void *arg, cl_uint buffer, size_t, bool ok)
+{
+    BatchJob *job = (BatchJob *)arg;
+    releaseIoBuffer(&job->aio, buffer);
+    if (!ok)
+        countFailure(job);
+}
+
+/**
+*******************************************************************************
+*  @fn     writerThread
+*  @brief  Encodes filtered frames into write buffers, returns the frames to
+*          the free frames and submits the writes
+*
+*  @param[in/out] job : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void writerThread(BatchJob *job)
+{
+    double busy = 0;
+    BatchFrame *frame;
+
+    while ((frame = popFrame(&job->filtered)) != NULL)
+    {
+        cl_uint buffer = acquireIoBuffer(&job->aio, IO_POOL_WRITE);
+        timer t;
+        timerStart(&t);
+
+        std::string name = getOutputName(job, frame->index);
+        size_t fileSize;
+        bool encoded = encodeImageFile(name.c_str(), frame->cols, frame->rows,
+                        frame->sampleBits, frame->topDown, frame->output.host, frame->cols,
+                        job->bitWidth, job->aio.buffers[buffer], job->aio.bufferSize, &fileSize);
+        busy += timerCurrent(&t);
+        recycleFrame(job, frame);
+
+        if (!encoded || !submitFileWrite(&job->aio, name.c_str(), buffer, fileSize,
+                        writeDone, job))
+        {
+            printf("Failed to write %s\n", name.c_str());
+            releaseIoBuffer(&job->aio, buffer);
+            countFailure(job);
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(job->statsLock);
+    job->writeTime += busy;
+}
+
+/******************************************************************************
+* Filter stage state. Device buffers are swapped for blocks of the pool when *
+* the image size changes.                                                    *
+******************************************************************************/
+typedef struct FilterStage
+{
+    PoolBlock input;
+    PoolBlock output;
+    Ipp8u *ippBuffer;           /**< ipp scratch for ippCols x ippRows */
+    cl_uint ippCols;
+    cl_uint ippRows;
+    PoolBlock ippOutput;
+    cl_uint images;
+    cl_uint mismatches;
+    double kernelTime;          /**< Sum of kernel times, in msec */
+    double busyTime;            /**< In seconds */
+} FilterStage;
+
+/**
+*******************************************************************************
+*  @fn     fitStageBlock
+*  @brief  Keeps a block of the filter stage if it has the size class of
+*          size, otherwise swaps it for one from the pool
+*
+*  @param[in/out] pool   : buffer pool
+*  @param[in] kind       : block kind
+*  @param[in] size       : required bytes
+*  @param[in/out] block  : block of the stage, empty at first
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool fitStageBlock(BufferPool *pool, cl_uint kind, size_t size, PoolBlock *block)
+{
+    if (block->size == getPoolSizeClass(size))
+        return true;
+
+    releasePoolBlock(pool, block);
+    return acquirePoolBlock(pool, kind, size, block);
+}
+
+/**
+*******************************************************************************
+*  @fn     filterFrame
+*  @brief  Runs the kernel on a decoded frame, reads the result into the
+*          frame output and optionally compares it against ipp
+*
+*  @param[in] infoDeviceOcl    : Structure which holds openCL related params
+*  @param[in] job              : shared state
+*  @param[in] kernel           : median filter kernel
+*  @param[in] config           : kernel configuration
+*  @param[in/out] stage        : device buffers and statistics
+*  @param[in/out] frame        : frame to filter
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool filterFrame(DeviceInfo *infoDeviceOcl, BatchJob *job, cl_kernel kernel,
+                const MedianKernelConfig *config, FilterStage *stage, BatchFrame *frame)
+{
+    cl_int status;
+    cl_uint filterSize = job->filterSize;
+    size_t bytesPerPixel = job->bitWidth / 8;
+    size_t inputSize = (size_t)frame->paddedCols * (frame->rows + filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)frame->cols * frame->rows * bytesPerPixel;
+
+    if (!fitStageBlock(&job->pool, POOL_DEVICE, inputSize, &stage->input)
+                    || !fitStageBlock(&job->pool, POOL_DEVICE, outputSize, &stage->output))
+        return false;
+
+    /* The frame input is pinned, so the upload is a direct DMA transfer */
+    status = clEnqueueWriteBuffer(infoDeviceOcl->mQueue, stage->input.mem, CL_FALSE, 0,
+                    inputSize, frame->input.host, 0, NULL, NULL);
+    CHECK_RESULT(status != CL_SUCCESS, "Error in clEnqueueWriteBuffer. Status: %d\n", status);
+
+    MedianOutputLayout layout;
+    initMedianOutputLayout(&layout, frame->cols, 0, OUT_BORDER_NONE);
+    if (!setMedianFilterKernelArgs(kernel, stage->input.mem, stage->output.mem, frame->cols,
+                    frame->rows, frame->paddedCols, &layout))
+        return false;
+
+    cl_event ev;
+    if (!runMedianFilterKernel(infoDeviceOcl->mQueue, kernel, frame->cols, frame->rows,
+                    config, &ev))
+        return false;
+
+    status = clEnqueueReadBuffer(infoDeviceOcl->mQueue, stage->output.mem, CL_TRUE, 0,
+                    outputSize, frame->output.host, 0, NULL, NULL);
+    CHECK_RESULT(status != CL_SUCCESS, "Error in clEnqueueReadBuffer. Status: %d\n", status);
+
+    cl_ulong timeStart, timeEnd;
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_START, sizeof(timeStart), &timeStart, NULL);
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_END, sizeof(timeEnd), &timeEnd, NULL);
+    stage->kernelTime += (double)((timeEnd - timeStart) * (1.0e-6));
+    clReleaseEvent(ev);
+
+    /**************************************************************************
+    * Verify against ipp. The ipp buffer depends on the image size.
+    ***************************************************************************/
+    if (job->verify)
+    {
+        if (frame->cols != stage->ippCols || frame->rows != stage->ippRows)
+        {
+            if (stage->ippBuffer)
+                ippFree(stage->ippBuffer);
+            stage->ippBuffer = NULL;
+            initIppMedianFilter(filterSize, frame->cols, frame->rows, job->bitWidth,
+                            &stage->ippBuffer);
+            stage->ippCols = frame->cols;
+            stage->ippRows = frame->rows;
+        }
+        if (!fitStageBlock(&job->pool, POOL_HOST, outputSize, &stage->ippOutput))
+            return false;
+        if (!runIppMedianFilter(frame->input.host, filterSize, stage->ippOutput.host,
+                        frame->cols, frame->rows, job->bitWidth, stage->ippBuffer))
+            return false;
+        if (memcmp(frame->output.host, stage->ippOutput.host, outputSize) != 0)
+        {
+            printf("Verification failed for %s\n", job->inputs[frame->index].c_str());
+            stage->mismatches++;
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     isBatchImage
+*  @brief  Checks whether a directory entry is a BMP, PGM or raw image. TIFF
+*          files are left out, they are filtered tile by tile.
+*
+*  @param[in] name  : file name
+*
+*  @return bool : true for images the batch mode reads
+*******************************************************************************
+*/
+static bool isBatchImage(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+    if (ext == NULL)
+        return false;
+
+    switch (getImageFormat(name))
+    {
+    case IMAGE_FORMAT_PGM:
+    case IMAGE_FORMAT_RAW:
+        return true;
+    case IMAGE_FORMAT_BMP:
+        return (tolower((unsigned char)ext[1]) == 'b') && (tolower((unsigned char)ext[2]) == 'm')
+                && (tolower((unsigned char)ext[3]) == 'p') && (ext[4] == '\0');
+    default:
+        return false;
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     listBatchInputs
+*  @brief  Collects the BMP, PGM and raw images of a directory, sorted by 
+*          name, or the paths listed one per line in a text file
+*
+*  @param[in] batchInput  : directory or list file
+*  @param[out] inputs     : image paths
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool listBatchInputs(const char *batchInput, std::vector<std::string> *inputs)
+{
+    std::vector<std::string> names;
+    bool isDirectory = false;
+    std::string dir(batchInput);
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        isDirectory = true;
+        do
+        {
+            if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                names.push_back(entry.cFileName);
+        } while (FindNextFileA(find, &entry));
+        FindClose(find);
+    }
+#else
+    DIR *d = opendir(batchInput);
+    if (d != NULL)
+    {
+        isDirectory = true;
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL)
+        {
+            if (entry->d_name[0] != '.')
+                names.push_back(entry->d_name);
+        }
+        closedir(d);
+    }
+#endif
+
+    if (isDirectory)
+    {
+        std::sort(names.begin(), names.end());
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (isBatchImage(names[i].c_str()))
+                inputs->push_back(dir + "/" + names[i]);
+        }
+        return true;
+    }
+
+    FILE *list = fopen(batchInput, "r");
+    CHECK_RESULT(list == NULL, "Unable to open %s", batchInput);
+
+    char line[4096];
+    while (fgets(line, sizeof(line), list))
+    {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len > 0)
+            inputs->push_back(line);
+    }
+    fclose(list);
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     getLargestInput
+*  @brief  Size of the largest input file, which sizes the I/O buffers
+*
+*  @param[in] inputs  : image paths
+*
+*  @return size_t : largest file size in bytes, 0 if none could be examined
+*******************************************************************************
+*/
+static size_t getLargestInput(const std::vector<std::string> &inputs)
+{
+    size_t largest = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        struct stat st;
+        if (stat(inputs[i].c_str(), &st) == 0 && (size_t)st.st_size > largest)
+            largest = (size_t)st.st_size;
+    }
+    return largest;
+}
+
+/**
+*******************************************************************************
+*  @fn     runBatch
+*  @brief  Filters all images of a directory or list file. OpenCL, the kernel
+*          and the device buffers are set up once. Up to prefetch input files
+*          are read asynchronously ahead of the filter and decoded by 
+*          numReaders threads, numWriters threads encode the results, which
+*          are written asynchronously into outDir under the input file names.
+*
+*  @param[in/out] infoDeviceOcl : Structure which holds openCL related params
+*  @param[in] batchInput        : directory or list file of input images
+*  @param[in] outDir            : output directory, created if missing
+*  @param[in] filterSize        : filter size (only 3 and 5 are currently supported)
+*  @param[in] bitWidth          : 8 bit or 16 bit
+*  @param[in] deviceNum         : device on which to run OpenCL kernels
+*  @param[in] useLds            : Should the OpenCL kernel use LDS memory for input
+*  @param[in] usePacked         : Use the packed kernel for 8 bit input
+*  @param[in] numReaders        : Number of decoding threads
+*  @param[in] numWriters        : Number of writing threads
+*  @param[in] prefetch          : Number of decoded images waiting for the filter
+*  @param[in] verify            : Compare every image against ipp
+*  @param[in] rawWidth          : Width of raw input images
+*  @param[in] rawHeight         : Height of raw input images
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runBatch(DeviceInfo *infoDeviceOcl, const char *batchInput, const char *outDir,
+                cl_uint filterSize, cl_uint bitWidth, cl_uint deviceNum, cl_int useLds,
+                cl_int usePacked, cl_uint numReaders, cl_uint numWriters, cl_uint prefetch,
+                cl_uint verify, cl_uint rawWidth, cl_uint rawHeight)
+{
+    BatchJob job;
+
+    if (!listBatchInputs(batchInput, &job.inputs))
+        return false;
+    CHECK_RESULT(job.inputs.empty(), "No images found in %s", batchInput);
+
+#ifdef _WIN32
+    _mkdir(outDir);
+#else
+    mkdir(outDir, 0755);
+#endif
+
+    /**************************************************************************
+    * One-time setup: OpenCL context, kernel and device buffers
+    ***************************************************************************/
+    if (initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        return false;
+    }
+
+    MedianKernelConfig config;
+    config.filtSize = filterSize;
+    config.bitWidth = bitWidth;
+    config.useLds = useLds;
+    config.deviceType = infoDeviceOcl->mDeviceType;
+    config.usePacked = usePacked;
+    config.fixedWidth = 0;
+    config.fixedHeight = 0;
+    config.fixedPitch = 0;
+    config.cacheBinary = 0;
+
+    cl_kernel medianFilter;
+    if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    &medianFilter, &config) == false)
+    {
+        printf("Error in buildMedianFilterKernel.\n");
+        return false;
+    }
+
+    job.outDir = outDir;
+    job.filterSize = filterSize;
+    job.bitWidth = bitWidth;
+    job.rawWidth = rawWidth;
+    job.rawHeight = rawHeight;
+    job.verify = verify;
+    job.stopReads = false;
+    job.readsLeft = 1;
+    job.readersLeft = numReaders;
+    job.freeFrames.closed = false;
+    job.loaded.closed = false;
+    job.decoded.closed = false;
+    job.filtered.closed = false;
+    job.readTime = 0;
+    job.writeTime = 0;
+    job.failures = 0;
+
+    /* Enough frames for the prefetched images, the one being filtered and one per writer */
+    std::vector<BatchFrame> frames(prefetch + numWriters + 1);
+    createBufferPool(infoDeviceOcl->mCtx, infoDeviceOcl->mQueue, 0, &job.pool);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        memset(&frames[i], 0, sizeof(BatchFrame));
+        frames[i].job = &job;
+        pushFrame(&job.freeFrames, &frames[i]);
+    }
+
+    /* Read buffers are returned once decoded, write buffers once written */
+    size_t ioBufferSize = getLargestInput(job.inputs) + BATCH_IO_HEADER_SLACK;
+    if (!createAsyncIO(prefetch, numWriters + 1, ioBufferSize, &job.aio))
+    {
+        destroyAsyncIO(&job.aio);
+        destroyBufferPool(&job.pool);
+        clReleaseKernel(medianFilter);
+        return false;
+    }
+
+    printf("Executing Median filter on %d images with %d readers, %d writers and %d prefetched images",
+                    (cl_uint)job.inputs.size(), numReaders, numWriters, prefetch);
+    printf("\n\tFilter size: %dx%d\n\tBit width: %d\n", filterSize, filterSize, bitWidth);
+    printf("\tFile I/O: %s, %d buffers of %lu bytes\n", job.aio.backend, job.aio.numBuffers,
+                    (unsigned long)job.aio.bufferSize);
+    printMedianFilterKernelInfo(medianFilter, infoDeviceOcl->mDevice);
+    printf("\n\n");
+
+    timer batchTimer;
+    timerStart(&batchTimer);
+
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread(submitThread, &job));
+    for (cl_uint i = 0; i < numReaders; i++)
+        threads.push_back(std::thread(decoderThread, &job));
+    for (cl_uint i = 0; i < numWriters; i++)
+        threads.push_back(std::thread(writerThread, &job));
+
+    /**************************************************************************
+    * Filter stage, on this thread
+    ***************************************************************************/
+    FilterStage stage;
+    memset(&stage, 0, sizeof(FilterStage));
+    bool failed = false;
+    BatchFrame *frame;
+
+    while (!failed && (frame = popFrame(&job.decoded)) != NULL)
+    {
+        timer t;
+        timerStart(&t);
+        failed = !filterFrame(infoDeviceOcl, &job, medianFilter, &config, &stage, frame);
+        stage.busyTime += timerCurrent(&t);
+
+        if (!failed)
+        {
+            stage.images++;
+            releasePoolBlock(&job.pool, &frame->input);
+            pushFrame(&job.filtered, frame);
+        }
+    }
+
+    closeQueue(&job.filtered);
+    if (failed)
+    {
+        /* Let the submitter and decoders finish so that all threads can be joined */
+        job.stopReads = true;
+        closeQueue(&job.freeFrames);
+        while ((frame = popFrame(&job.decoded)) != NULL)
+            ;
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    waitAsyncIO(&job.aio);
+
+    double wallTime = timerCurrent(&batchTimer);
+    double bytesRead = (double)job.aio.bytesRead;
+    double bytesWritten = (double)job.aio.bytesWritten;
+    destroyAsyncIO(&job.aio);
+
+    /* Frames that did not reach the writers still hold their blocks */
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        releasePoolBlock(&job.pool, &frames[i].input);
+        releasePoolBlock(&job.pool, &frames[i].output);
+    }
+    releasePoolBlock(&job.pool, &stage.input);
+    releasePoolBlock(&job.pool, &stage.output);
+    releasePoolBlock(&job.pool, &stage.ippOutput);
+    BufferPoolStats poolStats;
+    getBufferPoolStats(&job.pool, &poolStats);
+    destroyBufferPool(&job.pool);
+    if (stage.ippBuffer)
+        ippFree(stage.ippBuffer);
+    clReleaseKernel(medianFilter);
+
+    CHECK_RESULT(failed, "Error in the filter stage");
+
+    /**************************************************************************
+    * Throughput and the share of the wall time each stage was busy
+    ***************************************************************************/
+    printf("Filtered %d images in %f msec: %f images/sec\n", stage.images, 1000 * wallTime,
+                    stage.images / wallTime);
+    printf("Average OpenCL kernel time per image is %f msec\n",
+                    stage.images ? stage.kernelTime / stage.images : 0);
+    printf("File I/O (%s): read %f MB/s, written %f MB/s\n", job.aio.backend,
+                    bytesRead / (wallTime * 1.0e6), bytesWritten / (wallTime * 1.0e6));
+    printBufferPoolStats(&poolStats);
+    printf("Stage utilization: decode %.1f%% of %d threads, filter %.1f%%, write %.1f%% of %d threads\n",
+                    100 * job.readTime / (wallTime * numReaders), numReaders,
+                    100 * stage.busyTime / wallTime,
+                    100 * job.writeTime / (wallTime * numWriters), numWriters);
+    if (job.failures)
+        printf("%d images could not be read or written\n", job.failures);
+    if (verify)
+    {
+        if (stage.mismatches)
+            printf("\nVerification failed for %d images!!\n\n", stage.mismatches);
+        else
+            printf("\nVerification succeeded!!\n\n");
+    }
+    return true;
+}
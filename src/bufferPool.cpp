@@ -0,0 +1,290 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <bufferPool.cpp>
+*
+* @brief Size-class pool of host, pinned and device image buffers. Requests
+*        are rounded up to a size class and served from a free block of that
+*        class when there is one, so a batch or stream of images allocates
+*        its buffers once and recycles them afterwards.
+*
+********************************************************************************
+*/
+#include "bufferPool.h"
+#include "utils.h"
+#include "macros.h"
+#include <string.h>
+#include <map>
+#include <vector>
+#include <mutex>
+
+struct BufferPoolState
+{
+    std::mutex lock;
+    std::map<size_t, std::vector<PoolBlock> > freeBlocks[POOL_KINDS];
+    BufferPoolStats stats;
+};
+
+/**
+*******************************************************************************
+*  @fn     getPoolSizeClass
+*  @brief  Rounds a size up to its size class. Classes are quarter steps
+*          between powers of two, at least a cache line apart, so a block
+*          wastes less than a quarter of its size.
+*
+*  @param[in] size : requested bytes
+*
+*  @return size_t : size class in bytes
+*******************************************************************************
+*/
+size_t getPoolSizeClass(size_t size)
+{
+    if (size <= BUFFER_POOL_LINE_SIZE)
+        return BUFFER_POOL_LINE_SIZE;
+
+    size_t power = BUFFER_POOL_LINE_SIZE;
+    while (power <= size / 2)
+        power *= 2;
+    size_t step = (power / 4 > BUFFER_POOL_LINE_SIZE) ? power / 4 : BUFFER_POOL_LINE_SIZE;
+    return (size + step - 1) / step * step;
+}
+
+/**
+*******************************************************************************
+*  @fn     allocateBlock
+*  @brief  Allocates a new block of a size class. Pinned blocks are mapped
+*          once and stay mapped until they are freed.
+*
+*  @param[in] pool    : the pool
+*  @param[in] kind    : POOL_HOST, POOL_PINNED or POOL_DEVICE
+*  @param[in] size    : size class in bytes
+*  @param[out] block  : the block
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool allocateBlock(const BufferPool *pool, cl_uint kind, size_t size, PoolBlock *block)
+{
+    cl_int status;
+
+    memset(block, 0, sizeof(PoolBlock));
+    block->size = size;
+    block->kind = kind;
+
+    if (kind == POOL_HOST)
+    {
+        block->host = (cl_uchar *)alignedMalloc(size, (size < BUFFER_POOL_PAGE_SIZE)
+                        ? BUFFER_POOL_LINE_SIZE : BUFFER_POOL_PAGE_SIZE);
+        CHECK_RESULT(block->host == NULL, "Malloc failed.\n");
+        return true;
+    }
+
+    CHECK_RESULT(pool->ctx == NULL, "The buffer pool has no OpenCL context");
+    cl_mem_flags flags = CL_MEM_READ_WRITE | ((kind == POOL_PINNED) ? CL_MEM_ALLOC_HOST_PTR : 0);
+    block->mem = clCreateBuffer(pool->ctx, flags, size, NULL, &status);
+    CHECK_RESULT(status != CL_SUCCESS, "clCreateBuffer failed with %d\n", status);
+
+    if (kind == POOL_PINNED)
+    {
+        block->host = (cl_uchar *)clEnqueueMapBuffer(pool->queue, block->mem, CL_TRUE,
+                        CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &status);
+        if (status != CL_SUCCESS)
+        {
+            clReleaseMemObject(block->mem);
+            block->mem = NULL;
+            CHECK_RESULT(true, "clEnqueueMapBuffer failed with %d\n", status);
+        }
+    }
+    return true;
+}
+
+static void freeBlock(const BufferPool *pool, PoolBlock *block)
+{
+    if (block->kind == POOL_HOST)
+    {
+        alignedFree(block->host);
+    }
+    else
+    {
+        if (block->kind == POOL_PINNED)
+        {
+            clEnqueueUnmapMemObject(pool->queue, block->mem, block->host, 0, NULL, NULL);
+            clFinish(pool->queue);
+        }
+        clReleaseMemObject(block->mem);
+    }
+    memset(block, 0, sizeof(PoolBlock));
+}
+
+/**
+*******************************************************************************
+*  @fn     createBufferPool
+*  @brief  Creates an empty pool
+*
+*  @param[in] ctx           : context of pinned and device blocks, NULL for
+*                             host blocks only
+*  @param[in] queue         : queue that maps pinned blocks
+*  @param[in] maxFreeBytes  : free bytes kept for reuse, 0 keeps all
+*  @param[out] pool         : the pool
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createBufferPool(cl_context ctx, cl_command_queue queue, size_t maxFreeBytes,
+                BufferPool *pool)
+{
+    pool->ctx = ctx;
+    pool->queue = queue;
+    pool->maxFreeBytes = maxFreeBytes;
+    pool->state = new BufferPoolState;
+    memset(&pool->state->stats, 0, sizeof(BufferPoolStats));
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     acquirePoolBlock
+*  @brief  Checks out a block of at least size bytes, recycling a free block
+*          of the same size class when there is one. Blocks are not cleared.
+*
+*  @param[in/out] pool  : the pool
+*  @param[in] kind      : POOL_HOST, POOL_PINNED or POOL_DEVICE
+*  @param[in] size      : required bytes
+*  @param[out] block    : the block, empty on failure
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool acquirePoolBlock(BufferPool *pool, cl_uint kind, size_t size, PoolBlock *block)
+{
+    BufferPoolState *state = pool->state;
+    size_t sizeClass = getPoolSizeClass(size);
+
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->stats.requests++;
+        std::map<size_t, std::vector<PoolBlock> >::iterator it
+                        = state->freeBlocks[kind].find(sizeClass);
+        if (it != state->freeBlocks[kind].end() && !it->second.empty())
+        {
+            *block = it->second.back();
+            it->second.pop_back();
+            state->stats.hits++;
+            state->stats.bytesFree -= sizeClass;
+            return true;
+        }
+    }
+
+    /* Allocate outside the lock, mapping a pinned block waits for its queue */
+    if (!allocateBlock(pool, kind, sizeClass, block))
+    {
+        memset(block, 0, sizeof(PoolBlock));
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    state->stats.bytesHeld += sizeClass;
+    if (state->stats.bytesHeld > state->stats.peakBytesHeld)
+        state->stats.peakBytesHeld = state->stats.bytesHeld;
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     releasePoolBlock
+*  @brief  Returns a block to its free list, or frees it when the pool
+*          already keeps maxFreeBytes. Device blocks must no longer be used
+*          by enqueued commands.
+*
+*  @param[in/out] pool   : the pool
+*  @param[in/out] block  : the block, cleared. Empty blocks are ignored.
+*
+*  @return void
+*******************************************************************************
+*/
+void releasePoolBlock(BufferPool *pool, PoolBlock *block)
+{
+    if (block->size == 0)
+        return;
+
+    BufferPoolState *state = pool->state;
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (pool->maxFreeBytes == 0 || state->stats.bytesFree + block->size <= pool->maxFreeBytes)
+        {
+            state->freeBlocks[block->kind][block->size].push_back(*block);
+            state->stats.bytesFree += block->size;
+            memset(block, 0, sizeof(PoolBlock));
+            return;
+        }
+        state->stats.bytesHeld -= block->size;
+    }
+    freeBlock(pool, block);
+}
+
+void getBufferPoolStats(const BufferPool *pool, BufferPoolStats *stats)
+{
+    std::lock_guard<std::mutex> guard(pool->state->lock);
+    *stats = pool->state->stats;
+}
+
+void printBufferPoolStats(const BufferPoolStats *stats)
+{
+    printf("Buffer pool: %lu requests, %.1f%% hits, %lu bytes held (peak %lu, %lu free)\n",
+                    (unsigned long)stats->requests,
+                    stats->requests ? 100.0 * stats->hits / stats->requests : 0.0,
+                    (unsigned long)stats->bytesHeld, (unsigned long)stats->peakBytesHeld,
+                    (unsigned long)stats->bytesFree);
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyBufferPool
+*  @brief  Frees all free blocks. Blocks still checked out must be released
+*          before.
+*
+*  @param[in/out] pool : the pool
+*
+*  @return void
+*******************************************************************************
+*/
+void destroyBufferPool(BufferPool *pool)
+{
+    if (pool->state == NULL)
+        return;
+
+    for (cl_uint kind = 0; kind < POOL_KINDS; kind++)
+    {
+        std::map<size_t, std::vector<PoolBlock> >::iterator it;
+        for (it = pool->state->freeBlocks[kind].begin(); it != pool->state->freeBlocks[kind].end(); ++it)
+        {
+            for (size_t i = 0; i < it->second.size(); i++)
+                freeBlock(pool, &it->second[i]);
+        }
+    }
+    delete pool->state;
+    pool->state = NULL;
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <contextPool.cpp>
+*
+* @brief Pool of per caller contexts. Free contexts form a lock-free stack 
+*        (a Treiber stack of indices), so concurrent callers check contexts
+*        out and in with one compare-and-swap each and never serialize on a
+*        lock.
+*
+********************************************************************************
+*/
+#include "contextPool.h"
+#include "macros.h"
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#define CONTEXT_NONE 0xffffffffu
+
+/******************************************************************************
+* The stack head packs a version tag above the index of the top context. The *
+* tag changes with every push and pop, so a caller that read a stale head    *
+* (the ABA case) fails its compare-and-swap and retries.                     *
+******************************************************************************/
+struct ContextPoolState
+{
+    std::atomic<cl_ulong> head;
+    std::atomic<cl_uint> *next;         /**< Context below each stacked one */
+    std::atomic<cl_ulong> waits;        /**< Checkouts that found the pool empty */
+};
+
+static inline cl_ulong makeHead(cl_ulong oldHead, cl_uint index)
+{
+    return (((oldHead >> 32) + 1) << 32) | index;
+}
+
+/**
+*******************************************************************************
+*  @fn     createMedianContextPool
+*  @brief  Allocates numContexts zeroed contexts, all free. The owner fills
+*          in their resources before the first checkout.
+*
+*  @param[in] numContexts  : number of contexts, at least 1
+*  @param[out] pool        : the pool
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createMedianContextPool(cl_uint numContexts, MedianContextPool *pool)
+{
+    memset(pool, 0, sizeof(MedianContextPool));
+    CHECK_RESULT(numContexts == 0 || numContexts == CONTEXT_NONE,
+                    "Invalid number of contexts %d", numContexts);
+
+    pool->contexts = (MedianContext *)calloc(numContexts, sizeof(MedianContext));
+    CHECK_RESULT(pool->contexts == NULL, "Malloc failed.\n");
+    pool->numContexts = numContexts;
+
+    ContextPoolState *state = new ContextPoolState;
+    state->next = new std::atomic<cl_uint>[numContexts];
+    for (cl_uint i = 0; i < numContexts; i++)
+        state->next[i].store((i + 1 < numContexts) ? i + 1 : CONTEXT_NONE);
+    state->head.store(0);
+    state->waits.store(0);
+    pool->state = state;
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     acquireMedianContext
+*  @brief  Checks out a free context. With more concurrent callers than 
+*          contexts, the surplus callers yield until one is returned.
+*
+*  @param[in] pool : pool
+*
+*  @return MedianContext* : context for the exclusive use of the caller
+*******************************************************************************
+*/
+MedianContext *acquireMedianContext(const MedianContextPool *pool)
+{
+    ContextPoolState *state = pool->state;
+    cl_ulong head = state->head.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        cl_uint index = (cl_uint)head;
+        if (index == CONTEXT_NONE)
+        {
+            state->waits.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+            head = state->head.load(std::memory_order_acquire);
+            continue;
+        }
+
+        /* next may be stale if another caller popped index meanwhile; the tag
+         * then makes the exchange fail */
+        cl_uint next = state->next[index].load(std::memory_order_relaxed);
+        if (state->head.compare_exchange_weak(head, makeHead(head, next),
+                        std::memory_order_acquire, std::memory_order_acquire))
+            return &pool->contexts[index];
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     releaseMedianContext
+*  @brief  Returns a context checked out with acquireMedianContext
+*
+*  @param[in] pool      : pool
+*  @param[in] context   : context to return
+*
+*  @return void
+*******************************************************************************
+*/
+void releaseMedianContext(const MedianContextPool *pool, MedianContext *context)
+{
+    ContextPoolState *state = pool->state;
+    cl_uint index = (cl_uint)(context - pool->contexts);
+    cl_ulong head = state->head.load(std::memory_order_relaxed);
+
+    do
+    {
+        state->next[index].store((cl_uint)head, std::memory_order_relaxed);
+    } while (!state->head.compare_exchange_weak(head, makeHead(head, index),
+                    std::memory_order_release, std::memory_order_relaxed));
+}
+
+/**
+*******************************************************************************
+*  @fn     getMedianContextPoolWaits
+*  @brief  Number of times a caller found all contexts checked out, a sign 
+*          the pool is smaller than the number of concurrent callers
+*
+*  @param[in] pool : pool
+*
+*  @return cl_ulong : number of waits
+*******************************************************************************
+*/
+cl_ulong getMedianContextPoolWaits(const MedianContextPool *pool)
+{
+    return pool->state ? pool->state->waits.load() : 0;
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyMedianContextPool
+*  @brief  Frees the pool. The owner releases the context resources first.
+*
+*  @param[in/out] pool : pool
+*
+*  @return void
+*******************************************************************************
+*/
+void destroyMedianContextPool(MedianContextPool *pool)
+{
+    if (pool->state)
+    {
+        delete[] pool->state->next;
+        delete pool->state;
+    }
+    free(pool->contexts);
+    memset(pool, 0, sizeof(MedianContextPool));
+}
@@ -0,0 +1,426 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <cpuMedianFilter.cpp>
+*
+* @brief Native CPU median filter. Runs of CPU_MEDIAN_CHUNK pixels of a row 
+*        go through the sorting networks of the OpenCL kernel together, so 
+*        every compare-exchange is a vectorizable min/max over the run.
+*
+********************************************************************************
+*/
+#include "cpuMedianFilter.h"
+#include "utils.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+*******************************************************************************
+*  @fn     filterRows
+*  @brief  Filters output rows [firstRow, endRow)
+*
+*  @param[in] input        : top left pixel of the padded input
+*  @param[in] inputPitch   : input row pitch in pixels
+*  @param[out] output      : first output pixel
+*  @param[in] outputPitch  : output row pitch in pixels
+*  @param[in] width        : image width
+*  @param[in] firstRow     : first output row
+*  @param[in] endRow       : output row after the last one
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint FILTERSIZE>
+static void filterRows(const T *input, size_t inputPitch, T *output, size_t outputPitch,
+                cl_uint width, cl_uint firstRow, cl_uint endRow)
+{
+    T window[FILTERSIZE * FILTERSIZE][CPU_MEDIAN_CHUNK];
+    const T *rows[FILTERSIZE];
+    memset(window, 0, sizeof(window));
+
+    for (cl_uint row = firstRow; row < endRow; row++)
+    {
+        for (cl_uint i = 0; i < FILTERSIZE; i++)
+            rows[i] = input + (row + i) * inputPitch;
+        filterMedianRow<T, FILTERSIZE, FILTERSIZE>(rows, output + row * outputPitch, width,
+                        window);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     filterRowsInPlace
+*  @brief  Filters rows [firstRow, endRow) of an image over themselves. A 
+*          ring of FILTERSIZE padded rows holds the window: each row enters
+*          it, bordered by the border mode, before it is overwritten, so the
+*          rows above the current one are still read as they were. The rows
+*          outside the band are copied by the caller before any band starts.
+*
+*  @param[in/out] image  : image filtered in place
+*  @param[in] saved      : FILTERSIZE / 2 padded rows above the band, as many
+*                          below, then room for the ring
+*  @param[in] firstRow   : first row of the band
+*  @param[in] endRow     : row after the last one of the band
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint FILTERSIZE>
+static void filterRowsInPlace(const MedianImage *image, T *saved, cl_uint firstRow,
+                cl_uint endRow)
+{
+    const cl_uint radius = FILTERSIZE / 2;
+    size_t pitch = image->width + FILTERSIZE - 1;
+    T *above = saved;
+    T *below = saved + radius * pitch;
+    T *ring = saved + 2 * radius * pitch;
+    T window[FILTERSIZE * FILTERSIZE][CPU_MEDIAN_CHUNK];
+    const T *rows[FILTERSIZE];
+    memset(window, 0, sizeof(window));
+
+    for (cl_uint row = firstRow; row < endRow && row < firstRow + radius; row++)
+        fillMedianHalo(image, -(cl_int)radius, row, (cl_uint)pitch, 1,
+                        (cl_uchar *)(ring + (row - firstRow) % FILTERSIZE * pitch), pitch);
+
+    for (cl_uint row = firstRow; row < endRow; row++)
+    {
+        /* The slot of the row that just left the window */
+        cl_uint next = row + radius;
+        if (next < endRow)
+            fillMedianHalo(image, -(cl_int)radius, next, (cl_uint)pitch, 1,
+                            (cl_uchar *)(ring + (next - firstRow) % FILTERSIZE * pitch), pitch);
+
+        for (cl_uint i = 0; i < FILTERSIZE; i++)
+        {
+            cl_uint y = row + i;
+            if (y < firstRow + radius)
+                rows[i] = above + (y - firstRow) * pitch;
+            else if (y >= endRow + radius)
+                rows[i] = below + (y - endRow - radius) * pitch;
+            else
+                rows[i] = ring + (y - radius - firstRow) % FILTERSIZE * pitch;
+        }
+        filterMedianRow<T, FILTERSIZE, FILTERSIZE>(rows,
+                        (T *)getMedianImagePixel(image, 0, row), image->width, window);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     filterImage
+*  @brief  Splits the image into bands of rows, one per thread
+*
+*  @param[in] inputImg     : top left pixel of the padded input
+*  @param[in] inputPitch   : input row pitch in pixels
+*  @param[out] outputImg   : first output pixel
+*  @param[in] outputPitch  : output row pitch in pixels
+*  @param[in] width        : image width
+*  @param[in] height       : image height
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint FILTERSIZE>
+static void filterImage(const cl_uchar *inputImg, size_t inputPitch, cl_uchar *outputImg,
+                size_t outputPitch, cl_uint width, cl_uint height)
+{
+    const T *input = (const T *)inputImg;
+    T *output = (T *)outputImg;
+
+    size_t blocks = (size_t)width * height / CPU_MEDIAN_BLOCK_PIXELS;
+    cl_uint numThreads = (cl_uint)std::min((size_t)getNumCpus(), std::max(blocks, (size_t)1));
+    if (numThreads > height)
+        numThreads = height;
+    if (numThreads <= 1)
+    {
+        filterRows<T, FILTERSIZE>(input, inputPitch, output, outputPitch, width, 0, height);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (cl_uint t = 0; t < numThreads; t++)
+    {
+        cl_uint firstRow = (cl_uint)((size_t)height * t / numThreads);
+        cl_uint endRow = (cl_uint)((size_t)height * (t + 1) / numThreads);
+        threads.push_back(std::thread(filterRows<T, FILTERSIZE>, input, inputPitch, output,
+                        outputPitch, width, firstRow, endRow));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+/**
+*******************************************************************************
+*  @fn     runCpuMedianFilter
+*  @brief  Filters an image on the host CPU. The input carries a filterSize/2
+*          border on all sides, like the input of runIppMedianFilter; results
+*          are identical to ipp and the OpenCL kernels.
+*
+*  @param[in] inputImg     : top left pixel of the padded input
+*  @param[in] inputPitch   : input row pitch in pixels, at least 
+*                            width + filterSize - 1
+*  @param[in] filterSize   : 3 or 5
+*  @param[out] outputImg   : first output pixel
+*  @param[in] outputPitch  : output row pitch in pixels
+*  @param[in] width        : image width
+*  @param[in] height       : image height
+*  @param[in] bitWidth     : 8 or 16 bit samples
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runCpuMedianFilter(const cl_uchar *inputImg, size_t inputPitch, cl_uint filterSize,
+                cl_uchar *outputImg, size_t outputPitch, cl_uint width, cl_uint height,
+                cl_uint bitWidth)
+{
+    CHECK_RESULT(!(filterSize == 3 || filterSize == 5),
+                    "Unsupported filter size %d, only 3 and 5 are supported", filterSize);
+    CHECK_RESULT(!(bitWidth == 8 || bitWidth == 16),
+                    "Un-supported bitWidth, only 8 and 16 bits are supported");
+    CHECK_RESULT(inputPitch < width + filterSize - 1, "Input pitch %lu is below %d",
+                    (unsigned long)inputPitch, width + filterSize - 1);
+
+    if (bitWidth == 8 && filterSize == 3)
+        filterImage<cl_uchar, 3>(inputImg, inputPitch, outputImg, outputPitch, width, height);
+    else if (bitWidth == 8)
+        filterImage<cl_uchar, 5>(inputImg, inputPitch, outputImg, outputPitch, width, height);
+    else if (filterSize == 3)
+        filterImage<cl_ushort, 3>(inputImg, inputPitch, outputImg, outputPitch, width, height);
+    else
+        filterImage<cl_ushort, 5>(inputImg, inputPitch, outputImg, outputPitch, width, height);
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     filterImageInPlace
+*  @brief  Splits the image into bands of rows, one per thread. The rows 
+*          around each band are saved first, as a neighbouring band 
+*          overwrites them.
+*
+*  @param[in/out] image : image filtered in place
+*  @param[in] saved     : 2 * FILTERSIZE - 1 padded rows per thread
+*  @param[in] numThreads : number of bands
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint FILTERSIZE>
+static void filterImageInPlace(const MedianImage *image, cl_uchar *saved, cl_uint numThreads)
+{
+    cl_int radius = FILTERSIZE / 2;
+    size_t pitch = image->width + FILTERSIZE - 1;
+    size_t bandPixels = (2 * FILTERSIZE - 1) * pitch;
+
+    for (cl_uint t = 0; t < numThreads; t++)
+    {
+        cl_int firstRow = (cl_int)((size_t)image->height * t / numThreads);
+        cl_int endRow = (cl_int)((size_t)image->height * (t + 1) / numThreads);
+        T *band = (T *)saved + t * bandPixels;
+        fillMedianHalo(image, -radius, firstRow - radius, (cl_uint)pitch, radius,
+                        (cl_uchar *)band, pitch);
+        fillMedianHalo(image, -radius, endRow, (cl_uint)pitch, radius,
+                        (cl_uchar *)(band + radius * pitch), pitch);
+    }
+
+    if (numThreads == 1)
+    {
+        filterRowsInPlace<T, FILTERSIZE>(image, (T *)saved, 0, image->height);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (cl_uint t = 0; t < numThreads; t++)
+    {
+        cl_uint firstRow = (cl_uint)((size_t)image->height * t / numThreads);
+        cl_uint endRow = (cl_uint)((size_t)image->height * (t + 1) / numThreads);
+        threads.push_back(std::thread(filterRowsInPlace<T, FILTERSIZE>, image,
+                        (T *)saved + t * bandPixels, firstRow, endRow));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+/**
+*******************************************************************************
+*  @fn     filterImageTiled
+*  @brief  Runs the tiles of the image with the border mode of src
+*
+*  @param[in] src        : source
+*  @param[in] dst        : destination of the same size
+*  @param[in] tileSize   : tile side in pixels
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename T, cl_uint FILTERSIZE>
+static void filterImageTiled(const MedianImage *src, const MedianImage *dst, cl_uint tileSize)
+{
+    switch (src->borderMode)
+    {
+    case MEDIAN_BORDER_REPLICATE:
+        runMedianTiles<T, FILTERSIZE, FILTERSIZE, MEDIAN_BORDER_REPLICATE>(src, dst, tileSize,
+                        getNumCpus());
+        break;
+    case MEDIAN_BORDER_REFLECT_101:
+        runMedianTiles<T, FILTERSIZE, FILTERSIZE, MEDIAN_BORDER_REFLECT_101>(src, dst,
+                        tileSize, getNumCpus());
+        break;
+    case MEDIAN_BORDER_WRAP:
+        runMedianTiles<T, FILTERSIZE, FILTERSIZE, MEDIAN_BORDER_WRAP>(src, dst, tileSize,
+                        getNumCpus());
+        break;
+    default:
+        runMedianTiles<T, FILTERSIZE, FILTERSIZE, MEDIAN_BORDER_CONSTANT>(src, dst, tileSize,
+                        getNumCpus());
+        break;
+    }
+}
+
+/* Region filter of runMedianFilterRegions; src has a full halo */
+static bool filterRegion(const MedianImage *src, const MedianImage *dst, cl_uint filterSize,
+                void *)
+{
+    cl_int radius = filterSize / 2;
+    return runCpuMedianFilter(getMedianImagePixel(src, -radius, -radius), src->pitch,
+                    filterSize, getMedianImagePixel(dst, 0, 0), dst->pitch, src->width,
+                    src->height, src->bitWidth);
+}
+
+/**
+*******************************************************************************
+*  @fn     runCpuMedianFilterImage
+*  @brief  Filters the ROI of src into the ROI of dst in place in the 
+*          callers' buffers. The halo of src provides the neighbours; where
+*          it is thinner than filterSize / 2 it is completed according to
+*          the border mode of src.
+*
+*  @param[in] src         : source, padded or not
+*  @param[in] dst         : destination of the same size
+*  @param[in] filterSize  : 3 or 5
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runCpuMedianFilterImage(const MedianImage *src, const MedianImage *dst,
+                cl_uint filterSize)
+{
+    return runMedianFilterRegions(src, dst, filterSize, filterRegion, NULL);
+}
+
+/**
+*******************************************************************************
+*  @fn     runCpuMedianFilterInPlace
+*  @brief  Filters the ROI of an image over itself. Neighbours come from the
+*          halo and border mode as in runCpuMedianFilterImage, and results are
+*          identical. Besides the image, each thread keeps only a ring of 
+*          filterSize rows and the filterSize - 1 rows around its band, 
+*          O(width * filterSize) in all, instead of a second image.
+*
+*  @param[in/out] image   : image or view
+*  @param[in] filterSize  : 3 or 5
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runCpuMedianFilterInPlace(const MedianImage *image, cl_uint filterSize)
+{
+    CHECK_RESULT(!(filterSize == 3 || filterSize == 5),
+                    "Unsupported filter size %d, only 3 and 5 are supported", filterSize);
+    CHECK_RESULT(!(image->bitWidth == 8 || image->bitWidth == 16),
+                    "Un-supported bitWidth, only 8 and 16 bits are supported");
+    if (!checkMedianImages(image, image, filterSize))
+        return false;
+    if (image->width == 0 || image->height == 0)
+        return true;
+
+    size_t blocks = (size_t)image->width * image->height / CPU_MEDIAN_BLOCK_PIXELS;
+    cl_uint numThreads = (cl_uint)std::min((size_t)getNumCpus(), std::max(blocks, (size_t)1));
+    if (numThreads > image->height)
+        numThreads = image->height;
+
+    size_t bandBytes = (2 * filterSize - 1) * (image->width + filterSize - 1) * (image->bitWidth / 8);
+    cl_uchar *saved = (cl_uchar *)malloc(numThreads * bandBytes);
+    CHECK_RESULT(saved == NULL, "Malloc failed.\n");
+
+    if (image->bitWidth == 8 && filterSize == 3)
+        filterImageInPlace<cl_uchar, 3>(image, saved, numThreads);
+    else if (image->bitWidth == 8)
+        filterImageInPlace<cl_uchar, 5>(image, saved, numThreads);
+    else if (filterSize == 3)
+        filterImageInPlace<cl_ushort, 3>(image, saved, numThreads);
+    else
+        filterImageInPlace<cl_ushort, 5>(image, saved, numThreads);
+    free(saved);
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     runCpuMedianFilterTiled
+*  @brief  Filters the ROI of src into the ROI of dst tile by tile. The rows
+*          of a row-major window are a pitch apart, so on wide images the 
+*          filterSize rows of a run stop fitting the cache together. Here 
+*          each thread converts one tile and its halo at a time into a 
+*          contiguous block, filters it while the block is in L1 and writes
+*          the result straight into dst; the blocked layout never exists 
+*          for the whole image. Neighbours and results are those of 
+*          runCpuMedianFilterImage.
+*
+*  @param[in] src         : source, padded or not
+*  @param[in] dst         : destination of the same size
+*  @param[in] filterSize  : 3 or 5
+*  @param[in] tileSize    : tile side in pixels, 0 for CPU_MEDIAN_TILE
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runCpuMedianFilterTiled(const MedianImage *src, const MedianImage *dst,
+                cl_uint filterSize, cl_uint tileSize)
+{
+    CHECK_RESULT(!(filterSize == 3 || filterSize == 5),
+                    "Unsupported filter size %d, only 3 and 5 are supported", filterSize);
+    CHECK_RESULT(!(src->bitWidth == 8 || src->bitWidth == 16),
+                    "Un-supported bitWidth, only 8 and 16 bits are supported");
+    if (!checkMedianImages(src, dst, filterSize))
+        return false;
+    if (src->width == 0 || src->height == 0)
+        return true;
+    if (tileSize == 0)
+        tileSize = CPU_MEDIAN_TILE;
+
+    if (src->bitWidth == 8 && filterSize == 3)
+        filterImageTiled<cl_uchar, 3>(src, dst, tileSize);
+    else if (src->bitWidth == 8)
+        filterImageTiled<cl_uchar, 5>(src, dst, tileSize);
+    else if (filterSize == 3)
+        filterImageTiled<cl_ushort, 3>(src, dst, tileSize);
+    else
+        filterImageTiled<cl_ushort, 5>(src, dst, tileSize);
+    return true;
+}
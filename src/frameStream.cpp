@@ -0,0 +1,549 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <frameStream.cpp>
+*
+* @brief Filters a stream of headerless gray8 / gray16le frames read from
+*        stdin or a named pipe and writes the results to stdout or a file,
+*        e.g. between two ffmpeg rawvideo pipes. Reading, filtering and 
+*        writing run on their own threads over double buffered frames.
+*
+********************************************************************************
+*/
+#include "frameStream.h"
+#include "ippMedianFilter.h"
+#include "bufferPool.h"
+#include <string.h>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Frames in flight. Each stage works on one while the next is read. */
+#define FRAME_STREAM_BUFFERS    2
+
+enum
+{
+    FRAME_FREE,                 /**< Ready to be read into */
+    FRAME_READ,                 /**< Holds an input frame */
+    FRAME_FILTERED,             /**< Holds a filtered frame */
+    FRAME_END                   /**< No more frames */
+};
+
+typedef struct StreamFrame
+{
+    cl_uint state;
+    PoolBlock input;            /**< Pinned padded input, its zero border is never written */
+    PoolBlock output;           /**< Pinned */
+    double readTime;            /**< Time the frame was completely read, in seconds */
+} StreamFrame;
+
+/******************************************************************************
+* State shared by the reader, filter and writer                               *
+******************************************************************************/
+typedef struct FrameStream
+{
+    FILE *in;
+    FILE *out;
+    cl_uint width;
+    cl_uint height;
+    cl_uint paddedWidth;
+    cl_uint filterSize;
+    cl_uint bitWidth;
+    StreamFrame frames[FRAME_STREAM_BUFFERS];
+    std::mutex lock;
+    std::condition_variable cond;
+    bool failed;
+    timer clock;                /**< Started before the first read */
+    cl_uint framesWritten;
+    double totalLatency;
+    double minLatency;
+    double maxLatency;
+} FrameStream;
+
+/**
+*******************************************************************************
+*  @fn     waitFrame
+*  @brief  Waits until a frame reaches the given state or the stream fails
+*
+*  @param[in/out] stream  : shared state
+*  @param[in] frame       : frame to wait for
+*  @param[in] state       : expected state; FRAME_END is accepted as well
+*
+*  @return bool : false if the stream has failed
+*******************************************************************************
+*/
+static bool waitFrame(FrameStream *stream, StreamFrame *frame, cl_uint state)
+{
+    std::unique_lock<std::mutex> guard(stream->lock);
+    while (frame->state != state && frame->state != FRAME_END && !stream->failed)
+        stream->cond.wait(guard);
+    return !stream->failed;
+}
+
+static void setFrameState(FrameStream *stream, StreamFrame *frame, cl_uint state)
+{
+    std::lock_guard<std::mutex> guard(stream->lock);
+    frame->state = state;
+    stream->cond.notify_all();
+}
+
+static void failStream(FrameStream *stream)
+{
+    std::lock_guard<std::mutex> guard(stream->lock);
+    stream->failed = true;
+    stream->cond.notify_all();
+}
+
+/**
+*******************************************************************************
+*  @fn     readerThread
+*  @brief  Reads frames row by row into the interior of the padded buffers
+*          until the input ends. A partial last frame is dropped.
+*
+*  @param[in/out] stream : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void readerThread(FrameStream *stream)
+{
+    cl_uint filterRadius = stream->filterSize / 2;
+    size_t bytesPerPixel = stream->bitWidth / 8;
+
+    for (cl_uint i = 0; ; i++)
+    {
+        StreamFrame *frame = &stream->frames[i % FRAME_STREAM_BUFFERS];
+        if (!waitFrame(stream, frame, FRAME_FREE))
+            return;
+
+        cl_uint row = 0;
+        size_t pixels = stream->width;
+        for (; row < stream->height && pixels == stream->width; row++)
+        {
+            cl_uchar *dst = frame->input.host
+                + ((size_t)(row + filterRadius) * stream->paddedWidth + filterRadius) * bytesPerPixel;
+            pixels = fread(dst, bytesPerPixel, stream->width, stream->in);
+        }
+
+        if (pixels != stream->width)
+        {
+            if (row > 1 || pixels > 0 || ferror(stream->in))
+                fprintf(stderr, "Input ended inside frame %d, the partial frame is dropped\n", i);
+            setFrameState(stream, frame, FRAME_END);
+            return;
+        }
+
+        frame->readTime = timerCurrent(&stream->clock);
+        setFrameState(stream, frame, FRAME_READ);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     writerThread
+*  @brief  Writes filtered frames in order and records their latency from 
+*          the end of their read to the end of their write
+*
+*  @param[in/out] stream : shared state
+*
+*  @return void
+*******************************************************************************
+*/
+static void writerThread(FrameStream *stream)
+{
+    size_t frameSize = (size_t)stream->width * stream->height * (stream->bitWidth / 8);
+
+    for (cl_uint i = 0; ; i++)
+    {
+        StreamFrame *frame = &stream->frames[i % FRAME_STREAM_BUFFERS];
+        if (!waitFrame(stream, frame, FRAME_FILTERED) || frame->state == FRAME_END)
+            break;
+
+        if (fwrite(frame->output.host, 1, frameSize, stream->out) != frameSize
+                        || fflush(stream->out) != 0)
+        {
+            fprintf(stderr, "Failed to write frame %d\n", i);
+            failStream(stream);
+            break;
+        }
+
+        double latency = timerCurrent(&stream->clock) - frame->readTime;
+        stream->totalLatency += latency;
+        if (latency < stream->minLatency || stream->framesWritten == 0)
+            stream->minLatency = latency;
+        if (latency > stream->maxLatency)
+            stream->maxLatency = latency;
+        stream->framesWritten++;
+
+        setFrameState(stream, frame, FRAME_FREE);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     openFrameOutput
+*  @brief  Opens the output stream. For stdout the frames get a duplicate of 
+*          the stdout descriptor and stdout itself is pointed at stderr, so 
+*          that log messages cannot end up inside the frame data.
+*
+*  @param[in] frameOutput  : output path or FRAME_STREAM_STDIO
+*
+*  @return FILE* : output stream, NULL on failure
+*******************************************************************************
+*/
+static FILE *openFrameOutput(const char *frameOutput)
+{
+    if (strcmp(frameOutput, FRAME_STREAM_STDIO) != 0)
+        return fopen(frameOutput, "wb");
+
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    if (fd < 0)
+        return NULL;
+    _setmode(fd, _O_BINARY);
+    _dup2(_fileno(stderr), _fileno(stdout));
+    return _fdopen(fd, "wb");
+#else
+    int fd = dup(fileno(stdout));
+    if (fd < 0)
+        return NULL;
+    dup2(fileno(stderr), fileno(stdout));
+    return fdopen(fd, "wb");
+#endif
+}
+
+/**
+*******************************************************************************
+*  @fn     closeFrameFiles
+*  @brief  Closes the input and output of a stream. stdin stays open; the
+*          output, e.g. the duplicate of the stdout descriptor, is closed.
+*
+*  @param[in/out] stream : the stream
+*
+*  @return void
+*******************************************************************************
+*/
+static void closeFrameFiles(FrameStream *stream)
+{
+    if (stream->in != stdin)
+        fclose(stream->in);
+    fclose(stream->out);
+}
+
+/**
+*******************************************************************************
+*  @fn     closeFrameStream
+*  @brief  Closes the files of a stream and releases its buffers and kernel,
+*          at its end or after a failed setup. Blocks that were not acquired
+*          are empty and ignored.
+*
+*  @param[in/out] stream     : the stream
+*  @param[in/out] pool       : pool of all blocks, destroyed
+*  @param[in/out] input      : device input
+*  @param[in/out] output     : device output
+*  @param[in/out] ippOutput  : verification output
+*  @param[in] ippBuffer      : IPP scratch buffer or NULL
+*  @param[in] kernel         : median filter kernel
+*  @param[out] poolStats     : statistics of the pool before it is destroyed,
+*                              or NULL
+*
+*  @return void
+*******************************************************************************
+*/
+static void closeFrameStream(FrameStream *stream, BufferPool *pool, PoolBlock *input,
+                PoolBlock *output, PoolBlock *ippOutput, Ipp8u *ippBuffer, cl_kernel kernel,
+                BufferPoolStats *poolStats)
+{
+    closeFrameFiles(stream);
+    for (cl_uint i = 0; i < FRAME_STREAM_BUFFERS; i++)
+    {
+        releasePoolBlock(pool, &stream->frames[i].input);
+        releasePoolBlock(pool, &stream->frames[i].output);
+    }
+    releasePoolBlock(pool, ippOutput);
+    releasePoolBlock(pool, input);
+    releasePoolBlock(pool, output);
+    if (poolStats)
+        getBufferPoolStats(pool, poolStats);
+    destroyBufferPool(pool);
+    if (ippBuffer)
+        ippFree(ippBuffer);
+    clReleaseKernel(kernel);
+}
+
+/**
+*******************************************************************************
+*  @fn     runFrameStream
+*  @brief  Filters fixed size gray frames until the input ends. The reader 
+*          and writer threads overlap the pipe I/O with the filtering; the 
+*          per frame latency and the frame rate are printed at the end.
+*
+*  @param[in/out] infoDeviceOcl : Structure which holds openCL related params
+*  @param[in] frameInput        : input path (file or named pipe), or "-" for stdin
+*  @param[in] frameOutput       : output path, or "-" for stdout
+*  @param[in] width             : frame width
+*  @param[in] height            : frame height
+*  @param[in] filterSize        : filter size (only 3 and 5 are currently supported)
+*  @param[in] bitWidth          : 8 for gray8, 16 for gray16le frames
+*  @param[in] deviceNum         : device on which to run OpenCL kernels
+*  @param[in] useLds            : Should the OpenCL kernel use LDS memory for input
+*  @param[in] fixedRes          : Compile the frame dimensions into the kernel
+*  @param[in] usePacked         : Use the packed kernel for 8 bit input
+*  @param[in] verify            : Compare every frame against ipp
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runFrameStream(DeviceInfo *infoDeviceOcl, const char *frameInput, const char *frameOutput,
+                cl_uint width, cl_uint height, cl_uint filterSize, cl_uint bitWidth,
+                cl_uint deviceNum, cl_int useLds, cl_int fixedRes, cl_int usePacked,
+                cl_uint verify)
+{
+    cl_int status;
+    FrameStream stream;
+
+    CHECK_RESULT(width == 0 || height == 0, "The frame size must be given with -rawSize WxH");
+
+    /* Open the output first so that nothing is logged to a stdout frame stream */
+    stream.out = openFrameOutput(frameOutput);
+    CHECK_RESULT(stream.out == NULL, "Unable to open frame output %s", frameOutput);
+
+    if (strcmp(frameInput, FRAME_STREAM_STDIO) == 0)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        stream.in = stdin;
+    }
+    else
+    {
+        stream.in = fopen(frameInput, "rb");
+        if (stream.in == NULL)
+        {
+            printf("Unable to open frame input %s\n", frameInput);
+            fclose(stream.out);
+            return false;
+        }
+    }
+
+    if (initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        closeFrameFiles(&stream);
+        return false;
+    }
+
+    MedianKernelConfig config;
+    config.filtSize = filterSize;
+    config.bitWidth = bitWidth;
+    config.useLds = useLds;
+    config.deviceType = infoDeviceOcl->mDeviceType;
+    config.usePacked = usePacked;
+    config.fixedWidth = fixedRes ? width : 0;
+    config.fixedHeight = fixedRes ? height : 0;
+    config.fixedPitch = fixedRes ? width + filterSize - 1 : 0;
+    config.cacheBinary = fixedRes;
+
+    cl_kernel medianFilter;
+    if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    &medianFilter, &config) == false)
+    {
+        printf("Error in buildMedianFilterKernel.\n");
+        closeFrameFiles(&stream);
+        return false;
+    }
+
+    /**************************************************************************
+    * Frame buffers and device memory are checked out of a pool once for the
+    * stream. Frames are pinned so that their transfers need no staging copy.
+    ***************************************************************************/
+    size_t bytesPerPixel = bitWidth / 8;
+    stream.width = width;
+    stream.height = height;
+    stream.paddedWidth = width + filterSize - 1;
+    stream.filterSize = filterSize;
+    stream.bitWidth = bitWidth;
+    stream.failed = false;
+    stream.framesWritten = 0;
+    stream.totalLatency = 0;
+    stream.minLatency = 0;
+    stream.maxLatency = 0;
+
+    size_t inputSize = (size_t)stream.paddedWidth * (height + filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)width * height * bytesPerPixel;
+    BufferPool pool;
+    PoolBlock input, output, ippOutput;
+    Ipp8u *ippBuffer = NULL;
+    createBufferPool(infoDeviceOcl->mCtx, infoDeviceOcl->mQueue, 0, &pool);
+    memset(&input, 0, sizeof(PoolBlock));
+    memset(&output, 0, sizeof(PoolBlock));
+    memset(&ippOutput, 0, sizeof(PoolBlock));
+    memset(stream.frames, 0, sizeof(stream.frames));
+    for (cl_uint i = 0; i < FRAME_STREAM_BUFFERS; i++)
+    {
+        StreamFrame *frame = &stream.frames[i];
+        frame->state = FRAME_FREE;
+        if (!acquirePoolBlock(&pool, POOL_PINNED, inputSize, &frame->input)
+                        || !acquirePoolBlock(&pool, POOL_PINNED, outputSize, &frame->output))
+        {
+            printf("Unable to allocate the frame buffers\n");
+            closeFrameStream(&stream, &pool, &input, &output, &ippOutput, ippBuffer,
+                            medianFilter, NULL);
+            return false;
+        }
+        memset(frame->input.host, 0, inputSize);
+    }
+
+    MedianOutputLayout layout;
+    initMedianOutputLayout(&layout, width, 0, OUT_BORDER_NONE);
+    if (!acquirePoolBlock(&pool, POOL_DEVICE, inputSize, &input)
+                    || !acquirePoolBlock(&pool, POOL_DEVICE, outputSize, &output)
+                    || !setMedianFilterKernelArgs(medianFilter, input.mem, output.mem, width,
+                            height, stream.paddedWidth, &layout))
+    {
+        printf("Unable to set up the device buffers\n");
+        closeFrameStream(&stream, &pool, &input, &output, &ippOutput, ippBuffer,
+                        medianFilter, NULL);
+        return false;
+    }
+
+    if (verify)
+    {
+        initIppMedianFilter(filterSize, width, height, bitWidth, &ippBuffer);
+        if (!acquirePoolBlock(&pool, POOL_HOST, outputSize, &ippOutput))
+        {
+            printf("Malloc failed.\n");
+            closeFrameStream(&stream, &pool, &input, &output, &ippOutput, ippBuffer,
+                            medianFilter, NULL);
+            return false;
+        }
+    }
+
+    printf("Executing Median filter on a stream of %dx%d gray%d frames", width, height, bitWidth);
+    printf("\n\tFilter size: %dx%d\n", filterSize, filterSize);
+    printMedianFilterKernelInfo(medianFilter, infoDeviceOcl->mDevice);
+    printf("\n\n");
+
+    /**************************************************************************
+    * Filter frames in order while the reader and writer threads move data
+    ***************************************************************************/
+    timerStart(&stream.clock);
+    std::thread reader(readerThread, &stream);
+    std::thread writer(writerThread, &stream);
+
+    cl_uint frames = 0, mismatches = 0;
+    double kernelTime = 0;
+
+    for (;; frames++)
+    {
+        StreamFrame *frame = &stream.frames[frames % FRAME_STREAM_BUFFERS];
+        if (!waitFrame(&stream, frame, FRAME_READ) || frame->state == FRAME_END)
+            break;
+
+        cl_event ev;
+        status = clEnqueueWriteBuffer(infoDeviceOcl->mQueue, input.mem, CL_FALSE, 0, inputSize,
+                        frame->input.host, 0, NULL, NULL);
+        if (status != CL_SUCCESS
+                        || !runMedianFilterKernel(infoDeviceOcl->mQueue, medianFilter,
+                                width, height, &config, &ev))
+        {
+            printf("Error in filtering frame %d\n", frames);
+            failStream(&stream);
+            break;
+        }
+        status = clEnqueueReadBuffer(infoDeviceOcl->mQueue, output.mem, CL_TRUE, 0, outputSize,
+                        frame->output.host, 0, NULL, NULL);
+
+        cl_ulong timeStart, timeEnd;
+        clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_START, sizeof(timeStart), &timeStart, NULL);
+        clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_END, sizeof(timeEnd), &timeEnd, NULL);
+        kernelTime += (double)((timeEnd - timeStart) * (1.0e-6));
+        clReleaseEvent(ev);
+
+        if (status != CL_SUCCESS)
+        {
+            printf("Error in clEnqueueReadBuffer. Status: %d\n", status);
+            failStream(&stream);
+            break;
+        }
+
+        if (verify)
+        {
+            runIppMedianFilter(frame->input.host, filterSize, ippOutput.host, width, height,
+                            bitWidth, ippBuffer);
+            if (memcmp(frame->output.host, ippOutput.host, outputSize) != 0)
+                mismatches++;
+        }
+
+        setFrameState(&stream, frame, FRAME_FILTERED);
+    }
+
+    /* Let the writer see the end of the stream after the last filtered frame */
+    StreamFrame *last = &stream.frames[frames % FRAME_STREAM_BUFFERS];
+    if (waitFrame(&stream, last, FRAME_FREE))
+        setFrameState(&stream, last, FRAME_END);
+    else
+        failStream(&stream);
+
+    reader.join();
+    writer.join();
+    double wallTime = timerCurrent(&stream.clock);
+
+    BufferPoolStats poolStats;
+    closeFrameStream(&stream, &pool, &input, &output, &ippOutput, ippBuffer, medianFilter,
+                    &poolStats);
+
+    CHECK_RESULT(stream.failed, "Frame stream failed after %d frames", stream.framesWritten);
+
+    cl_uint written = stream.framesWritten;
+    printf("Filtered %d frames in %f msec: %f frames/sec\n", written, 1000 * wallTime,
+                    wallTime > 0 ? written / wallTime : 0);
+    if (written)
+    {
+        printf("Frame latency (read to written): average %f msec, min %f msec, max %f msec\n",
+                        1000 * stream.totalLatency / written, 1000 * stream.minLatency,
+                        1000 * stream.maxLatency);
+        printf("Average OpenCL kernel time per frame is %f msec\n", kernelTime / written);
+    }
+    printBufferPoolStats(&poolStats);
+    if (verify)
+    {
+        if (mismatches)
+            printf("\nVerification failed for %d frames!!\n\n", mismatches);
+        else
+            printf("\nVerification succeeded!!\n\n");
+    }
+    return true;
+}
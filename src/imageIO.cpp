@@ -0,0 +1,1479 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <imageIO.cpp>
+*
+* @brief Contains functions to read and write single channel images directly
+*        from and to the filter buffers
+*
+********************************************************************************
+*/
+#include "imageIO.h"
+#include "utils.h"
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define USE_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(USE_SSSE3)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/******************************************************************************
+* Images are decoded and encoded by several threads in blocks of rows of at  *
+* least this many bytes                                                       *
+******************************************************************************/
+#define PARALLEL_BLOCK_BYTES    (1 << 20)
+
+/**
+*******************************************************************************
+*  @fn     forEachRowBlock
+*  @brief  Splits numRows rows into contiguous blocks and calls 
+*          body(firstRow, numRows) for each block on its own thread. Small 
+*          images are handled by the calling thread alone.
+*
+*  @param[in] numRows   : number of rows
+*  @param[in] rowBytes  : bytes touched per row
+*  @param[in] body      : function of (cl_uint firstRow, cl_uint numRows)
+*
+*  @return void
+*******************************************************************************
+*/
+template <typename Body>
+static void forEachRowBlock(cl_uint numRows, size_t rowBytes, Body body)
+{
+    size_t blocks = (size_t)numRows * rowBytes / PARALLEL_BLOCK_BYTES;
+    cl_uint numThreads = getNumCpus();
+    if (blocks < numThreads)
+        numThreads = (cl_uint)blocks;
+    if (numThreads <= 1)
+    {
+        body(0, numRows);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    cl_uint rowsPerThread = (numRows + numThreads - 1) / numThreads;
+    for (cl_uint first = rowsPerThread; first < numRows; first += rowsPerThread)
+    {
+        cl_uint rows = (numRows - first < rowsPerThread) ? numRows - first : rowsPerThread;
+        threads.push_back(std::thread(body, first, rows));
+    }
+    body(0, rowsPerThread);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+/******************************************************************************
+* Little endian field access for file headers                                 *
+******************************************************************************/
+static inline cl_uint readLe16(const cl_uchar *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline cl_uint readLe32(const cl_uchar *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((cl_uint)p[3] << 24);
+}
+
+static inline void writeLe16(cl_uchar *p, cl_uint v)
+{
+    p[0] = (cl_uchar)v;
+    p[1] = (cl_uchar)(v >> 8);
+}
+
+static inline void writeLe32(cl_uchar *p, cl_uint v)
+{
+    writeLe16(p, v);
+    writeLe16(p + 2, v >> 16);
+}
+
+/**
+*******************************************************************************
+*  @fn     mapFile
+*  @brief  Maps a whole file read only into memory
+*
+*  @param[in] filename  : file to map
+*  @param[out] file     : mapping
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool mapFile(const char *filename, MappedFile *file)
+{
+    file->data = NULL;
+    file->size = 0;
+    file->borrowed = 0;
+#ifdef _WIN32
+    file->hMapping = NULL;
+    file->hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    CHECK_RESULT(file->hFile == INVALID_HANDLE_VALUE, "Unable to open %s", filename);
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file->hFile, &fileSize);
+    file->size = (size_t)fileSize.QuadPart;
+
+    file->hMapping = CreateFileMappingA(file->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->hMapping != NULL)
+        file->data = (cl_uchar *)MapViewOfFile(file->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to map %s", filename);
+    }
+#else
+    file->fd = open(filename, O_RDONLY);
+    CHECK_RESULT(file->fd < 0, "Unable to open %s", filename);
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0 || st.st_size == 0)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to stat %s", filename);
+    }
+    file->size = (size_t)st.st_size;
+
+    void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to map %s", filename);
+    }
+    madvise(data, file->size, MADV_SEQUENTIAL);
+    file->data = (cl_uchar *)data;
+#endif
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     createMappedFile
+*  @brief  Creates a zero filled file of the given size and maps it for 
+*          writing. Disjoint parts of the mapping can be written concurrently.
+*
+*  @param[in] filename  : file to create
+*  @param[in] size      : file size in bytes
+*  @param[out] file     : mapping
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createMappedFile(const char *filename, size_t size, MappedFile *file)
+{
+    file->data = NULL;
+    file->size = size;
+    file->borrowed = 0;
+#ifdef _WIN32
+    file->hMapping = NULL;
+    file->hFile = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    CHECK_RESULT(file->hFile == INVALID_HANDLE_VALUE, "Unable to create %s", filename);
+
+    file->hMapping = CreateFileMappingA(file->hFile, NULL, PAGE_READWRITE,
+                    (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+    if (file->hMapping != NULL)
+        file->data = (cl_uchar *)MapViewOfFile(file->hMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (file->data == NULL)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to map %s", filename);
+    }
+#else
+    file->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK_RESULT(file->fd < 0, "Unable to create %s", filename);
+
+    if (ftruncate(file->fd, (off_t)size) != 0)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to resize %s", filename);
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        unmapFile(file);
+        CHECK_RESULT(true, "Unable to map %s", filename);
+    }
+    file->data = (cl_uchar *)data;
+#endif
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     unmapFile
+*  @brief  Releases a mapping created by mapFile
+*
+*  @param[in/out] file : mapping
+*
+*  @return void
+*******************************************************************************
+*/
+void unmapFile(MappedFile *file)
+{
+    if (file->borrowed)
+    {
+        file->data = NULL;
+        file->size = 0;
+        return;
+    }
+#ifdef _WIN32
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->hMapping)
+        CloseHandle(file->hMapping);
+    if (file->hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(file->hFile);
+    file->hMapping = NULL;
+    file->hFile = INVALID_HANDLE_VALUE;
+#else
+    if (file->data)
+        munmap((void *)file->data, file->size);
+    if (file->fd >= 0)
+        close(file->fd);
+    file->fd = -1;
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+/**
+*******************************************************************************
+*  @fn     seekFile
+*  @brief  Sets the file position, with 64 bit offsets on all platforms
+*
+*  @param[in] fp      : file
+*  @param[in] offset  : byte offset from the start of the file
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool seekFile(FILE *fp, long long offset)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, offset, SEEK_SET) == 0;
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+/**
+*******************************************************************************
+*  @fn     getImageFormat
+*  @brief  Identifies the file format from the file name extension. Names 
+*          ending in .pgm or .pnm are PGM, .raw is raw, .tif or .tiff is TIFF,
+*          .y4m is YUV4MPEG2, anything else is BMP.
+*
+*  @param[in] filename  : image file name
+*
+*  @return cl_uint : IMAGE_FORMAT_*
+*******************************************************************************
+*/
+cl_uint getImageFormat(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+    if (ext == NULL)
+        return IMAGE_FORMAT_BMP;
+
+    char lower[8] = { 0 };
+    for (int i = 0; i < 7 && ext[i + 1]; i++)
+        lower[i] = (char)tolower((unsigned char)ext[i + 1]);
+
+    if (strcmp(lower, "pgm") == 0 || strcmp(lower, "pnm") == 0)
+        return IMAGE_FORMAT_PGM;
+    if (strcmp(lower, "raw") == 0)
+        return IMAGE_FORMAT_RAW;
+    if (strcmp(lower, "tif") == 0 || strcmp(lower, "tiff") == 0)
+        return IMAGE_FORMAT_TIFF;
+    if (strcmp(lower, "y4m") == 0)
+        return IMAGE_FORMAT_Y4M;
+    return IMAGE_FORMAT_BMP;
+}
+
+/**
+*******************************************************************************
+*  @fn     parseBmp
+*  @brief  Parses the headers of a BMP file held in image->file
+*
+*  @param[in] filename   : file name for messages
+*  @param[in/out] image  : image with its file set
+*
+*  @return bool : true if successful; otherwise false, with the file closed.
+*******************************************************************************
+*/
+static bool parseBmp(const char *filename, MappedImage *image)
+{
+    const cl_uchar *data = image->file.data;
+    size_t size = image->file.size;
+
+    if (size < 54 || data[0] != 'B' || data[1] != 'M')
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "%s is not a BMP file", filename);
+    }
+
+    cl_uint pixelOffset = readLe32(data + 10);
+    cl_uint infoSize = readLe32(data + 14);
+    cl_int width = (cl_int)readLe32(data + 18);
+    cl_int height = (cl_int)readLe32(data + 22);
+    cl_uint compression = readLe32(data + 30);
+
+    image->format = IMAGE_FORMAT_BMP;
+    image->bitsPerPixel = readLe16(data + 28);
+    image->sampleBits = 8;
+    image->bigEndian = 0;
+    image->topDown = (height < 0);
+    image->width = width;
+    image->height = (height < 0) ? -height : height;
+    image->rowStride = ((size_t)image->width * image->bitsPerPixel / 8 + 3) & ~(size_t)3;
+    image->pixels = data + pixelOffset;
+
+    /* The palette follows the info header, biClrUsed entries or all 256 */
+    size_t paletteOffset = 14 + (size_t)infoSize;
+    cl_uint colors = 0;
+    if (image->bitsPerPixel == 8)
+    {
+        colors = readLe32(data + 46);
+        if (colors == 0)
+            colors = BMP_PALETTE_ENTRIES;
+    }
+
+    if (compression != 0 || width <= 0 || infoSize < 40 || !(image->bitsPerPixel == 8
+                    || image->bitsPerPixel == 24 || image->bitsPerPixel == 32)
+                    || (size_t)pixelOffset + image->rowStride * image->height > size)
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "Only uncompressed 8, 24 and 32 bit BMP files are supported");
+    }
+    if (colors > BMP_PALETTE_ENTRIES || paletteOffset + 4 * (size_t)colors > pixelOffset)
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "%s has an invalid palette", filename);
+    }
+
+    /* Pixels beyond the entries of the file read black */
+    memset(image->palette, 0, sizeof(image->palette));
+    memcpy(image->palette, data + paletteOffset, 4 * (size_t)colors);
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     openBmp
+*  @brief  Maps a BMP file and parses its headers. Pixel data is not touched.
+*
+*  @param[in] filename  : BMP file name
+*  @param[out] image    : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openBmp(const char *filename, MappedImage *image)
+{
+    return mapFile(filename, &image->file) && parseBmp(filename, image);
+}
+
+/**
+*******************************************************************************
+*  @fn     readPnmValue
+*  @brief  Reads the next decimal header value of a PNM file, skipping white
+*          space and comments
+*
+*  @param[in] data      : file contents
+*  @param[in] size      : file size
+*  @param[in/out] pos   : read position
+*  @param[out] value    : header value
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool readPnmValue(const cl_uchar *data, size_t size, size_t *pos, cl_uint *value)
+{
+    while (*pos < size && (isspace(data[*pos]) || data[*pos] == '#'))
+    {
+        if (data[*pos] == '#')
+        {
+            while (*pos < size && data[*pos] != '\n')
+                (*pos)++;
+        }
+        else
+        {
+            (*pos)++;
+        }
+    }
+
+    if (*pos >= size || !isdigit(data[*pos]))
+        return false;
+
+    *value = 0;
+    while (*pos < size && isdigit(data[*pos]))
+        *value = *value * 10 + (data[(*pos)++] - '0');
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     parsePgm
+*  @brief  Parses the header of a PGM file held in image->file
+*
+*  @param[in] filename   : file name for messages
+*  @param[in/out] image  : image with its file set
+*
+*  @return bool : true if successful; otherwise false, with the file closed.
+*******************************************************************************
+*/
+static bool parsePgm(const char *filename, MappedImage *image)
+{
+    const cl_uchar *data = image->file.data;
+    size_t size = image->file.size;
+    size_t pos = 2;
+    cl_uint width, height, maxValue;
+
+    if (size < 2 || data[0] != 'P' || data[1] != '5'
+                    || !readPnmValue(data, size, &pos, &width)
+                    || !readPnmValue(data, size, &pos, &height)
+                    || !readPnmValue(data, size, &pos, &maxValue)
+                    || maxValue == 0 || maxValue > 65535)
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "%s is not a binary PGM file", filename);
+    }
+
+    /* A single white space character separates the header from the samples */
+    pos++;
+
+    image->format = IMAGE_FORMAT_PGM;
+    image->width = width;
+    image->height = height;
+    image->bitsPerPixel = (maxValue > 255) ? 16 : 8;
+    image->sampleBits = 1;
+    while ((1u << image->sampleBits) - 1 < maxValue)
+        image->sampleBits++;
+    image->bigEndian = 1;
+    image->topDown = 1;
+    image->rowStride = (size_t)width * image->bitsPerPixel / 8;
+    image->pixels = data + pos;
+
+    if (width == 0 || pos + image->rowStride * height > size)
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "%s is truncated", filename);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     openPgm
+*  @brief  Maps a binary (P5) PGM file and parses its header. Samples are 8 
+*          bit for a maximum value below 256, else 16 bit big endian.
+*
+*  @param[in] filename  : PGM file name
+*  @param[out] image    : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openPgm(const char *filename, MappedImage *image)
+{
+    return mapFile(filename, &image->file) && parsePgm(filename, image);
+}
+
+/**
+*******************************************************************************
+*  @fn     parseRaw
+*  @brief  Describes a raw file held in image->file
+*
+*  @param[in] filename      : file name for messages
+*  @param[in] width         : image width
+*  @param[in] height        : image height
+*  @param[in] bitsPerPixel  : 8 or 16
+*  @param[in/out] image     : image with its file set
+*
+*  @return bool : true if successful; otherwise false, with the file closed.
+*******************************************************************************
+*/
+static bool parseRaw(const char *filename, cl_uint width, cl_uint height,
+                cl_uint bitsPerPixel, MappedImage *image)
+{
+    if (width == 0 || height == 0 || !(bitsPerPixel == 8 || bitsPerPixel == 16))
+    {
+        closeImage(image);
+        CHECK_RESULT(width == 0 || height == 0, "The size of raw input %s is not given", filename);
+        CHECK_RESULT(true, "Raw input must be 8 or 16 bit");
+    }
+
+    image->format = IMAGE_FORMAT_RAW;
+    image->width = width;
+    image->height = height;
+    image->bitsPerPixel = bitsPerPixel;
+    image->sampleBits = bitsPerPixel;
+    image->bigEndian = 0;
+    image->topDown = 1;
+    image->rowStride = (size_t)width * bitsPerPixel / 8;
+    image->pixels = image->file.data;
+
+    if (image->rowStride * height > image->file.size)
+    {
+        closeImage(image);
+        CHECK_RESULT(true, "%s is smaller than %dx%d %d bit pixels", filename,
+                        width, height, bitsPerPixel);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     openRaw
+*  @brief  Maps a headerless file of 8 or 16 bit little endian samples
+*
+*  @param[in] filename      : raw file name
+*  @param[in] width         : image width
+*  @param[in] height        : image height
+*  @param[in] bitsPerPixel  : 8 or 16
+*  @param[out] image        : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openRaw(const char *filename, cl_uint width, cl_uint height,
+                cl_uint bitsPerPixel, MappedImage *image)
+{
+    return mapFile(filename, &image->file)
+                    && parseRaw(filename, width, height, bitsPerPixel, image);
+}
+
+/**
+*******************************************************************************
+*  @fn     openImage
+*  @brief  Maps an image file of the format given by its extension
+*
+*  @param[in] filename  : image file name
+*  @param[in] rawWidth  : width of raw files
+*  @param[in] rawHeight : height of raw files
+*  @param[in] rawBits   : bits per pixel of raw files
+*  @param[out] image    : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openImage(const char *filename, cl_uint rawWidth, cl_uint rawHeight,
+                cl_uint rawBits, MappedImage *image)
+{
+    switch (getImageFormat(filename))
+    {
+    case IMAGE_FORMAT_PGM:
+        return openPgm(filename, image);
+    case IMAGE_FORMAT_RAW:
+        return openRaw(filename, rawWidth, rawHeight, rawBits, image);
+    case IMAGE_FORMAT_TIFF:
+        printf("TIFF files are read a tile at a time with openTiff\n");
+        return false;
+    case IMAGE_FORMAT_Y4M:
+        printf("Y4M files are read a frame at a time with openY4m\n");
+        return false;
+    default:
+        return openBmp(filename, image);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     openImageBuffer
+*  @brief  As openImage, for a file already read into memory. The buffer must
+*          stay valid until closeImage and is not freed by it.
+*
+*  @param[in] filename   : name of the file, selects the format
+*  @param[in] data       : file contents
+*  @param[in] size       : file size in bytes
+*  @param[in] rawWidth   : width of raw files
+*  @param[in] rawHeight  : height of raw files
+*  @param[in] rawBits    : bits per pixel of raw files
+*  @param[out] image     : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openImageBuffer(const char *filename, const cl_uchar *data, size_t size,
+                cl_uint rawWidth, cl_uint rawHeight, cl_uint rawBits, MappedImage *image)
+{
+    cl_uint format = getImageFormat(filename);
+    CHECK_RESULT(format == IMAGE_FORMAT_TIFF || format == IMAGE_FORMAT_Y4M,
+                    "%s can not be decoded from memory", filename);
+
+    image->file.data = (cl_uchar *)data;
+    image->file.size = size;
+    image->file.borrowed = 1;
+#ifdef _WIN32
+    image->file.hFile = INVALID_HANDLE_VALUE;
+    image->file.hMapping = NULL;
+#else
+    image->file.fd = -1;
+#endif
+
+    switch (format)
+    {
+    case IMAGE_FORMAT_PGM:
+        return parsePgm(filename, image);
+    case IMAGE_FORMAT_RAW:
+        return parseRaw(filename, rawWidth, rawHeight, rawBits, image);
+    default:
+        return parseBmp(filename, image);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     extractChannel8
+*  @brief  Copies one byte of every 3 or 4 byte pixel of a row into an 8 bit
+*          row. With SSSE3, 16 pixels are gathered per step by shuffling the 
+*          bytes of the channel out of 3 or 4 loads.
+*
+*  @param[in] src            : first pixel
+*  @param[in] bytesPerPixel  : 3 or 4
+*  @param[in] byteOffset     : byte of the channel within a pixel
+*  @param[out] row           : destination
+*  @param[in] width          : number of pixels
+*
+*  @return void
+*******************************************************************************
+*/
+static void extractChannel8(const cl_uchar *src, cl_uint bytesPerPixel, cl_uint byteOffset,
+                cl_uchar *row, cl_uint width)
+{
+    cl_uint x = 0;
+#ifdef USE_SSSE3
+    /* Mask k moves the channel bytes found in load k to their output position */
+    __m128i masks[4];
+    for (cl_uint k = 0; k < bytesPerPixel; k++)
+    {
+        cl_uchar mask[16];
+        for (cl_uint i = 0; i < 16; i++)
+        {
+            cl_uint pos = i * bytesPerPixel + byteOffset;
+            mask[i] = (pos / 16 == k) ? (cl_uchar)(pos % 16) : 0x80;
+        }
+        masks[k] = _mm_loadu_si128((const __m128i *)mask);
+    }
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const cl_uchar *block = src + x * bytesPerPixel;
+        __m128i out = _mm_setzero_si128();
+        for (cl_uint k = 0; k < bytesPerPixel; k++)
+            out = _mm_or_si128(out, _mm_shuffle_epi8(
+                            _mm_loadu_si128((const __m128i *)(block + 16 * k)), masks[k]));
+        _mm_storeu_si128((__m128i *)(row + x), out);
+    }
+#endif
+    for (; x < width; x++)
+        row[x] = src[x * bytesPerPixel + byteOffset];
+}
+
+/**
+*******************************************************************************
+*  @fn     extractChannel16
+*  @brief  As extractChannel8, widening the bytes to a 16 bit row
+*
+*  @param[in] src            : first pixel
+*  @param[in] bytesPerPixel  : 3 or 4
+*  @param[in] byteOffset     : byte of the channel within a pixel
+*  @param[out] row           : destination
+*  @param[in] width          : number of pixels
+*
+*  @return void
+*******************************************************************************
+*/
+static void extractChannel16(const cl_uchar *src, cl_uint bytesPerPixel, cl_uint byteOffset,
+                cl_ushort *row, cl_uint width)
+{
+    cl_uint x = 0;
+#ifdef USE_SSSE3
+    cl_uchar bytes[256];
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; )
+    {
+        cl_uint count = (width - x < 256) ? (width - x) & ~15u : 256;
+        extractChannel8(src + x * bytesPerPixel, bytesPerPixel, byteOffset, bytes, count);
+        for (cl_uint i = 0; i < count; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+            _mm_storeu_si128((__m128i *)(row + x + i), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128((__m128i *)(row + x + i + 8), _mm_unpackhi_epi8(v, zero));
+        }
+        x += count;
+    }
+#endif
+    for (; x < width; x++)
+        row[x] = src[x * bytesPerPixel + byteOffset];
+}
+
+static void decodeRowBlock(const MappedImage *image, cl_uint channel, cl_uint firstRow,
+                cl_uint numRows, cl_uchar *dst, size_t dstPitch, cl_uint bitWidth);
+
+/**
+*******************************************************************************
+*  @fn     decodeImageChannel
+*  @brief  Decodes one channel of the whole mapped image into a pitched single
+*          channel buffer, e.g. the interior of the padded filter input.
+*
+*  @param[in] image     : image opened with openImage
+*  @param[in] channel   : channel in SDKBitMap uchar4 order
+*  @param[out] dst      : first destination pixel
+*  @param[in] dstPitch  : destination row pitch in pixels
+*  @param[in] bitWidth  : 8 or 16 bit destination
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool decodeImageChannel(const MappedImage *image, cl_uint channel, cl_uchar *dst,
+                size_t dstPitch, cl_uint bitWidth)
+{
+    return decodeImageRows(image, channel, 0, image->height, dst, dstPitch, bitWidth);
+}
+
+/**
+*******************************************************************************
+*  @fn     decodeImageRows
+*  @brief  Decodes one channel of a range of rows of the mapped image row by 
+*          row into a pitched single channel buffer. Rows are counted in file
+*          order. Gray files of the destination bit width are copied without
+*          conversion; 16 bit samples are reduced to their 8 most significant
+*          bits for 8 bit destinations.
+*
+*  @param[in] image     : image opened with openImage
+*  @param[in] channel   : channel in SDKBitMap uchar4 order. For 24/32 bit 
+*                         BMP files 0 = red, 1 = green, 2 = blue; for 8 bit
+*                         BMP files the byte of the palette entry. Ignored 
+*                         for gray files.
+*  @param[in] firstRow  : first row to decode
+*  @param[in] numRows   : number of rows to decode
+*  @param[out] dst      : destination of the first pixel of firstRow
+*  @param[in] dstPitch  : destination row pitch in pixels
+*  @param[in] bitWidth  : 8 or 16 bit destination
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool decodeImageRows(const MappedImage *image, cl_uint channel, cl_uint firstRow,
+                cl_uint numRows, cl_uchar *dst, size_t dstPitch, cl_uint bitWidth)
+{
+    CHECK_RESULT(channel > 3, "Invalid channel %d", channel);
+    CHECK_RESULT(firstRow + numRows > image->height, "Rows %d to %d are out of the image",
+                    firstRow, firstRow + numRows);
+
+    size_t dstPitchBytes = dstPitch * (bitWidth / 8);
+    forEachRowBlock(numRows, image->rowStride,
+        [=](cl_uint blockFirst, cl_uint blockRows)
+        {
+            decodeRowBlock(image, channel, firstRow + blockFirst, blockRows,
+                            dst + blockFirst * dstPitchBytes, dstPitch, bitWidth);
+        });
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     decodeRowBlock
+*  @brief  Decodes a block of rows for decodeImageRows, which has checked the
+*          arguments
+*
+*  @param[in] image     : image opened with openImage
+*  @param[in] channel   : channel in SDKBitMap uchar4 order
+*  @param[in] firstRow  : first row to decode
+*  @param[in] numRows   : number of rows to decode
+*  @param[out] dst      : destination of the first pixel of firstRow
+*  @param[in] dstPitch  : destination row pitch in pixels
+*  @param[in] bitWidth  : 8 or 16 bit destination
+*
+*  @return void
+*******************************************************************************
+*/
+static void decodeRowBlock(const MappedImage *image, cl_uint channel, cl_uint firstRow,
+                cl_uint numRows, cl_uchar *dst, size_t dstPitch, cl_uint bitWidth)
+{
+    static const cl_uint rgbaToBgra[4] = { 2, 1, 0, 3 };
+    cl_uint bytesPerPixel = image->bitsPerPixel / 8;
+    cl_uint byteOffset = rgbaToBgra[channel];
+    cl_uint shift = (image->sampleBits > 8) ? image->sampleBits - 8 : 0;
+    bool gray = (image->format != IMAGE_FORMAT_BMP);
+
+    for (cl_uint y = 0; y < numRows; y++)
+    {
+        const cl_uchar *src = image->pixels + (size_t)(firstRow + y) * image->rowStride;
+
+        if (bitWidth == 8)
+        {
+            cl_uchar *row = dst + y * dstPitch;
+            if (gray && bytesPerPixel == 1)
+            {
+                memcpy(row, src, image->width);
+            }
+            else if (gray)
+            {
+                cl_uint hi = image->bigEndian ? 0 : 1;
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = (cl_uchar)(((src[2 * x + hi] << 8) | src[2 * x + 1 - hi]) >> shift);
+            }
+            else if (bytesPerPixel == 1)
+            {
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = image->palette[src[x] * 4 + channel];
+            }
+            else if (bytesPerPixel == 3 && channel == 3)
+            {
+                memset(row, 0xff, image->width);
+            }
+            else
+            {
+                extractChannel8(src, bytesPerPixel, byteOffset, row, image->width);
+            }
+        }
+        else
+        {
+            cl_ushort *row = (cl_ushort *)dst + y * dstPitch;
+            if (gray && bytesPerPixel == 2 && !image->bigEndian)
+            {
+                /* Little endian samples are the host layout of cl_ushort */
+                memcpy(row, src, image->width * sizeof(cl_ushort));
+            }
+            else if (gray && bytesPerPixel == 2)
+            {
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = (cl_ushort)((src[2 * x] << 8) | src[2 * x + 1]);
+            }
+            else if (gray)
+            {
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = src[x];
+            }
+            else if (bytesPerPixel == 1)
+            {
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = image->palette[src[x] * 4 + channel];
+            }
+            else if (bytesPerPixel == 3 && channel == 3)
+            {
+                for (cl_uint x = 0; x < image->width; x++)
+                    row[x] = 0xff;
+            }
+            else
+            {
+                extractChannel16(src, bytesPerPixel, byteOffset, row, image->width);
+            }
+        }
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     releaseImageRows
+*  @brief  Drops the mapped pages of rows that are no longer needed, so that
+*          streaming through a large file keeps a bounded resident set. The
+*          pages are read from the file again if touched later. Borrowed 
+*          buffers are left alone.
+*
+*  @param[in] image     : image opened with openImage
+*  @param[in] firstRow  : first row to release
+*  @param[in] numRows   : number of rows to release
+*
+*  @return void
+*******************************************************************************
+*/
+void releaseImageRows(const MappedImage *image, cl_uint firstRow, cl_uint numRows)
+{
+    if (image->file.borrowed)
+        return;
+
+    size_t pageSize;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pageSize = info.dwPageSize;
+#else
+    pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    /* Only whole pages inside the row range are released */
+    size_t begin = (size_t)(image->pixels - image->file.data) + (size_t)firstRow * image->rowStride;
+    size_t end = begin + (size_t)numRows * image->rowStride;
+    begin = (begin + pageSize - 1) & ~(pageSize - 1);
+    end &= ~(pageSize - 1);
+    if (end <= begin)
+        return;
+
+#ifdef _WIN32
+    /* Unlocking pages that are not locked removes them from the working set */
+    VirtualUnlock((LPVOID)(image->file.data + begin), end - begin);
+#else
+    madvise((void *)(image->file.data + begin), end - begin, MADV_DONTNEED);
+#endif
+}
+
+/**
+*******************************************************************************
+*  @fn     closeImage
+*  @brief  Unmaps an image opened with openImage
+*
+*  @param[in/out] image : image
+*
+*  @return void
+*******************************************************************************
+*/
+void closeImage(MappedImage *image)
+{
+    unmapFile(&image->file);
+}
+
+/******************************************************************************
+* Background writer of an ImageWriter. One staging buffer is in flight while *
+* the other one is filled.                                                    *
+******************************************************************************/
+struct ImageWriterThread
+{
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool pending;               /**< A write has been posted and not finished */
+    bool stop;
+    const cl_uchar *data;
+    size_t bytes;
+    long long offset;
+    bool failed;
+};
+
+/**
+*******************************************************************************
+*  @fn     writeAt
+*  @brief  Writes a block of bytes at the given file position
+*
+*  @param[in] fp      : file
+*  @param[in] offset  : file position
+*  @param[in] data    : bytes to write
+*  @param[in] bytes   : number of bytes
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool writeAt(FILE *fp, long long offset, const cl_uchar *data, size_t bytes)
+{
+    return seekFile(fp, offset) && fwrite(data, 1, bytes, fp) == bytes;
+}
+
+/**
+*******************************************************************************
+*  @fn     imageWriterThread
+*  @brief  Writes the posted staging buffers until stopped
+*
+*  @param[in/out] writer : writer owning the thread
+*
+*  @return void
+*******************************************************************************
+*/
+static void imageWriterThread(ImageWriter *writer)
+{
+    ImageWriterThread *t = writer->thread;
+    std::unique_lock<std::mutex> guard(t->lock);
+
+    for (;;)
+    {
+        while (!t->pending && !t->stop)
+            t->cond.wait(guard);
+        if (!t->pending)
+            break;
+
+        guard.unlock();
+        bool written = writeAt(writer->fp, t->offset, t->data, t->bytes);
+        guard.lock();
+
+        t->failed = t->failed || !written;
+        t->pending = false;
+        t->cond.notify_all();
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     waitImageWriterThread
+*  @brief  Waits until the write in flight, if any, has finished
+*
+*  @param[in/out] writer : writer with a background thread
+*
+*  @return bool : false if a background write failed
+*******************************************************************************
+*/
+static bool waitImageWriterThread(ImageWriter *writer)
+{
+    ImageWriterThread *t = writer->thread;
+    std::unique_lock<std::mutex> guard(t->lock);
+    while (t->pending)
+        t->cond.wait(guard);
+    return !t->failed;
+}
+
+/**
+*******************************************************************************
+*  @fn     flushImageWriter
+*  @brief  Writes the staged rows, in the background if the writer has a 
+*          thread. Rows given against the file order are staged from the end
+*          of the buffer, so the staged bytes are contiguous in both cases.
+*
+*  @param[in/out] writer : writer
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool flushImageWriter(ImageWriter *writer)
+{
+    if (writer->stagedRows == 0)
+        return !writer->failed;
+
+    bool reverse = (writer->format != IMAGE_FORMAT_BMP) && !writer->topDown;
+    cl_uchar *staging = writer->staging[writer->active];
+    cl_uint firstRow = writer->firstStagedRow;
+    if (reverse)
+    {
+        staging += (size_t)(writer->stagingRows - writer->stagedRows) * writer->rowBytes;
+        firstRow -= writer->stagedRows - 1;
+    }
+    long long offset = writer->headerSize + (long long)firstRow * writer->rowBytes;
+    size_t bytes = (size_t)writer->stagedRows * writer->rowBytes;
+    writer->stagedRows = 0;
+
+    if (writer->thread == NULL)
+    {
+        writer->failed = writer->failed || !writeAt(writer->fp, offset, staging, bytes);
+        return !writer->failed;
+    }
+
+    /* The other buffer is filled next, after its previous write finished */
+    writer->failed = writer->failed || !waitImageWriterThread(writer);
+    {
+        ImageWriterThread *t = writer->thread;
+        std::lock_guard<std::mutex> guard(t->lock);
+        t->data = staging;
+        t->bytes = bytes;
+        t->offset = offset;
+        t->pending = true;
+        t->cond.notify_all();
+    }
+    writer->active ^= 1;
+    return !writer->failed;
+}
+
+/******************************************************************************
+* Largest header written: BMP headers and a 256 entry palette                 *
+******************************************************************************/
+#define IMAGE_HEADER_MAX    (54 + 256 * 4)
+
+/**
+*******************************************************************************
+*  @fn     initImageLayout
+*  @brief  Sets the pixel size, row size and header size of an output file 
+*          and builds its header
+*
+*  @param[in/out] writer : format, width, height, sampleBits and topDown set
+*  @param[out] header    : IMAGE_HEADER_MAX bytes, receives headerSize bytes
+*
+*  @return void
+*******************************************************************************
+*/
+static void initImageLayout(ImageWriter *writer, cl_uchar *header)
+{
+    cl_uint width = writer->width;
+    cl_uint height = writer->height;
+
+    if (writer->format == IMAGE_FORMAT_BMP)
+    {
+        writer->bitsPerPixel = 8;
+        writer->rowBytes = (width + 3) & ~3u;
+        writer->headerSize = IMAGE_HEADER_MAX;
+
+        /* A negative height marks rows stored top row first */
+        cl_uint imageSize = (cl_uint)(writer->rowBytes * height);
+        memset(header, 0, 54);
+        header[0] = 'B';
+        header[1] = 'M';
+        writeLe32(header + 2, IMAGE_HEADER_MAX + imageSize);
+        writeLe32(header + 10, IMAGE_HEADER_MAX);
+        writeLe32(header + 14, 40);
+        writeLe32(header + 18, width);
+        writeLe32(header + 22, writer->topDown ? (cl_uint)(-(cl_int)height) : height);
+        writeLe16(header + 26, 1);
+        writeLe16(header + 28, 8);
+        writeLe32(header + 34, imageSize);
+        writeLe32(header + 46, 256);
+
+        /* Gray palette, entries are blue, green, red, reserved */
+        for (cl_uint i = 0; i < 256; i++)
+        {
+            cl_uchar *entry = header + 54 + 4 * i;
+            entry[0] = entry[1] = entry[2] = (cl_uchar)i;
+            entry[3] = 0;
+        }
+    }
+    else
+    {
+        writer->bitsPerPixel = (writer->sampleBits > 8) ? 16 : 8;
+        writer->rowBytes = (size_t)width * writer->bitsPerPixel / 8;
+        writer->headerSize = 0;
+        if (writer->format == IMAGE_FORMAT_PGM)
+            writer->headerSize = sprintf((char *)header, "P5\n%d %d\n%d\n", width, height,
+                            (1 << writer->sampleBits) - 1);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     createImageWriter
+*  @brief  Creates an image file of the format given by its extension and 
+*          writes its header. The pixel rows are appended with writeImageRows.
+*          BMP files are 8 bit palettized gray. PGM and raw files have 8 bit
+*          samples, or 16 bit samples if sampleBits is above 8.
+*
+*  @param[in] filename   : output file name
+*  @param[in] width      : image width
+*  @param[in] height     : image height
+*  @param[in] sampleBits : significant bits of the pixel values, e.g. 12
+*  @param[in] topDown    : rows will be given top row first
+*  @param[in] background : write the staging buffers on a background thread
+*  @param[out] writer    : writer state
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createImageWriter(const char *filename, cl_uint width, cl_uint height,
+                cl_uint sampleBits, cl_int topDown, cl_int background, ImageWriter *writer)
+{
+    bool headerWritten;
+
+    writer->format = getImageFormat(filename);
+    CHECK_RESULT(writer->format == IMAGE_FORMAT_TIFF,
+                    "TIFF output is only written for TIFF input");
+    CHECK_RESULT(writer->format == IMAGE_FORMAT_Y4M,
+                    "Y4M output is only written for Y4M input");
+
+    writer->width = width;
+    writer->height = height;
+    writer->sampleBits = sampleBits;
+    writer->topDown = topDown;
+    writer->rowsWritten = 0;
+    writer->staging[0] = NULL;
+    writer->staging[1] = NULL;
+    writer->active = 0;
+    writer->stagedRows = 0;
+    writer->firstStagedRow = 0;
+    writer->thread = NULL;
+    writer->failed = false;
+    writer->fp = fopen(filename, "wb");
+    CHECK_RESULT(writer->fp == NULL, "Unable to create %s", filename);
+
+    /* Writes are done in staging buffer sized blocks, stdio buffering would only copy */
+    setvbuf(writer->fp, NULL, _IONBF, 0);
+
+    cl_uchar header[IMAGE_HEADER_MAX];
+    initImageLayout(writer, header);
+    headerWritten = (writer->headerSize == 0)
+                    || (fwrite(header, (size_t)writer->headerSize, 1, writer->fp) == 1);
+
+    writer->stagingRows = (cl_uint)(WRITE_BUFFER_SIZE / writer->rowBytes);
+    if (writer->stagingRows == 0)
+        writer->stagingRows = 1;
+    if (writer->stagingRows > height)
+        writer->stagingRows = height;
+
+    for (int i = 0; i < (background ? 2 : 1); i++)
+        writer->staging[i] = (cl_uchar *)alignedMalloc(writer->stagingRows * writer->rowBytes,
+                        WRITE_BUFFER_ALIGN);
+
+    if (writer->staging[0] == NULL || (background && writer->staging[1] == NULL) || !headerWritten)
+    {
+        closeImageWriter(writer);
+        CHECK_RESULT(true, "Unable to write %s", filename);
+    }
+
+    if (background)
+    {
+        writer->thread = new ImageWriterThread;
+        writer->thread->pending = false;
+        writer->thread->stop = false;
+        writer->thread->failed = false;
+        writer->thread->thread = std::thread(imageWriterThread, writer);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     encodeImageRow
+*  @brief  Encodes one row for writeImageRows into its staging slot,
+*          including the BMP row padding
+*
+*  @param[in] writer    : writer created with createImageWriter
+*  @param[in] src       : first pixel of the row
+*  @param[in] bitWidth  : 8 or 16 bit source
+*  @param[out] dst      : staging slot of the row
+*
+*  @return void
+*******************************************************************************
+*/
+static void encodeImageRow(const ImageWriter *writer, const cl_uchar *src, cl_uint bitWidth,
+                cl_uchar *dst)
+{
+    cl_uint shift = (writer->sampleBits > 8) ? writer->sampleBits - 8 : 0;
+    const cl_uchar *row8 = src;
+    const cl_ushort *row16 = (const cl_ushort *)src;
+
+    if (writer->bitsPerPixel == bitWidth && writer->format != IMAGE_FORMAT_PGM)
+    {
+        memcpy(dst, src, writer->width * bitWidth / 8);
+    }
+    else if (writer->bitsPerPixel == 8 && bitWidth == 8)
+    {
+        memcpy(dst, row8, writer->width);
+    }
+    else if (writer->bitsPerPixel == 16)
+    {
+        /* PGM samples are big endian, raw samples little endian */
+        cl_uint hi = (writer->format == IMAGE_FORMAT_PGM) ? 0 : 1;
+        for (cl_uint x = 0; x < writer->width; x++)
+        {
+            cl_ushort v = (bitWidth == 8) ? row8[x] : row16[x];
+            dst[2 * x + hi] = (cl_uchar)(v >> 8);
+            dst[2 * x + 1 - hi] = (cl_uchar)v;
+        }
+    }
+    else
+    {
+        cl_uint x = 0;
+#ifdef USE_SSE2
+        /* Masking before the saturating pack keeps the truncation of the cast */
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        const __m128i lowByte = _mm_set1_epi16(0xff);
+        for (; x + 16 <= writer->width; x += 16)
+        {
+            __m128i a = _mm_and_si128(_mm_srl_epi16(
+                            _mm_loadu_si128((const __m128i *)(row16 + x)), count), lowByte);
+            __m128i b = _mm_and_si128(_mm_srl_epi16(
+                            _mm_loadu_si128((const __m128i *)(row16 + x + 8)), count), lowByte);
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(a, b));
+        }
+#endif
+        for (; x < writer->width; x++)
+            dst[x] = (cl_uchar)(row16[x] >> shift);
+    }
+
+    /* BMP rows are padded to 4 bytes */
+    size_t used = (size_t)writer->width * writer->bitsPerPixel / 8;
+    if (used < writer->rowBytes)
+        memset(dst + used, 0, writer->rowBytes - used);
+}
+
+/**
+*******************************************************************************
+*  @fn     writeImageRows
+*  @brief  Appends rows of a single channel image. Rows are encoded straight
+*          into the staging buffer, by several threads for large buffers, 
+*          which is written when full. Rows are 
+*          given in the order set with createImageWriter; PGM and raw rows 
+*          given bottom row first are placed at their position in the file.
+*          Samples are reduced to their 8 most significant bits for 8 bit 
+*          files; raw and PGM rows of 8 bit samples are plain copies.
+*
+*  @param[in/out] writer : writer created with createImageWriter
+*  @param[in] src        : first pixel of the first row
+*  @param[in] srcPitch   : source row pitch in pixels
+*  @param[in] numRows    : number of rows to append
+*  @param[in] bitWidth   : 8 or 16 bit source
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool writeImageRows(ImageWriter *writer, const cl_uchar *src, size_t srcPitch,
+                cl_uint numRows, cl_uint bitWidth)
+{
+    CHECK_RESULT(writer->rowsWritten + numRows > writer->height, "Too many rows written");
+
+    bool reverse = (writer->format != IMAGE_FORMAT_BMP) && !writer->topDown;
+    size_t srcPitchBytes = srcPitch * (bitWidth / 8);
+
+    while (numRows > 0)
+    {
+        if (writer->stagedRows == writer->stagingRows && !flushImageWriter(writer))
+            return false;
+
+        cl_uint fileRow = reverse ? writer->height - 1 - writer->rowsWritten : writer->rowsWritten;
+        if (writer->stagedRows == 0)
+            writer->firstStagedRow = fileRow;
+
+        /* Encode as many rows as fit the staging buffer, in parallel blocks */
+        cl_uint rows = writer->stagingRows - writer->stagedRows;
+        if (rows > numRows)
+            rows = numRows;
+
+        cl_uchar *staging = writer->staging[writer->active];
+        cl_uint stagedRows = writer->stagedRows;
+        cl_uint stagingRows = writer->stagingRows;
+        const ImageWriter *w = writer;
+        forEachRowBlock(rows, writer->rowBytes,
+            [=](cl_uint blockFirst, cl_uint blockRows)
+            {
+                for (cl_uint y = blockFirst; y < blockFirst + blockRows; y++)
+                {
+                    cl_uint slot = reverse ? stagingRows - 1 - (stagedRows + y) : stagedRows + y;
+                    encodeImageRow(w, src + y * srcPitchBytes, bitWidth,
+                                    staging + (size_t)slot * w->rowBytes);
+                }
+            });
+
+        src += rows * srcPitchBytes;
+        numRows -= rows;
+        writer->stagedRows += rows;
+        writer->rowsWritten += rows;
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     closeImageWriter
+*  @brief  Writes the remaining rows, stops the background thread and closes
+*          the file of an ImageWriter
+*
+*  @param[in/out] writer : writer created with createImageWriter
+*
+*  @return bool : true if all rows were written; otherwise false.
+*******************************************************************************
+*/
+bool closeImageWriter(ImageWriter *writer)
+{
+    bool complete = (writer->rowsWritten == writer->height);
+
+    if (writer->fp)
+        complete = flushImageWriter(writer) && complete;
+
+    if (writer->thread)
+    {
+        complete = waitImageWriterThread(writer) && complete;
+        {
+            std::lock_guard<std::mutex> guard(writer->thread->lock);
+            writer->thread->stop = true;
+            writer->thread->cond.notify_all();
+        }
+        writer->thread->thread.join();
+        delete writer->thread;
+        writer->thread = NULL;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        alignedFree(writer->staging[i]);
+        writer->staging[i] = NULL;
+    }
+    if (writer->fp)
+    {
+        complete = (fclose(writer->fp) == 0) && complete;
+        writer->fp = NULL;
+    }
+    return complete && !writer->failed;
+}
+
+/**
+*******************************************************************************
+*  @fn     encodeImageFile
+*  @brief  Encodes a whole single channel image, header included, into a 
+*          memory buffer in the layout createImageWriter gives the file, e.g.
+*          to be written with asyncIO.h. Rows are encoded by several threads
+*          for large images.
+*
+*  @param[in] filename    : name of the file, selects the format
+*  @param[in] width       : image width
+*  @param[in] height      : image height
+*  @param[in] sampleBits  : significant bits of the samples
+*  @param[in] topDown     : rows are given top row first
+*  @param[in] src         : first pixel of the first row
+*  @param[in] srcPitch    : source row pitch in pixels
+*  @param[in] bitWidth    : 8 or 16 bit source
+*  @param[out] dst        : file contents
+*  @param[in] capacity    : size of dst in bytes
+*  @param[out] fileSize   : bytes used in dst
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool encodeImageFile(const char *filename, cl_uint width, cl_uint height,
+                cl_uint sampleBits, cl_int topDown, const cl_uchar *src, size_t srcPitch,
+                cl_uint bitWidth, cl_uchar *dst, size_t capacity, size_t *fileSize)
+{
+    ImageWriter layout;
+    cl_uchar header[IMAGE_HEADER_MAX];
+
+    layout.format = getImageFormat(filename);
+    CHECK_RESULT(layout.format == IMAGE_FORMAT_TIFF || layout.format == IMAGE_FORMAT_Y4M,
+                    "%s can not be encoded into memory", filename);
+    layout.width = width;
+    layout.height = height;
+    layout.sampleBits = sampleBits;
+    layout.topDown = topDown;
+    initImageLayout(&layout, header);
+
+    *fileSize = (size_t)layout.headerSize + layout.rowBytes * height;
+    CHECK_RESULT(*fileSize > capacity, "%s needs %lu bytes, the buffer holds %lu", filename,
+                    (unsigned long)*fileSize, (unsigned long)capacity);
+    memcpy(dst, header, (size_t)layout.headerSize);
+
+    bool reverse = (layout.format != IMAGE_FORMAT_BMP) && !topDown;
+    size_t srcPitchBytes = srcPitch * (bitWidth / 8);
+    cl_uchar *pixels = dst + layout.headerSize;
+    const ImageWriter *w = &layout;
+    forEachRowBlock(height, layout.rowBytes,
+        [=](cl_uint blockFirst, cl_uint blockRows)
+        {
+            for (cl_uint y = blockFirst; y < blockFirst + blockRows; y++)
+            {
+                cl_uint fileRow = reverse ? height - 1 - y : y;
+                encodeImageRow(w, src + y * srcPitchBytes, bitWidth,
+                                pixels + (size_t)fileRow * w->rowBytes);
+            }
+        });
+    return true;
+}
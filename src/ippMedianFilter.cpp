@@ -61,22 +61,30 @@ bool initIppMedianFilter(cl_uint filterSize, cl_uint width, cl_uint height, cl_u
 bool runIppMedianFilter(cl_uchar *inputImg, cl_uint filterSize, cl_uchar *outputImg, cl_uint width, cl_uint height, cl_uint bitWidth,
                   Ipp8u* pBuffer)
 {
-    cl_uint paddedWidth = width + filterSize - 1;
+    return runIppMedianFilterPitched(inputImg, width + filterSize - 1, filterSize, outputImg,
+                    width, width, height, bitWidth, pBuffer);
+}
 
+/* Pitches are in pixels. inputImg is the top left pixel of the border. */
+bool runIppMedianFilterPitched(const cl_uchar *inputImg, size_t inputPitch, cl_uint filterSize,
+                  cl_uchar *outputImg, size_t outputPitch, cl_uint width, cl_uint height,
+                  cl_uint bitWidth, Ipp8u* pBuffer)
+{
     IppStatus status;
     IppiSize dstRoiSize = {width, height};
-    Ipp8u borderValue_8u = 0;
-    Ipp16u borderValue_16u = 0;
     IppiSize  maskSize = {filterSize, filterSize};
-    IppiBorderType borderType = (IppiBorderType)(ippBorderConst | ippBorderInMemTop | ippBorderInMemRight);
+    /* The input carries its zero border on all sides, so all neighbours are
+       read from memory. This also holds for strips of a larger image, whose
+       top and bottom borders are the rows of the neighbouring strips. */
+    IppiBorderType borderType = ippBorderInMem;
     
     if (bitWidth == 8)
     {
         status = ippiFilterMedianBorder_8u_C1R(
-            (inputImg + ((filterSize / 2) * paddedWidth + (filterSize / 2)) * (bitWidth / 8)), 
-            paddedWidth * (bitWidth / 8), 
+            (inputImg + ((filterSize / 2) * inputPitch + (filterSize / 2)) * (bitWidth / 8)), 
+            inputPitch * (bitWidth / 8), 
             outputImg, 
-            width * (bitWidth / 8), 
+            outputPitch * (bitWidth / 8), 
             dstRoiSize, 
             maskSize, 
             borderType, 
@@ -86,10 +94,10 @@ bool runIppMedianFilter(cl_uchar *inputImg, cl_uint filterSize, cl_uchar *output
     else
     {
         status = ippiFilterMedianBorder_16u_C1R(
-            (const Ipp16u *)(inputImg + ((filterSize / 2) * paddedWidth + (filterSize / 2)) * (bitWidth / 8)), 
-            paddedWidth * (bitWidth / 8), 
+            (const Ipp16u *)(inputImg + ((filterSize / 2) * inputPitch + (filterSize / 2)) * (bitWidth / 8)), 
+            inputPitch * (bitWidth / 8), 
             (Ipp16u *)outputImg, 
-            width * (bitWidth / 8), 
+            outputPitch * (bitWidth / 8), 
             dstRoiSize, 
             maskSize, 
             borderType, 
@@ -104,4 +112,22 @@ bool runIppMedianFilter(cl_uchar *inputImg, cl_uint filterSize, cl_uchar *output
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+static bool filterRegion(const MedianImage *src, const MedianImage *dst, cl_uint filterSize,
+                void *pBuffer)
+{
+    cl_int radius = filterSize / 2;
+    return runIppMedianFilterPitched(getMedianImagePixel(src, -radius, -radius), src->pitch,
+                    filterSize, getMedianImagePixel(dst, 0, 0), dst->pitch, src->width,
+                    src->height, src->bitWidth, (Ipp8u *)pBuffer);
+}
+
+/* Filters the ROI of src into the ROI of dst, reading neighbours from the halo of src.
+ * A thinner halo, e.g. none around an unpadded image, is completed according to
+ * the border mode of src. */
+bool runIppMedianFilterImage(const MedianImage *src, const MedianImage *dst,
+                  cl_uint filterSize, Ipp8u* pBuffer)
+{
+    return runMedianFilterRegions(src, dst, filterSize, filterRegion, pBuffer);
+}
@@ -36,6 +36,15 @@
 #include "utils.h"
 #include "CLUtil.hpp"
 #include "SDKBitMap.hpp"
+#include "imageIO.h"
+#include "tiledFilter.h"
+#include "batchFilter.h"
+#include "frameStream.h"
+#include "planarFilter.h"
+#include "medianPlan.h"
+#include "bufferPool.h"
+#include <thread>
+#include <atomic>
 using namespace appsdk;
 
 /******************************************************************************
@@ -45,6 +54,11 @@ using namespace appsdk;
 #define DEFAULT_INPUT_IMAGE             "Nature_2448x2044.bmp"
 #define DEFAULT_OPENCL_OUTPUT_IMAGE     "oclMedianOutput.bmp"
 #define DEFAULT_IPP_OUTPUT_IMAGE        "ippMedianOutput.bmp"
+#define DEFAULT_OPENCL_OUTPUT_TIFF      "oclMedianOutput.tif"
+#define DEFAULT_IPP_OUTPUT_TIFF         "ippMedianOutput.tif"
+#define DEFAULT_OPENCL_OUTPUT_Y4M       "oclMedianOutput.y4m"
+#define DEFAULT_IPP_OUTPUT_Y4M          "ippMedianOutput.y4m"
+#define DEFAULT_BATCH_OUTPUT_DIR        "medianOutput"
 #define DEFAULT_BITWIDTH                16
 
 /******************************************************************************
@@ -57,17 +71,31 @@ typedef struct MedianFilter
 
     cl_uint paddedRows;
     cl_uint paddedCols;
+    cl_uint border;             /**< Border of inputImg on each side */
+    cl_uint borderMode;         /**< MEDIAN_BORDER_* neighbours beyond the image */
+    cl_uint borderValue;        /**< Pixel of MEDIAN_BORDER_CONSTANT */
+    cl_int hugePages;           /**< Host images in transparent huge pages */
 
     cl_uint filterSize;
 
+    cl_uint sampleBits;         /**< Significant bits of the input samples */
+    cl_int topDown;             /**< Input rows are stored top row first */
+
     cl_uchar *inputImg;
     cl_uchar *oclOutputImg;
     cl_uchar *ippOutputImg;
+    cl_uchar *ippPaddedImg;     /**< Padded host copy between ipp passes */
+
+    cl_uint iterations;         /**< Number of median passes */
 
     cl_kernel medianFilterKernel;
+    MedianKernelConfig kernelConfig;
     
     cl_mem input;
     cl_mem output;
+    cl_mem pingPong[2];         /**< Padded intermediates of iterated passes */
+
+    MedianOutputLayout outLayout;   /**< Layout of output on the device */
     
     Ipp8u* pBuffer;
 
@@ -82,18 +110,85 @@ typedef struct MedianFilter
 /******************************************************************************
  * Function declaration                                                        *
  ******************************************************************************/
+static cl_uchar *allocImage(const MedianFilter *paramFF, size_t size, bool zero);
+static void fillPaddedBorder(const MedianFilter *paramFF, cl_uchar *image, cl_uint bitWidth);
 bool readInput(MedianFilter *paramFF, const char *inputImage,
+                cl_uint bitWidth, cl_int useMmap, cl_uint rawWidth, cl_uint rawHeight);
+bool readInputBitmap(MedianFilter *paramFF, const char *inputImage,
                 cl_uint bitWidth);
 bool createMemory(MedianFilter* paramFF, DeviceInfo *infoDeviceOcl,
                 cl_uint bitWidth);
 void destroyMemory(MedianFilter *paramFF, DeviceInfo *infoDeviceOcl);
 bool saveOutputs(MedianFilter *paramFF, const char *filename1, const char *filename2,
-                cl_uint bitWidth);
+                cl_uint bitWidth, cl_int asyncWrite);
 bool run(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
                 cl_uint bitWidth, cl_uint dataTransfer, cl_event *ev);
+bool runIpp(MedianFilter *paramFF, cl_uint bitWidth);
 bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
                 const char *inputImage, cl_int filterSize,
-                cl_uint bitWidth, cl_uint deviceNum, cl_int useLds, cl_uint useIpp);
+                cl_uint bitWidth, cl_uint deviceNum, cl_int useLds, cl_uint useIpp,
+                cl_int fixedRes, cl_int usePacked, cl_uint iterations,
+                cl_int outPadded, cl_uint outBorder, cl_int useMmap,
+                cl_uint rawWidth, cl_uint rawHeight);
+bool runStreaming(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
+                const char *inputImage, const char *medianOutputImage,
+                const char *ippOutputImage, cl_int filterSize, cl_uint bitWidth,
+                cl_uint deviceNum, cl_int useLds, cl_int usePacked,
+                cl_uint stripRows, cl_uint verify, cl_uint rawWidth, cl_uint rawHeight,
+                cl_int asyncWrite);
+bool runPlanned(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
+                const char *inputImage, const char *medianOutputImage,
+                const char *ippOutputImage, cl_int filterSize, cl_uint bitWidth,
+                cl_uint deviceNum, cl_uint engine, cl_int loopCnt, cl_uint numCallers,
+                cl_uint verify, cl_int useMmap, cl_uint rawWidth, cl_uint rawHeight,
+                cl_int inPlace, cl_int fixedRes, cl_int usePacked);
+
+/**
+ *******************************************************************************
+ *  @fn     allocImage
+ *  @brief  Allocates a page aligned host image, freed with alignedFree. With
+ *          paramFF->hugePages large images are backed by huge pages.
+ *
+ *  @param[in] paramFF : allocation options
+ *  @param[in] size    : bytes
+ *  @param[in] zero    : clear the image, e.g. for a zero border
+ *
+ *  @return cl_uchar* : the image, NULL on failure
+ *******************************************************************************
+ */
+static cl_uchar *allocImage(const MedianFilter *paramFF, size_t size, bool zero)
+{
+    cl_uchar *image = (cl_uchar *)(paramFF->hugePages ? hugePageMalloc(size)
+                    : alignedMalloc(size, BUFFER_POOL_PAGE_SIZE));
+    if (image != NULL && zero)
+        memset(image, 0, size);
+    return image;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     fillPaddedBorder
+ *  @brief  Forms the border of a padded host image in the selected mode. The
+ *          zero border left by the allocation needs no work.
+ *
+ *  @param[in] paramFF   : image geometry and border mode
+ *  @param[in/out] image : padded image with a border of paramFF->border
+ *  @param[in] bitWidth  : 8 bit or 16 bit input
+ *
+ *  @return void
+ *******************************************************************************
+ */
+static void fillPaddedBorder(const MedianFilter *paramFF, cl_uchar *image, cl_uint bitWidth)
+{
+    if (paramFF->borderMode == MEDIAN_BORDER_CONSTANT && paramFF->borderValue == 0)
+        return;
+
+    MedianImage padded;
+    initPaddedMedianImage(&padded, image, paramFF->cols, paramFF->rows, paramFF->paddedCols,
+                    bitWidth, (paramFF->paddedCols - paramFF->cols) / 2);
+    setMedianImageBorder(&padded, paramFF->borderMode, paramFF->borderValue);
+    fillMedianImageBorder(&padded);
+}
 
 /**
  *******************************************************************************
@@ -107,8 +202,12 @@ bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
  */
 void usage(const char *prog)
 {
-    printf("Usage: %s [-i (input image path)]", prog);
-    printf("[-bitWidth (8 | 16)][-filtSize (filterSize 3 | 5)][-useLds (0 | 1)]\n");                    
+    printf("Usage: %s [-i (input image path)][-o (output image path)][-ippOut (ipp output image path)][-rawSize (WxH)]", prog);
+    printf("[-bitWidth (8 | 16)][-filtSize (filterSize 3 | 5)][-useLds (0 | 1)][-fixedRes (0 | 1)][-packed (0 | 1)][-iterations (number of passes)]");
+    printf("[-outPadded (0 | 1)][-outBorder (zero | replicate)][-mmapLoad (0 | 1)][-stripRows (rows per strip)][-threads (tile threads)][-asyncWrite (0 | 1)]");
+    printf("[-batch (image directory or list file)][-outDir (output directory)][-readers (n)][-writers (n)][-prefetch (n)]");
+    printf("[-frames (frame input path | -)][-frameOut (frame output path | -)][-chroma (0 | 1)][-engine (ocl | ipp | cpu | cputiled | template)]");
+    printf("[-border (constant | replicate | reflect101 | wrap)][-borderValue (constant border pixel)][-inPlace (0 | 1)][-hugePages (0 | 1)]\n");                    
     printf("Example: To run 5X5 filter on 8 bit/channel input image, run");
     printf("\n\t %s -i Nature_2048x1024.bmp -filtSize 5 -bitWidth 8 -useLds 0\n", prog);    
 }
@@ -127,6 +226,30 @@ int main(int argc, char **argv)
     cl_uint useIpp = 0;
     cl_uint datatransfer;
     cl_uint verify = 1;
+    cl_int fixedRes = 0;
+    cl_int usePacked = 0;
+    cl_uint iterations = 1;
+    cl_int outPadded = 0;
+    cl_uint outBorder = OUT_BORDER_ZERO;
+    cl_int useMmap = 1;
+    cl_uint stripRows = 0;
+    cl_uint rawWidth = 0;
+    cl_uint rawHeight = 0;
+    cl_uint numThreads = getNumCpus();
+    cl_int asyncWrite = 1;
+    const char *batchInput = NULL;
+    const char *outDir = DEFAULT_BATCH_OUTPUT_DIR;
+    cl_uint numReaders = 2;
+    cl_uint numWriters = 2;
+    cl_uint prefetch = 4;
+    const char *frameInput = NULL;
+    const char *frameOutput = FRAME_STREAM_STDIO;
+    cl_int filterChroma = 0;
+    cl_int engine = -1;
+    cl_uint borderMode = MEDIAN_BORDER_CONSTANT;
+    cl_uint borderValue = 0;
+    cl_int inPlace = 0;
+    cl_int hugePages = 0;
     
     const char *inputImage = DEFAULT_INPUT_IMAGE;
     const char *medianOutputImage = DEFAULT_OPENCL_OUTPUT_IMAGE;
@@ -145,6 +268,28 @@ int main(int argc, char **argv)
             argc--;
             inputImage = argv[1];
         }
+        else if (strcmp(argv[1], "-o") == 0)
+        {
+            argv++;
+            argc--;
+            medianOutputImage = argv[1];
+        }
+        else if (strncmp(argv[1], "-ippOut", 7) == 0)
+        {
+            argv++;
+            argc--;
+            ippOutputImage = argv[1];
+        }
+        else if (strncmp(argv[1], "-rawSize", 8) == 0)
+        {
+            argv++;
+            argc--;
+            if (sscanf(argv[1], "%ux%u", &rawWidth, &rawHeight) != 2)
+            {
+                printf("Raw image size should be given as WxH.\n");
+                exit(1);
+            }
+        }
         else if (strncmp(argv[1], "-filtSize", 9) == 0)
         {
             argv++;
@@ -185,6 +330,197 @@ int main(int argc, char **argv)
             argc--;
             verify = atoi(argv[1]);
         }
+        else if (strncmp(argv[1], "-fixedRes", 9) == 0)
+        {
+            argv++;
+            argc--;
+            fixedRes = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-packed", 7) == 0)
+        {
+            argv++;
+            argc--;
+            usePacked = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-iterations", 11) == 0)
+        {
+            argv++;
+            argc--;
+            iterations = atoi(argv[1]);
+            if (iterations < 1)
+            {
+                printf("Number of iterations should be at least 1.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-outPadded", 10) == 0)
+        {
+            argv++;
+            argc--;
+            outPadded = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-outBorder", 10) == 0)
+        {
+            argv++;
+            argc--;
+            if (strcmp(argv[1], "zero") == 0)
+                outBorder = OUT_BORDER_ZERO;
+            else if (strcmp(argv[1], "replicate") == 0)
+                outBorder = OUT_BORDER_REPLICATE;
+            else
+            {
+                printf("Only zero and replicate output borders are supported.\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[1], "-border") == 0)
+        {
+            argv++;
+            argc--;
+            if (strcmp(argv[1], "constant") == 0)
+                borderMode = MEDIAN_BORDER_CONSTANT;
+            else if (strcmp(argv[1], "replicate") == 0)
+                borderMode = MEDIAN_BORDER_REPLICATE;
+            else if (strcmp(argv[1], "reflect101") == 0)
+                borderMode = MEDIAN_BORDER_REFLECT_101;
+            else if (strcmp(argv[1], "wrap") == 0)
+                borderMode = MEDIAN_BORDER_WRAP;
+            else
+            {
+                printf("Only constant, replicate, reflect101 and wrap borders are supported.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-borderValue", 12) == 0)
+        {
+            argv++;
+            argc--;
+            borderValue = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-mmapLoad", 9) == 0)
+        {
+            argv++;
+            argc--;
+            useMmap = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-stripRows", 10) == 0)
+        {
+            argv++;
+            argc--;
+            stripRows = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-threads", 8) == 0)
+        {
+            argv++;
+            argc--;
+            numThreads = atoi(argv[1]);
+            if (numThreads < 1)
+            {
+                printf("Number of threads should be at least 1.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-asyncWrite", 11) == 0)
+        {
+            argv++;
+            argc--;
+            asyncWrite = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-batch", 6) == 0)
+        {
+            argv++;
+            argc--;
+            batchInput = argv[1];
+        }
+        else if (strncmp(argv[1], "-outDir", 7) == 0)
+        {
+            argv++;
+            argc--;
+            outDir = argv[1];
+        }
+        else if (strncmp(argv[1], "-frames", 7) == 0)
+        {
+            argv++;
+            argc--;
+            frameInput = argv[1];
+        }
+        else if (strncmp(argv[1], "-frameOut", 9) == 0)
+        {
+            argv++;
+            argc--;
+            frameOutput = argv[1];
+        }
+        else if (strncmp(argv[1], "-chroma", 7) == 0)
+        {
+            argv++;
+            argc--;
+            filterChroma = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-engine", 7) == 0)
+        {
+            argv++;
+            argc--;
+            if (strcmp(argv[1], "ocl") == 0)
+                engine = MEDIAN_ENGINE_OPENCL;
+            else if (strcmp(argv[1], "ipp") == 0)
+                engine = MEDIAN_ENGINE_IPP;
+            else if (strcmp(argv[1], "cpu") == 0)
+                engine = MEDIAN_ENGINE_CPU;
+            else if (strcmp(argv[1], "cputiled") == 0)
+                engine = MEDIAN_ENGINE_CPU_TILED;
+            else if (strcmp(argv[1], "template") == 0)
+                engine = MEDIAN_ENGINE_TEMPLATE;
+            else
+            {
+                printf("Only the ocl, ipp, cpu, cputiled and template engines are supported.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-hugePages", 10) == 0)
+        {
+            argv++;
+            argc--;
+            hugePages = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-inPlace", 8) == 0)
+        {
+            argv++;
+            argc--;
+            inPlace = atoi(argv[1]);
+        }
+        else if (strncmp(argv[1], "-readers", 8) == 0)
+        {
+            argv++;
+            argc--;
+            numReaders = atoi(argv[1]);
+            if (numReaders < 1)
+            {
+                printf("Number of readers should be at least 1.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-writers", 8) == 0)
+        {
+            argv++;
+            argc--;
+            numWriters = atoi(argv[1]);
+            if (numWriters < 1)
+            {
+                printf("Number of writers should be at least 1.\n");
+                exit(1);
+            }
+        }
+        else if (strncmp(argv[1], "-prefetch", 9) == 0)
+        {
+            argv++;
+            argc--;
+            prefetch = atoi(argv[1]);
+            if (prefetch < 1)
+            {
+                printf("Number of prefetched images should be at least 1.\n");
+                exit(1);
+            }
+        }
         else
         {
             printf("Illegal option %s ignored\n", argv[1]);
@@ -200,12 +536,182 @@ int main(int argc, char **argv)
         usage(argv[0]);
         exit(1);
     }
+
+    if (borderValue > ((bitWidth == 8) ? 0xffu : 0xffffu))
+    {
+        printf("The border value does not fit %d bit samples.\n", bitWidth);
+        exit(1);
+    }
+    paramFF.borderMode = borderMode;
+    paramFF.borderValue = borderValue;
+    paramFF.hugePages = hugePages;
+    bool customBorder = (borderMode != MEDIAN_BORDER_CONSTANT || borderValue != 0);
+
+    /***************************************************************************
+     * Frame streaming filters raw frames from stdin or a pipe. Nothing may be
+     * printed before it takes stdout over for the frames.
+     **************************************************************************/
+    if (frameInput != NULL)
+    {
+        if (iterations > 1 || outPadded || stripRows || engine >= 0 || inPlace || hugePages
+                        || customBorder)
+        {
+            printf("-iterations, -outPadded, -stripRows, -engine, -inPlace, -hugePages, -border "
+                            "and -borderValue are not supported in frame streaming mode.\n");
+            exit(1);
+        }
+
+        if (!runFrameStream(&infoDeviceOcl, frameInput, frameOutput, rawWidth, rawHeight,
+                        filterSize, bitWidth, deviceNum, useLds, fixedRes, usePacked, verify))
+        {
+            printf("Error in runFrameStream.\n");
+            return -1;
+        }
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
+
+    /***************************************************************************
+     * Batch mode filters many images with one context and kernel, decoding
+     * and writing on separate threads.
+     **************************************************************************/
+    if (batchInput != NULL)
+    {
+        if (iterations > 1 || fixedRes || outPadded || stripRows || customBorder)
+            printf("-iterations, -fixedRes, -outPadded, -stripRows, -border and -borderValue "
+                            "are ignored in batch mode.\n");
+
+        if (!runBatch(&infoDeviceOcl, batchInput, outDir, filterSize, bitWidth, deviceNum,
+                        useLds, usePacked, numReaders, numWriters, prefetch, verify,
+                        rawWidth, rawHeight))
+        {
+            printf("Error in runBatch.\n");
+            return -1;
+        }
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
+
+    /***************************************************************************
+     * Y4M video is filtered frame by frame, one thread per plane, and written
+     * as Y4M.
+     **************************************************************************/
+    if (getImageFormat(inputImage) == IMAGE_FORMAT_Y4M)
+    {
+        if (strcmp(medianOutputImage, DEFAULT_OPENCL_OUTPUT_IMAGE) == 0)
+            medianOutputImage = DEFAULT_OPENCL_OUTPUT_Y4M;
+        if (strcmp(ippOutputImage, DEFAULT_IPP_OUTPUT_IMAGE) == 0)
+            ippOutputImage = DEFAULT_IPP_OUTPUT_Y4M;
+        if (getImageFormat(medianOutputImage) != IMAGE_FORMAT_Y4M
+                        || getImageFormat(ippOutputImage) != IMAGE_FORMAT_Y4M)
+        {
+            printf("Y4M input is written to Y4M output only.\n");
+            exit(1);
+        }
+        if (iterations > 1 || fixedRes || outPadded || stripRows || customBorder)
+            printf("-iterations, -fixedRes, -outPadded, -stripRows, -border and -borderValue "
+                            "are ignored for Y4M input.\n");
+
+        if (!runY4m(&infoDeviceOcl, inputImage, medianOutputImage, ippOutputImage,
+                        filterSize, deviceNum, useLds, usePacked, filterChroma, verify))
+        {
+            printf("Error in runY4m.\n");
+            return -1;
+        }
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
+
+    /***************************************************************************
+     * TIFF images are filtered tile by tile on several threads and written as
+     * TIFF, so the default output names are changed accordingly.
+     **************************************************************************/
+    if (getImageFormat(inputImage) == IMAGE_FORMAT_TIFF)
+    {
+        if (strcmp(medianOutputImage, DEFAULT_OPENCL_OUTPUT_IMAGE) == 0)
+            medianOutputImage = DEFAULT_OPENCL_OUTPUT_TIFF;
+        if (strcmp(ippOutputImage, DEFAULT_IPP_OUTPUT_IMAGE) == 0)
+            ippOutputImage = DEFAULT_IPP_OUTPUT_TIFF;
+        if (getImageFormat(medianOutputImage) != IMAGE_FORMAT_TIFF
+                        || getImageFormat(ippOutputImage) != IMAGE_FORMAT_TIFF)
+        {
+            printf("TIFF input is written to TIFF output only.\n");
+            exit(1);
+        }
+        if (iterations > 1 || fixedRes || outPadded || stripRows || customBorder)
+            printf("-iterations, -fixedRes, -outPadded, -stripRows, -border and -borderValue "
+                            "are ignored for TIFF input.\n");
+
+        if (!runTiledTiff(&infoDeviceOcl, inputImage, medianOutputImage, ippOutputImage,
+                        filterSize, bitWidth, deviceNum, useLds, usePacked, numThreads, verify))
+        {
+            printf("Error in runTiledTiff.\n");
+            return -1;
+        }
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
+
+    /***************************************************************************
+     * Strip streaming keeps only a strip of the image in memory and has its
+     * own pipeline.
+     **************************************************************************/
+    if (stripRows > 0)
+    {
+        if (iterations > 1 || fixedRes || outPadded || customBorder)
+            printf("-iterations, -fixedRes, -outPadded, -border and -borderValue are ignored "
+                            "in strip streaming mode.\n");
+
+        if (!runStreaming(&infoDeviceOcl, &paramFF, inputImage, medianOutputImage,
+                        ippOutputImage, filterSize, bitWidth, deviceNum, useLds, usePacked,
+                        stripRows, verify, rawWidth, rawHeight, asyncWrite))
+        {
+            printf("Error in runStreaming.\n");
+            return -1;
+        }
+        destroyMemory(&paramFF, &infoDeviceOcl);
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
+
+    /***************************************************************************
+     * A single engine through the plan API, which sets everything up once
+     * for all runs.
+     **************************************************************************/
+    if (engine >= 0)
+    {
+        if (iterations > 1 || outPadded)
+            printf("-iterations and -outPadded are ignored with -engine.\n");
+        if (inPlace && engine != MEDIAN_ENGINE_CPU)
+        {
+            printf("-inPlace is only supported by the cpu engine.\n");
+            exit(1);
+        }
+
+        if (!runPlanned(&infoDeviceOcl, &paramFF, inputImage, medianOutputImage,
+                        ippOutputImage, filterSize, bitWidth, deviceNum, engine, loopCnt,
+                        numThreads, verify, useMmap, rawWidth, rawHeight, inPlace, fixedRes,
+                        usePacked))
+        {
+            printf("Error in runPlanned.\n");
+            return -1;
+        }
+
+        printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
+        return 0;
+    }
     
     /***************************************************************************
      * Read input, initialize OpenCL runtime, create memory and OpenCL kernels
      **************************************************************************/
     if (init(&infoDeviceOcl, &paramFF, inputImage, filterSize,
-                    bitWidth, deviceNum, useLds, useIpp) != true)
+                    bitWidth, deviceNum, useLds, useIpp, fixedRes, usePacked, iterations,
+                    outPadded, outBorder, useMmap, rawWidth, rawHeight) != true)
     {
         printf("Error in init.\n");
         return -1;
@@ -218,11 +724,25 @@ int main(int argc, char **argv)
     printf("\n\tFilter size: %dx%d\n\tInput Image: %d bit single channel\n\tInput Image resolution: %dx%d", 
                     filterSize, filterSize, bitWidth, paramFF.cols, paramFF.rows);
     
-    if (useLds)
+    if (infoDeviceOcl.mDeviceType & CL_DEVICE_TYPE_CPU)
+        printf("\n\tOpenCL device is a CPU, using the row segment kernel (%d pixels per work-item).", CPU_SEGMENT);
+    else if (usePacked && bitWidth == 8)
+        printf("\n\tKernels process %d packed 8 bit pixels per work-item.", PACKED_PIXELS);
+    else if (useLds)
         printf("\n\tKernels are using Lds memory for input.");
     else 
         printf("\n\tKernels are not using Lds memory for input.");
 
+    if (fixedRes)
+        printf("\n\tImage dimensions are compiled into the kernel.");
+    if (iterations > 1)
+        printf("\n\tMedian filter is applied %d times, intermediates stay on the device.", iterations);
+    if (outPadded)
+        printf("\n\tOutput is written with a %d pixel %s border for chaining.", filterSize / 2,
+                        (outBorder == OUT_BORDER_REPLICATE) ? "replicated" : "zero");
+    printf("\n");
+    printMedianFilterKernelInfo(paramFF.medianFilterKernel, infoDeviceOcl.mDevice);
+
     printf("\n\nRunning for %d iterations\n\n", loopCnt);
 
     
@@ -236,13 +756,7 @@ int main(int argc, char **argv)
 
     for (int i = 0; i < loopCnt; i++)
     {
-        runIppMedianFilter(paramFF.inputImg, 
-            paramFF.filterSize, 
-            paramFF.ippOutputImg, 
-            paramFF.cols, 
-            paramFF.rows,
-            bitWidth,
-            paramFF.pBuffer);
+        runIpp(&paramFF, bitWidth);
     }
 
 
@@ -252,7 +766,9 @@ int main(int argc, char **argv)
     /**************************************************************************
      * OpenCL median Filter.
      ***************************************************************************/
-    cl_event *eventList = (cl_event *)malloc(loopCnt * sizeof(cl_event));
+    /* One kernel event per median pass */
+    cl_int numEvents = loopCnt * iterations;
+    cl_event *eventList = (cl_event *)malloc(numEvents * sizeof(cl_event));
     if (!eventList)
     {
         printf("Error mallocing eventList.\n");
@@ -277,7 +793,7 @@ int main(int argc, char **argv)
 
     for (int i = 0; i < loopCnt; i++)
     {
-        if (run(&infoDeviceOcl, &paramFF, bitWidth, datatransfer, &eventList[i]) != true)
+        if (run(&infoDeviceOcl, &paramFF, bitWidth, datatransfer, &eventList[i * iterations]) != true)
         {
             printf("Error in run.\n");
             return -1;
@@ -286,7 +802,7 @@ int main(int argc, char **argv)
     clFinish(infoDeviceOcl.mQueue);
 
     double time_ms = 0;
-    for (int i = 0; i < loopCnt; i++)
+    for (int i = 0; i < numEvents; i++)
     {
         cl_ulong time_start, time_end;
 
@@ -309,7 +825,7 @@ int main(int argc, char **argv)
     /***************************************************************************
     * Save OpenCL and IPP filter output images                  
     **************************************************************************/
-    if (!saveOutputs(&paramFF, medianOutputImage, ippOutputImage, bitWidth))
+    if (!saveOutputs(&paramFF, medianOutputImage, ippOutputImage, bitWidth, asyncWrite))
     {
         printf("Error in saveOutputs.\n");
         return -1;
@@ -330,10 +846,15 @@ int main(int argc, char **argv)
         }
     }
     
+    if (hugePages)
+        printf("Huge page backed memory: %.1f MB\n", getHugePageRss() / (1024.0 * 1024.0));
+
     /***************************************************************************
     * Destpry memory and cleanup OpenCL runtime                              
     **************************************************************************/
     destroyMemory(&paramFF, &infoDeviceOcl);
+
+    printf("Peak resident memory: %.1f MB\n", getPeakRss() / (1024.0 * 1024.0));
     
     return 0;
 }
@@ -352,24 +873,38 @@ int main(int argc, char **argv)
  *  @param[in] bitWidth         : 8 bit or 16 bit input
  *  @param[in] deviceNum        : device on which to run OpenCL kernels
  *  @param[in] useLds           : Should the OpenCL kernel use LDS memory for input
+ *  @param[in] fixedRes         : Compile the image dimensions into the kernel
+ *  @param[in] usePacked        : Use the packed kernel for 8 bit input
+ *  @param[in] iterations       : Number of median passes
+ *  @param[in] outPadded        : Write output with a filterSize / 2 border
+ *  @param[in] outBorder        : OUT_BORDER_* fill of the output border
+ *  @param[in] useMmap          : Read the input through the mapped image reader
+ *  @param[in] rawWidth         : Width of raw input images
+ *  @param[in] rawHeight        : Height of raw input images
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
 bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
                 const char *inputImage, cl_int filterSize, 
-                cl_uint bitWidth, cl_uint deviceNum, cl_int useLds, cl_uint useIpp)
+                cl_uint bitWidth, cl_uint deviceNum, cl_int useLds, cl_uint useIpp,
+                cl_int fixedRes, cl_int usePacked, cl_uint iterations,
+                cl_int outPadded, cl_uint outBorder, cl_int useMmap,
+                cl_uint rawWidth, cl_uint rawHeight)
 {
     paramFF->filterSize = filterSize;
+    paramFF->border = filterSize / 2;
+    paramFF->iterations = iterations;
     
     /***************************************************************************
      * read the input image                                                   
      ***************************************************************************/
-    if (readInput(paramFF, inputImage, bitWidth) == false)
+    if (readInput(paramFF, inputImage, bitWidth, useMmap, rawWidth, rawHeight) == false)
     {
         printf("Error reading input.\n");
         return false;
     }
+    fillPaddedBorder(paramFF, paramFF->inputImg, bitWidth);
 
     /**************************************************************************
     * Initialize the openCL device and create context and command queue      
@@ -380,6 +915,9 @@ bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
         return false;
     }
 
+    initMedianOutputLayout(&(paramFF->outLayout), paramFF->cols,
+                    outPadded ? filterSize / 2 : 0, outBorder);
+
     /**************************************************************************
     * Create the memory needed by the pipeline                               
     ***************************************************************************/
@@ -392,9 +930,19 @@ bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
     /***************************************************************************
     * Build the Median Filter OpenCL kernel                         
     ***************************************************************************/
+    MedianKernelConfig *kernelConfig = &(paramFF->kernelConfig);
+    kernelConfig->filtSize = filterSize;
+    kernelConfig->bitWidth = bitWidth;
+    kernelConfig->useLds = useLds;
+    kernelConfig->deviceType = infoDeviceOcl->mDeviceType;
+    kernelConfig->usePacked = usePacked;
+    kernelConfig->fixedWidth = fixedRes ? paramFF->cols : 0;
+    kernelConfig->fixedHeight = fixedRes ? paramFF->rows : 0;
+    kernelConfig->fixedPitch = fixedRes ? paramFF->paddedCols : 0;
+    kernelConfig->cacheBinary = fixedRes;
+
     if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
-        &(paramFF->medianFilterKernel), filterSize, bitWidth, useLds)
-                    == false)
+        &(paramFF->medianFilterKernel), kernelConfig) == false)
     {
         printf("Error in buildMedianFilterKernel.\n");
         return false;
@@ -405,7 +953,8 @@ bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
     **************************************************************************/
     if (setMedianFilterKernelArgs(paramFF->medianFilterKernel,
                     paramFF->input, paramFF->output,
-                    paramFF->cols, paramFF->rows, paramFF->paddedCols) == false)
+                    paramFF->cols, paramFF->rows, paramFF->paddedCols,
+                    &(paramFF->outLayout)) == false)
     {
         printf("Error in setGaussianFilterKernelArgs.\n");
         return false;
@@ -433,6 +982,8 @@ bool init(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
  *  @param[in/out] paramFF      : Structure holds all parameters required
  *                                 by the sample
  *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *  @param[in] dataTransfer     : Transfer input and output between host and device
+ *  @param[out] ev              : If not NULL, receives one kernel event per pass
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
@@ -458,41 +1009,612 @@ bool run(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF, cl_uint bitWidth, cl_
     }
     
     /**************************************************************************
-     * Run the Median Filter OpenCL kernel.
+     * Run the Median Filter OpenCL kernel. Iterated passes ping-pong between 
+     * the padded intermediates, writing into their interior. A zero or 
+     * replicated border is filled by the same kernel, other borders are 
+     * copied into the halo after the pass. Only the last pass writes output.
      ***************************************************************************/
-    runMedianFilterKernel(infoDeviceOcl->mQueue, paramFF->medianFilterKernel,
-            paramFF->cols, paramFF->rows, ev);
+    cl_uint passBorder = OUT_BORDER_NONE;
+    if (paramFF->borderMode == MEDIAN_BORDER_CONSTANT && paramFF->borderValue == 0)
+        passBorder = OUT_BORDER_ZERO;
+    else if (paramFF->borderMode == MEDIAN_BORDER_REPLICATE)
+        passBorder = OUT_BORDER_REPLICATE;
+
+    MedianOutputLayout passLayout;
+    initMedianOutputLayout(&passLayout, paramFF->cols, paramFF->filterSize / 2, passBorder);
+
+    for (cl_uint pass = 0; pass < paramFF->iterations; pass++)
+    {
+        if (paramFF->iterations > 1)
+        {
+            bool lastPass = (pass == paramFF->iterations - 1);
+            cl_mem src = (pass == 0) ? paramFF->input : paramFF->pingPong[(pass - 1) % 2];
+            cl_mem dst = lastPass ? paramFF->output : paramFF->pingPong[pass % 2];
+
+            if (!setMedianFilterKernelIoArgs(paramFF->medianFilterKernel, src, dst,
+                            lastPass ? &(paramFF->outLayout) : &passLayout))
+                return false;
+        }
+
+        if (!runMedianFilterKernel(infoDeviceOcl->mQueue, paramFF->medianFilterKernel,
+                        paramFF->cols, paramFF->rows, &(paramFF->kernelConfig),
+                        ev ? &ev[pass] : NULL))
+            return false;
+
+        if (passBorder == OUT_BORDER_NONE && pass + 1 < paramFF->iterations
+                        && !enqueueMedianBorder(infoDeviceOcl->mQueue,
+                                paramFF->pingPong[pass % 2], &passLayout, paramFF->cols,
+                                paramFF->rows, bitWidth, paramFF->borderMode,
+                                paramFF->borderValue))
+            return false;
+    }
     
     if (dataTransfer) 
     {
         /**************************************************************************
-         * Get the results back to host
+         * Get the results back to host. A padded output stays padded on the 
+         * device for further stages, the host copy is cropped to the image.
          ***************************************************************************/
-        status = clEnqueueReadBuffer(infoDeviceOcl->mQueue, paramFF->output,
-                        CL_TRUE, 0, paramFF->cols * paramFF->rows
-                                        * sizeof(cl_uchar) * (bitWidth / 8),
+        size_t bytesPerPixel = bitWidth / 8;
+        size_t bufferOrigin[3] = { paramFF->outLayout.halo * bytesPerPixel, paramFF->outLayout.halo, 0 };
+        size_t hostOrigin[3] = { 0, 0, 0 };
+        size_t region[3] = { paramFF->cols * bytesPerPixel, paramFF->rows, 1 };
+
+        status = clEnqueueReadBufferRect(infoDeviceOcl->mQueue, paramFF->output,
+                        CL_TRUE, bufferOrigin, hostOrigin, region,
+                        paramFF->outLayout.pitch * bytesPerPixel, 0,
+                        paramFF->cols * bytesPerPixel, 0,
                         paramFF->oclOutputImg, 0, NULL, NULL);
+        CHECK_RESULT(status != CL_SUCCESS,
+                        "Error in clEnqueueReadBufferRect. Status: %d\n", status);
+    }
+
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     runIpp
+ *  @brief  This function runs the ipp reference for all median passes. Between
+ *          passes the result is copied into the interior of a padded host 
+ *          buffer whose border is then formed like the one of the input.
+ *
+ *  @param[in/out] paramFF      : Structure holds all parameters required
+ *                                 by the sample
+ *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool runIpp(MedianFilter *paramFF, cl_uint bitWidth)
+{
+    cl_uint bytesPerPixel = bitWidth / 8;
+    cl_uint filterRadius = paramFF->filterSize / 2;
+
+    for (cl_uint pass = 0; pass < paramFF->iterations; pass++)
+    {
+        cl_uchar *src = (pass == 0) ? paramFF->inputImg : paramFF->ippPaddedImg;
+
+        if (!runIppMedianFilter(src, 
+            paramFF->filterSize, 
+            paramFF->ippOutputImg, 
+            paramFF->cols, 
+            paramFF->rows,
+            bitWidth,
+            paramFF->pBuffer))
+            return false;
+
+        if (pass == paramFF->iterations - 1)
+            break;
+
+        for (cl_uint i = 0; i < paramFF->rows; i++)
+        {
+            memcpy(paramFF->ippPaddedImg + ((i + filterRadius) * paramFF->paddedCols + filterRadius) * bytesPerPixel,
+                   paramFF->ippOutputImg + i * paramFF->cols * bytesPerPixel,
+                   paramFF->cols * bytesPerPixel);
+        }
+        fillPaddedBorder(paramFF, paramFF->ippPaddedImg, bitWidth);
+    }
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     runStreaming
+ *  @brief  Filters the image strip by strip. Each strip of stripRows rows is
+ *          decoded together with the filterSize - 1 rows around it, filtered 
+ *          and appended to the output file. The rows shared with the next 
+ *          strip are moved to the top of the strip buffer instead of being 
+ *          decoded again. Host and device memory is O(width x stripRows), 
+ *          independent of the image height.
+ *
+ *  @param[in/out] infoDeviceOcl : Structure which holds openCL related params
+ *  @param[in/out] paramFF      : Structure holds all parameters required 
+ *                                 by the sample; sized for one strip
+ *  @param[in] inputImage       : input image name
+ *  @param[in] medianOutputImage : OpenCL output image name
+ *  @param[in] ippOutputImage   : ipp output image name
+ *  @param[in] filterSize       : filter size (only 3 and 5 are currently supported)
+ *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *  @param[in] deviceNum        : device on which to run OpenCL kernels
+ *  @param[in] useLds           : Should the OpenCL kernel use LDS memory for input
+ *  @param[in] usePacked        : Use the packed kernel for 8 bit input
+ *  @param[in] stripRows        : Number of output rows per strip
+ *  @param[in] verify           : Run ipp on every strip and compare
+ *  @param[in] rawWidth         : Width of raw input images
+ *  @param[in] rawHeight        : Height of raw input images
+ *  @param[in] asyncWrite       : Write the output strips on background threads,
+ *                                overlapping the filtering of the next strips
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool runStreaming(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
+                const char *inputImage, const char *medianOutputImage,
+                const char *ippOutputImage, cl_int filterSize, cl_uint bitWidth,
+                cl_uint deviceNum, cl_int useLds, cl_int usePacked,
+                cl_uint stripRows, cl_uint verify, cl_uint rawWidth, cl_uint rawHeight,
+                cl_int asyncWrite)
+{
+    cl_int status = 0;
+    MappedImage image;
+
+    timer streamTimer;
+    timerStart(&streamTimer);
+
+    if (!openImage(inputImage, rawWidth, rawHeight, bitWidth, &image))
+    {
+        printf("Failed to load input image!");
+        return false;
+    }
+
+    cl_uint height = image.height;
+    if (stripRows > height)
+        stripRows = height;
+
+    /**************************************************************************
+    * All buffers of the pipeline are created for one strip
+    ***************************************************************************/
+    paramFF->filterSize = filterSize;
+    paramFF->iterations = 1;
+    paramFF->sampleBits = (image.sampleBits < bitWidth) ? image.sampleBits : bitWidth;
+    paramFF->topDown = image.topDown;
+    paramFF->cols = image.width;
+    paramFF->rows = stripRows;
+    paramFF->paddedCols = paramFF->cols + filterSize - 1;
+    paramFF->paddedRows = paramFF->rows + filterSize - 1;
+    paramFF->inputImg = allocImage(paramFF, (size_t)paramFF->paddedCols * paramFF->paddedRows
+                    * (bitWidth / 8), true);
+    CHECK_RESULT(paramFF->inputImg == NULL, "Malloc failed.\n");
+
+    if (initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        return false;
+    }
+
+    initMedianOutputLayout(&(paramFF->outLayout), paramFF->cols, 0, OUT_BORDER_NONE);
+
+    if (createMemory(paramFF, infoDeviceOcl, bitWidth) == false)
+    {
+        printf("Error in createMemory.\n");
+        return false;
+    }
+
+    MedianKernelConfig *kernelConfig = &(paramFF->kernelConfig);
+    kernelConfig->filtSize = filterSize;
+    kernelConfig->bitWidth = bitWidth;
+    kernelConfig->useLds = useLds;
+    kernelConfig->deviceType = infoDeviceOcl->mDeviceType;
+    kernelConfig->usePacked = usePacked;
+    kernelConfig->fixedWidth = 0;
+    kernelConfig->fixedHeight = 0;
+    kernelConfig->fixedPitch = 0;
+    kernelConfig->cacheBinary = 0;
+
+    if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+        &(paramFF->medianFilterKernel), kernelConfig) == false)
+    {
+        printf("Error in buildMedianFilterKernel.\n");
+        return false;
+    }
+
+    initIppMedianFilter(filterSize, paramFF->cols, stripRows, bitWidth, &(paramFF->pBuffer));
+
+    ImageWriter oclWriter, ippWriter;
+    if (!createImageWriter(medianOutputImage, paramFF->cols, height, paramFF->sampleBits,
+                    paramFF->topDown, asyncWrite, &oclWriter))
+        return false;
+    if (verify && !createImageWriter(ippOutputImage, paramFF->cols, height, paramFF->sampleBits,
+                    paramFF->topDown, asyncWrite, &ippWriter))
+        return false;
+
+    printf("Executing Median filter in strips of %d rows", stripRows);
+    printf("\n\tFilter size: %dx%d\n\tInput Image: %d bit single channel\n\tInput Image resolution: %dx%d\n", 
+                    filterSize, filterSize, bitWidth, paramFF->cols, height);
+    printMedianFilterKernelInfo(paramFF->medianFilterKernel, infoDeviceOcl->mDevice);
+    printf("\n\n");
+
+    /**************************************************************************
+    * Slide over the image. Strip buffer row i holds image row y0 - r + i; rows
+    * outside the image stay zero.
+    ***************************************************************************/
+    cl_uint filterRadius = filterSize / 2;
+    size_t bytesPerPixel = bitWidth / 8;
+    size_t rowBytes = paramFF->paddedCols * bytesPerPixel;
+    cl_uint loadedRows = 0;
+    cl_uint mismatchedStrips = 0;
+    double kernelTime = 0;
+
+    for (cl_uint y0 = 0; y0 < height; y0 += stripRows)
+    {
+        cl_uint rows = (height - y0 < stripRows) ? height - y0 : stripRows;
+
+        if (y0 > 0)
+        {
+            memmove(paramFF->inputImg, paramFF->inputImg + stripRows * rowBytes,
+                            2 * filterRadius * rowBytes);
+            memset(paramFF->inputImg + 2 * filterRadius * rowBytes, 0, stripRows * rowBytes);
+        }
+
+        cl_uint endRow = (y0 + rows + filterRadius < height) ? y0 + rows + filterRadius : height;
+        if (!decodeImageRows(&image, 0, loadedRows, endRow - loadedRows,
+                        paramFF->inputImg + (loadedRows - y0 + filterRadius) * rowBytes
+                                        + filterRadius * bytesPerPixel,
+                        paramFF->paddedCols, bitWidth))
+            return false;
+        releaseImageRows(&image, loadedRows, endRow - loadedRows);
+        loadedRows = endRow;
+
+        status = clEnqueueWriteBuffer(infoDeviceOcl->mQueue, paramFF->input, CL_FALSE, 0,
+                        (rows + 2 * filterRadius) * rowBytes, paramFF->inputImg, 0, NULL, NULL);
+        CHECK_RESULT(status != CL_SUCCESS,
+                        "Error in clEnqueueWriteBuffer. Status: %d\n", status);
+
+        if (!setMedianFilterKernelArgs(paramFF->medianFilterKernel, paramFF->input,
+                        paramFF->output, paramFF->cols, rows, paramFF->paddedCols,
+                        &(paramFF->outLayout)))
+            return false;
+
+        cl_event ev;
+        if (!runMedianFilterKernel(infoDeviceOcl->mQueue, paramFF->medianFilterKernel,
+                        paramFF->cols, rows, kernelConfig, &ev))
+            return false;
+
+        status = clEnqueueReadBuffer(infoDeviceOcl->mQueue, paramFF->output, CL_TRUE, 0,
+                        rows * paramFF->cols * bytesPerPixel, paramFF->oclOutputImg, 0, NULL, NULL);
         CHECK_RESULT(status != CL_SUCCESS,
                         "Error in clEnqueueReadBuffer. Status: %d\n", status);
+
+        cl_ulong timeStart, timeEnd;
+        clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_START, sizeof(timeStart), &timeStart, NULL);
+        clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_END, sizeof(timeEnd), &timeEnd, NULL);
+        kernelTime += (double)((timeEnd - timeStart) * (1.0e-6));
+        clReleaseEvent(ev);
+
+        if (!writeImageRows(&oclWriter, paramFF->oclOutputImg, paramFF->cols, rows, bitWidth))
+            return false;
+
+        if (verify)
+        {
+            if (!runIppMedianFilter(paramFF->inputImg, filterSize, paramFF->ippOutputImg,
+                            paramFF->cols, rows, bitWidth, paramFF->pBuffer))
+                return false;
+            if (memcmp(paramFF->oclOutputImg, paramFF->ippOutputImg,
+                            rows * paramFF->cols * bytesPerPixel) != 0)
+                mismatchedStrips++;
+            if (!writeImageRows(&ippWriter, paramFF->ippOutputImg, paramFF->cols, rows, bitWidth))
+                return false;
+        }
     }
 
+    closeImage(&image);
+    CHECK_RESULT(!closeImageWriter(&oclWriter), "Error writing %s", medianOutputImage);
+    if (verify)
+        CHECK_RESULT(!closeImageWriter(&ippWriter), "Error writing %s", ippOutputImage);
+
+    printf("Time taken by the OpenCL Median Filter kernels is %f msec\n", kernelTime);
+    printf("Total time taken including file I/O is %f msec\n\n", 1000 * timerCurrent(&streamTimer));
+    printf("OpenCL Median Filter output written to %s\n", medianOutputImage);
+    if (verify)
+    {
+        printf("ipp Median filter Output written to %s\n", ippOutputImage);
+        if (mismatchedStrips)
+            printf("\nVerification failed in %d strips!!\n\n", mismatchedStrips);
+        else
+            printf("\nVerification succeeded!!\n\n");
+    }
     return true;
 }
 
+/**
+ *******************************************************************************
+ *  @fn     planCallerThread
+ *  @brief  One of several threads executing a shared plan
+ *
+ *  @param[in] plan      : shared plan
+ *  @param[in] src       : unpadded input
+ *  @param[out] dst      : output of this caller
+ *  @param[in] count     : number of executions
+ *  @param[in] inPlace   : copy src into dst and filter it over itself
+ *  @param[out] failed   : set when an execution fails
+ *
+ *  @return void
+ *******************************************************************************
+ */
+static void planCallerThread(const MedianPlan *plan, const MedianImage *src, MedianImage dst,
+                cl_int count, bool inPlace, std::atomic<bool> *failed)
+{
+    size_t rowBytes = (size_t)src->width * (src->bitWidth / 8);
+    for (cl_int i = 0; i < count && !*failed; i++)
+    {
+        if (inPlace)
+        {
+            for (cl_uint row = 0; row < src->height; row++)
+                memcpy(getMedianImagePixel(&dst, 0, row), getMedianImagePixel(src, 0, row),
+                                rowBytes);
+            dst.borderMode = src->borderMode;
+            dst.borderValue = src->borderValue;
+        }
+        if (!executeMedianPlanImage(plan, inPlace ? &dst : src, &dst))
+            *failed = true;
+    }
+}
+
+/**
+ *******************************************************************************
+ *  @fn     runPlanned
+ *  @brief  Filters the image with one engine of the plan API. The plan is 
+ *          created once with a context per caller, then numCallers threads 
+ *          execute it loopCnt times in total; an ipp plan provides the 
+ *          reference output. The input is read without padding; the 
+ *          engines filter its interior in place and complete the border
+ *          strips themselves. With inPlace the cpu engine filters a copy of
+ *          the input over itself in every execution, the copy included in 
+ *          the time.
+ *
+ *  @param[in/out] infoDeviceOcl : Structure which holds openCL related params
+ *  @param[in/out] paramFF      : Structure holds all parameters required
+ *                                 by the sample
+ *  @param[in] inputImage       : input image name
+ *  @param[in] medianOutputImage : output image name of the engine
+ *  @param[in] ippOutputImage   : ipp output image name
+ *  @param[in] filterSize       : filter size (only 3 and 5 are currently supported)
+ *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *  @param[in] deviceNum        : device on which to run OpenCL kernels
+ *  @param[in] engine           : MEDIAN_ENGINE_*
+ *  @param[in] loopCnt          : Number of timed executions
+ *  @param[in] numCallers       : Number of threads sharing the plan
+ *  @param[in] verify           : Compare the engine output against ipp
+ *  @param[in] useMmap          : Read the input through the mapped image reader
+ *  @param[in] rawWidth         : Width of raw input images
+ *  @param[in] rawHeight        : Height of raw input images
+ *  @param[in] inPlace          : Filter over the image with the cpu engine
+ *  @param[in] fixedRes         : Compile the image dimensions into the kernel of
+ *                                the ocl engine
+ *  @param[in] usePacked        : Use the packed kernel for 8 bit input
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool runPlanned(DeviceInfo *infoDeviceOcl, MedianFilter *paramFF,
+                const char *inputImage, const char *medianOutputImage,
+                const char *ippOutputImage, cl_int filterSize, cl_uint bitWidth,
+                cl_uint deviceNum, cl_uint engine, cl_int loopCnt, cl_uint numCallers,
+                cl_uint verify, cl_int useMmap, cl_uint rawWidth, cl_uint rawHeight,
+                cl_int inPlace, cl_int fixedRes, cl_int usePacked)
+{
+    /* The engines read the unpadded input, completing the border on the fly */
+    paramFF->filterSize = filterSize;
+    paramFF->border = 0;
+    if (readInput(paramFF, inputImage, bitWidth, useMmap, rawWidth, rawHeight) == false)
+    {
+        printf("Error reading input.\n");
+        return false;
+    }
+
+    if (engine == MEDIAN_ENGINE_OPENCL && initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        return false;
+    }
+
+    if ((cl_uint)loopCnt < numCallers)
+        numCallers = loopCnt;
+
+    /* Every caller writes its own output; the first one is saved */
+    size_t outputSize = (size_t)paramFF->rows * paramFF->cols * (bitWidth / 8);
+    std::vector<cl_uchar *> outputs(numCallers);
+    bool filtered = true;
+    for (cl_uint i = 0; i < numCallers; i++)
+    {
+        outputs[i] = allocImage(paramFF, outputSize, false);
+        filtered = filtered && (outputs[i] != NULL);
+    }
+    paramFF->oclOutputImg = outputs[0];
+    paramFF->ippOutputImg = allocImage(paramFF, outputSize, false);
+    filtered = filtered && (paramFF->ippOutputImg != NULL);
+
+    MedianPlan plan, reference;
+    memset(&plan, 0, sizeof(MedianPlan));
+    memset(&reference, 0, sizeof(MedianPlan));
+    cl_uint flags = (fixedRes ? MEDIAN_PLAN_FIXED_RES : 0) | (usePacked ? MEDIAN_PLAN_PACKED : 0);
+    filtered = filtered && createMedianPlan(paramFF->cols, paramFF->rows, 0, bitWidth,
+                    filterSize, engine, numCallers, flags, infoDeviceOcl, &plan)
+                    && createMedianPlan(paramFF->cols, paramFF->rows, 0, bitWidth, filterSize,
+                    MEDIAN_ENGINE_IPP, 1, 0, NULL, &reference);
+
+    MedianImage input, ippOutput;
+    std::vector<MedianImage> images(numCallers);
+    initMedianImage(&input, paramFF->inputImg, paramFF->cols, paramFF->rows, 0, bitWidth);
+    setMedianImageBorder(&input, paramFF->borderMode, paramFF->borderValue);
+    initMedianImage(&ippOutput, paramFF->ippOutputImg, paramFF->cols, paramFF->rows, 0, bitWidth);
+    for (cl_uint i = 0; i < numCallers; i++)
+        initMedianImage(&images[i], outputs[i], paramFF->cols, paramFF->rows, 0, bitWidth);
+
+    printf("Executing Median filter with the %s engine%s from %d threads",
+                    getMedianEngineName(engine), inPlace ? " in place" : "", numCallers);
+    printf("\n\tFilter size: %dx%d\n\tInput Image: %d bit single channel\n\tInput Image resolution: %dx%d",
+                    filterSize, filterSize, bitWidth, paramFF->cols, paramFF->rows);
+    printf("\n\nRunning for %d iterations\n\n", loopCnt);
+
+    /* The first execution warms up caches and the device */
+    std::atomic<bool> failed(!filtered);
+    planCallerThread(&plan, &input, images[0], 1, inPlace != 0, &failed);
+    filtered = !failed;
+
+    timer planTimer;
+    timerStart(&planTimer);
+    std::vector<std::thread> callers;
+    for (cl_uint i = 0; i < numCallers && filtered; i++)
+    {
+        cl_int count = loopCnt / numCallers + ((cl_int)i < loopCnt % (cl_int)numCallers);
+        callers.push_back(std::thread(planCallerThread, &plan, &input, images[i], count,
+                        inPlace != 0, &failed));
+    }
+    for (size_t i = 0; i < callers.size(); i++)
+        callers[i].join();
+    double time = timerCurrent(&planTimer);
+    filtered = !failed;
+
+    filtered = filtered && executeMedianPlanImage(&reference, &input, &ippOutput);
+    cl_ulong waits = getMedianContextPoolWaits(&plan.pool);
+    destroyMedianPlan(&plan);
+    destroyMedianPlan(&reference);
+
+    bool saved = filtered && saveOutputs(paramFF, medianOutputImage, ippOutputImage, bitWidth, 0);
+    if (saved)
+    {
+        printf("Average time taken per image for the %s engine%s is %f msec, %f images/sec\n",
+                        getMedianEngineName(engine),
+                        (engine == MEDIAN_ENGINE_OPENCL) ? " with data transfer" : "",
+                        1000 * time * numCallers / loopCnt, loopCnt / time);
+        if (waits)
+            printf("Callers waited %lu times for a free context\n", (unsigned long)waits);
+        if (paramFF->hugePages)
+            printf("Huge page backed memory: %.1f MB\n",
+                            getHugePageRss() / (1024.0 * 1024.0));
+        if (verify && memcmp(paramFF->oclOutputImg, paramFF->ippOutputImg, outputSize) != 0)
+            printf("\nVerification failed!!\n\n");
+        else if (verify)
+            printf("\nVerification succeeded!!\n\n");
+    }
+
+    alignedFree(paramFF->inputImg);
+    for (cl_uint i = 0; i < numCallers; i++)
+        alignedFree(outputs[i]);
+    alignedFree(paramFF->ippOutputImg);
+    CHECK_RESULT(!filtered, "Error executing the %s engine", getMedianEngineName(engine));
+    return saved;
+}
+
 /**
  *******************************************************************************
  *  @fn     readInput
- *  @brief  This functons reads an input image content and also pads the filter
- *          based on input image size
+ *  @brief  This functons reads an input image content and also pads it with
+ *          a zero border of paramFF->border pixels on each side
  *
  *  @param[in] paramFF     : Pointer to structure
  *  @param[in] inputImage : input image file name
  *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *  @param[in] useMmap          : Decode the memory mapped file directly into
+ *                                the padded buffer instead of using SDKBitMap.
+ *                                PGM and raw files are always mapped.
+ *  @param[in] rawWidth         : Width of raw input images
+ *  @param[in] rawHeight        : Height of raw input images
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
-bool readInput(MedianFilter *paramFF, const char *inputImage, cl_uint bitWidth)
+bool readInput(MedianFilter *paramFF, const char *inputImage, cl_uint bitWidth,
+                cl_int useMmap, cl_uint rawWidth, cl_uint rawHeight)
+{
+    timer loadTimer;
+    timerStart(&loadTimer);
+
+    if (!(bitWidth == 8 || bitWidth == 16))
+    {
+        CHECK_RESULT(false, "Un-supported bitWidth, only 8 and 16 bits are supported");
+    }
+
+    if (getImageFormat(inputImage) != IMAGE_FORMAT_BMP)
+        useMmap = 1;
+
+    if (useMmap)
+    {
+        /**************************************************************************
+         * Using only r channel of the image, decoded row by row from the file 
+         * mapping into the interior of the padded buffer. Only the border is
+         * cleared, so the pages of the interior are not touched twice. Gray 
+         * files of the same bit width are copied without conversion.
+         **************************************************************************/
+        MappedImage image;
+        if (!openImage(inputImage, rawWidth, rawHeight, bitWidth, &image))
+        {
+            printf("Failed to load input image!");
+            return false;
+        }
+
+        paramFF->sampleBits = (image.sampleBits < bitWidth) ? image.sampleBits : bitWidth;
+        paramFF->topDown = image.topDown;
+        paramFF->rows = image.height;
+        paramFF->cols = image.width;
+        paramFF->paddedRows = paramFF->rows + 2 * paramFF->border;
+        paramFF->paddedCols = paramFF->cols + 2 * paramFF->border;
+
+        cl_uint filterRadius = paramFF->border;
+        cl_uint bytesPerPixel = bitWidth / 8;
+
+        paramFF->inputImg = allocImage(paramFF, (size_t)paramFF->paddedCols * paramFF->paddedRows
+                        * bytesPerPixel, false);
+        if (paramFF->inputImg == NULL)
+        {
+            closeImage(&image);
+            CHECK_RESULT(true, "Malloc failed.\n");
+        }
+
+        size_t rowBytes = (size_t)paramFF->paddedCols * bytesPerPixel;
+        size_t radiusBytes = filterRadius * bytesPerPixel;
+        memset(paramFF->inputImg, 0, filterRadius * rowBytes);
+        for (cl_uint i = filterRadius; i < filterRadius + paramFF->rows; i++)
+        {
+            memset(paramFF->inputImg + i * rowBytes, 0, radiusBytes);
+            memset(paramFF->inputImg + (i + 1) * rowBytes - radiusBytes, 0, radiusBytes);
+        }
+        memset(paramFF->inputImg + (filterRadius + paramFF->rows) * rowBytes, 0,
+                        filterRadius * rowBytes);
+
+        bool decoded = decodeImageChannel(&image, 0, paramFF->inputImg
+                        + (filterRadius * paramFF->paddedCols + filterRadius) * bytesPerPixel,
+                        paramFF->paddedCols, bitWidth);
+        closeImage(&image);
+        if (!decoded)
+            return false;
+    }
+    else if (!readInputBitmap(paramFF, inputImage, bitWidth))
+    {
+        return false;
+    }
+
+    printf("Input image loaded in %f msec using %s\n", 1000 * timerCurrent(&loadTimer),
+                    useMmap ? "the mapped image reader" : "SDKBitMap");
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     readInputBitmap
+ *  @brief  Reads the input image with SDKBitMap and copies its r channel into
+ *          the padded buffer
+ *
+ *  @param[in] paramFF     : Pointer to structure
+ *  @param[in] inputImage : input image file name
+ *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool readInputBitmap(MedianFilter *paramFF, const char *inputImage, cl_uint bitWidth)
 {
     uchar4* pixelData;
 
@@ -509,16 +1631,17 @@ bool readInput(MedianFilter *paramFF, const char *inputImage, cl_uint bitWidth)
     // get width and height of input image
     paramFF->rows = paramFF->inputBitmap.getHeight();
     paramFF->cols = paramFF->inputBitmap.getWidth();
+    paramFF->sampleBits = 8;
+    paramFF->topDown = 0;
 
-    paramFF->paddedRows = paramFF->rows + paramFF->filterSize - 1;
-    paramFF->paddedCols = paramFF->cols + paramFF->filterSize - 1;
+    paramFF->paddedRows = paramFF->rows + 2 * paramFF->border;
+    paramFF->paddedCols = paramFF->cols + 2 * paramFF->border;
 
-    cl_int filterRadius = paramFF->filterSize / 2;
+    cl_int filterRadius = paramFF->border;
 
-    paramFF->inputImg = (cl_uchar *) malloc(paramFF->paddedCols
-                    * paramFF->paddedRows * sizeof(cl_uchar) * bitWidth / 8);
-    memset(paramFF->inputImg, 0, paramFF->paddedCols * paramFF->paddedRows
-                    * sizeof(cl_uchar) * bitWidth / 8);
+    paramFF->inputImg = allocImage(paramFF, (size_t)paramFF->paddedCols * paramFF->paddedRows
+                    * (bitWidth / 8), true);
+    CHECK_RESULT(paramFF->inputImg == NULL, "Malloc failed.\n");
 
 
     // get the pointer to pixel data
@@ -566,87 +1689,45 @@ bool readInput(MedianFilter *paramFF, const char *inputImage, cl_uint bitWidth)
 
 /**
  *******************************************************************************
- *  @fn     saveOutput
- *  @brief  This functons crops the output image to the size of input image and 
- *          saves it in the given format. Format is identified based on image name
+ *  @fn     saveOutputs
+ *  @brief  This functons saves the output images in the format identified by
+ *          the image names, straight from the single channel results. BMP 
+ *          outputs are 8 bit palettized gray; PGM and raw outputs keep the
+ *          bit depth of the input samples.
  *
  *  @param[in] paramFF     : Pointer to structure
  *  @param[in] medianOutputImage  : output file name
- *  @param[in] sepOutputImage    : output file name
+ *  @param[in] ippOutputImage    : output file name
  *  @param[in] bitWidth         : 8 bit or 16 bit input
+ *  @param[in] asyncWrite       : Write both outputs concurrently on background
+ *                                threads
  *
- *  @return void
+ *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
 bool saveOutputs(MedianFilter *paramFF, const char *medianOutputImage,
-                const char *ippOutputImage, cl_uint bitWidth)
+                const char *ippOutputImage, cl_uint bitWidth, cl_int asyncWrite)
 {
-    uchar4 *data = (uchar4 *)malloc(paramFF->cols * paramFF->rows * sizeof(uchar4));
-    if (!data) 
-    {
-        printf("Error mallocing.");
-        return false;
-    }
+    const char *names[2] = { medianOutputImage, ippOutputImage };
+    const cl_uchar *images[2] = { paramFF->oclOutputImg, paramFF->ippOutputImg };
+    ImageWriter writers[2];
+    bool written = true;
 
-    //Save median filter output
-    memset(data, 0, paramFF->rows * paramFF->cols * sizeof(uchar4));
-    if (bitWidth == 8)
-    {      
-        for (cl_uint i = 0; i < paramFF->rows; i++)
-        {
-            for (cl_uint j = 0; j < paramFF->cols; j++)
-            {
-                data[i * paramFF->cols + j].x = (cl_uchar)paramFF->oclOutputImg[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].y = (cl_uchar)paramFF->oclOutputImg[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].z = (cl_uchar)paramFF->oclOutputImg[i * paramFF->cols + j];
-            }
-        }
-    }
-    else
+    for (int i = 0; i < 2; i++)
     {
-        for (cl_uint i = 0; i < paramFF->rows; i++)
-        {
-            for (cl_uint j = 0; j < paramFF->cols; j++)
-            {
-                data[i * paramFF->cols + j].x = (cl_uchar)((cl_ushort *)paramFF->oclOutputImg)[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].y = (cl_uchar)((cl_ushort *)paramFF->oclOutputImg)[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].z = (cl_uchar)((cl_ushort *)paramFF->oclOutputImg)[i * paramFF->cols + j];
-            }
-        }
-    }
-    // write the output bmp file
-    paramFF->inputBitmap.write(medianOutputImage, paramFF->cols, paramFF->rows, (unsigned int *)data);
-    
-    //Save ipp filter output
-    memset(data, 0, paramFF->rows * paramFF->cols * sizeof(uchar4));
-    if (bitWidth == 8)
-    {      
-        for (cl_uint i = 0; i < paramFF->rows; i++)
-        {
-            for (cl_uint j = 0; j < paramFF->cols; j++)
-            {
-                data[i * paramFF->cols + j].x = (cl_uchar)paramFF->ippOutputImg[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].y = (cl_uchar)paramFF->ippOutputImg[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].z = (cl_uchar)paramFF->ippOutputImg[i * paramFF->cols + j];
-            }
-        }
+        if (!createImageWriter(names[i], paramFF->cols, paramFF->rows,
+                        paramFF->sampleBits, paramFF->topDown, asyncWrite, &writers[i]))
+            return false;
+
+        written = writeImageRows(&writers[i], images[i], paramFF->cols, paramFF->rows,
+                        bitWidth) && written;
     }
-    else
+
+    for (int i = 0; i < 2; i++)
     {
-        for (cl_uint i = 0; i < paramFF->rows; i++)
-        {
-            for (cl_uint j = 0; j < paramFF->cols; j++)
-            {
-                data[i * paramFF->cols + j].x = (cl_uchar)((cl_ushort *)paramFF->ippOutputImg)[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].y = (cl_uchar)((cl_ushort *)paramFF->ippOutputImg)[i * paramFF->cols + j];
-                data[i * paramFF->cols + j].z = (cl_uchar)((cl_ushort *)paramFF->ippOutputImg)[i * paramFF->cols + j];
-            }
-        }
+        bool closed = closeImageWriter(&writers[i]);
+        CHECK_RESULT(!closed || !written, "Error writing %s", names[i]);
     }
-    // write the output bmp file
-    paramFF->inputBitmap.write(ippOutputImage, paramFF->cols, paramFF->rows, (unsigned int *)data);
-    
-    free(data);
 
     printf("OpenCL Median Filter output written to %s\n", medianOutputImage);
     printf("ipp Median filter Output written to %s\n\n", ippOutputImage);
@@ -680,19 +1761,42 @@ bool createMemory(MedianFilter* paramFF, DeviceInfo *infoDeviceOcl,
                         NULL, &err);
     CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
 
-    paramFF->output = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_WRITE_ONLY,
-                    paramFF->rows * paramFF->cols * sizeof(cl_uchar)
+    cl_uint outRows = paramFF->rows + 2 * paramFF->outLayout.halo;
+    paramFF->output = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_READ_WRITE,
+                    outRows * paramFF->outLayout.pitch * sizeof(cl_uchar)
                                     * (bitWidth / 8), NULL, &err);
     CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
 
-    paramFF->oclOutputImg = (cl_uchar *) malloc(paramFF->rows * paramFF->cols
-                    * sizeof(cl_uchar) * (bitWidth / 8));
+    paramFF->oclOutputImg = allocImage(paramFF, (size_t)paramFF->rows * paramFF->cols
+                    * (bitWidth / 8), false);
     CHECK_RESULT(paramFF->oclOutputImg == NULL, "Malloc failed.\n");
 
-    paramFF->ippOutputImg = (cl_uchar *) malloc(paramFF->rows * paramFF->cols
-                    * sizeof(cl_uchar) * (bitWidth / 8));
+    paramFF->ippOutputImg = allocImage(paramFF, (size_t)paramFF->rows * paramFF->cols
+                    * (bitWidth / 8), false);
         CHECK_RESULT(paramFF->ippOutputImg == NULL, "Malloc failed.\n");
 
+    /**************************************************************************
+    * Padded intermediates for iterated filtering. Two passes need one 
+    * intermediate, more passes alternate between two.
+    ***************************************************************************/
+    paramFF->pingPong[0] = NULL;
+    paramFF->pingPong[1] = NULL;
+    paramFF->ippPaddedImg = NULL;
+    for (cl_uint i = 0; i < 2 && i + 1 < paramFF->iterations; i++)
+    {
+        paramFF->pingPong[i] = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_READ_WRITE,
+                            paddedRows * paddedCols * sizeof(cl_uchar) * (bitWidth / 8), 
+                            NULL, &err);
+        CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+    }
+
+    if (paramFF->iterations > 1)
+    {
+        paramFF->ippPaddedImg = allocImage(paramFF, (size_t)paddedRows * paddedCols
+                        * (bitWidth / 8), true);
+        CHECK_RESULT(paramFF->ippPaddedImg == NULL, "Malloc failed.\n");
+    }
+
     return true;
 }
 
@@ -710,13 +1814,19 @@ bool createMemory(MedianFilter* paramFF, DeviceInfo *infoDeviceOcl,
  */
 void destroyMemory(MedianFilter* paramFF, DeviceInfo *infoDeviceOcl)
 {
-    free(paramFF->inputImg);
-    free(paramFF->oclOutputImg);
-    free(paramFF->ippOutputImg);
+    alignedFree(paramFF->inputImg);
+    alignedFree(paramFF->oclOutputImg);
+    alignedFree(paramFF->ippOutputImg);
+    alignedFree(paramFF->ippPaddedImg);
 
     ippFree(paramFF->pBuffer);
 
     clReleaseMemObject(paramFF->input);
     clReleaseMemObject(paramFF->output);
+    for (int i = 0; i < 2; i++)
+    {
+        if (paramFF->pingPong[i])
+            clReleaseMemObject(paramFF->pingPong[i]);
+    }
     clReleaseKernel(paramFF->medianFilterKernel);
 }
\ No newline at end of file
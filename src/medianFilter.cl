@@ -31,58 +31,142 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define ROUND(x) ((x > 0) ? convert_ushort_rtz(x) : 0)
 #endif
 
+/***************************************************************************************
+* Image dimensions come from the kernel arguments unless the host baked them into the
+* program for a fixed resolution stream.
+***************************************************************************************/
+#ifdef FIXED_WIDTH
+#define IMG_WIDTH   FIXED_WIDTH
+#define IMG_HEIGHT  FIXED_HEIGHT
+#define IMG_PITCH   FIXED_PITCH
+#else
+#define IMG_WIDTH   nWidth
+#define IMG_HEIGHT  nHeight
+#define IMG_PITCH   nExWidth
+#endif
+
+/***************************************************************************************
+* Output pixel (row, col) is stored at output[nOutOffset + row * nOutPitch + col]. An
+* unpadded output uses nOutPitch = width and nOutOffset = 0; writing into the interior
+* of a padded buffer lets the next pass read the result without re-padding.
+* For a padded output, nOutBorder selects how the edge work-items fill the nOutHalo
+* wide border around the image.
+***************************************************************************************/
+#define OUT_BORDER_NONE         0
+#define OUT_BORDER_ZERO         1
+#define OUT_BORDER_REPLICATE    2
+
+/***************************************************************************************
+* Fills the part of the output border owned by pixel (row, col): the halo columns left
+* of the first column, right of the last column, and the rows above/below the first and
+* last rows (including the corners). Interior pixels own no border and return at once.
+***************************************************************************************/
+__attribute__((always_inline)) void store_border(__global T1 *output, uint nOutPitch,
+                    uint nOutOffset, uint nOutBorder, int halo, int width, int height,
+                    int row, int col, T1 val)
+{
+    int y0 = (row == 0) ? -halo : 0;
+    int y1 = (row == height - 1) ? halo : 0;
+    int x0 = (col == 0) ? -halo : 0;
+    int x1 = (col == width - 1) ? halo : 0;
+
+    if (y0 == y1 && x0 == x1) return;
+
+    T1 fill = (nOutBorder == OUT_BORDER_REPLICATE) ? val : (T1)0;
+    __global T1 *out = output + (int)nOutOffset + row * (int)nOutPitch + col;
+
+    for (int dy = y0; dy <= y1; dy++) {
+        for (int dx = x0; dx <= x1; dx++) {
+            if (dy != 0 || dx != 0)
+                out[dy * (int)nOutPitch + dx] = fill;
+        }
+    }
+}
+
 #define OP(a,b) {  T1 mid=a; a=min(a,b); b=max(mid,b);}
 
+/***************************************************************************************
+* Sorting networks, parameterized on the compare-exchange so the same network serves
+* scalar and packed pixels.
+***************************************************************************************/
+#define MEDIAN_3_NETWORK(CMP, p) \
+    CMP(p[1], p[2]); CMP(p[4], p[5]); CMP(p[7], p[8]); CMP(p[0], p[1]); \
+    CMP(p[3], p[4]); CMP(p[6], p[7]); CMP(p[1], p[2]); CMP(p[4], p[5]); \
+    CMP(p[7], p[8]); CMP(p[0], p[3]); CMP(p[5], p[8]); CMP(p[4], p[7]); \
+    CMP(p[3], p[6]); CMP(p[1], p[4]); CMP(p[2], p[5]); CMP(p[4], p[7]); \
+    CMP(p[4], p[2]); CMP(p[6], p[4]); CMP(p[4], p[2]);
+
+#define MEDIAN_5_NETWORK(CMP, p) \
+    CMP(p[0], p[1]) ; CMP(p[3], p[4]) ; CMP(p[2], p[4]) ;       \
+    CMP(p[2], p[3]) ; CMP(p[6], p[7]) ; CMP(p[5], p[7]) ;       \
+    CMP(p[5], p[6]) ; CMP(p[9], p[10]) ; CMP(p[8], p[10]) ;     \
+    CMP(p[8], p[9]) ; CMP(p[12], p[13]) ; CMP(p[11], p[13]) ;   \
+    CMP(p[11], p[12]) ; CMP(p[15], p[16]) ; CMP(p[14], p[16]) ; \
+    CMP(p[14], p[15]) ; CMP(p[18], p[19]) ; CMP(p[17], p[19]) ; \
+    CMP(p[17], p[18]) ; CMP(p[21], p[22]) ; CMP(p[20], p[22]) ; \
+    CMP(p[20], p[21]) ; CMP(p[23], p[24]) ; CMP(p[2], p[5]) ;   \
+    CMP(p[3], p[6]) ; CMP(p[0], p[6]) ; CMP(p[0], p[3]) ;       \
+    CMP(p[4], p[7]) ; CMP(p[1], p[7]) ; CMP(p[1], p[4]) ;       \
+    CMP(p[11], p[14]) ; CMP(p[8], p[14]) ; CMP(p[8], p[11]) ;   \
+    CMP(p[12], p[15]) ; CMP(p[9], p[15]) ; CMP(p[9], p[12]) ;   \
+    CMP(p[13], p[16]) ; CMP(p[10], p[16]) ; CMP(p[10], p[13]) ; \
+    CMP(p[20], p[23]) ; CMP(p[17], p[23]) ; CMP(p[17], p[20]) ; \
+    CMP(p[21], p[24]) ; CMP(p[18], p[24]) ; CMP(p[18], p[21]) ; \
+    CMP(p[19], p[22]) ; CMP(p[8], p[17]) ; CMP(p[9], p[18]) ;   \
+    CMP(p[0], p[18]) ; CMP(p[0], p[9]) ; CMP(p[10], p[19]) ;    \
+    CMP(p[1], p[19]) ; CMP(p[1], p[10]) ; CMP(p[11], p[20]) ;   \
+    CMP(p[2], p[20]) ; CMP(p[2], p[11]) ; CMP(p[12], p[21]) ;   \
+    CMP(p[3], p[21]) ; CMP(p[3], p[12]) ; CMP(p[13], p[22]) ;   \
+    CMP(p[4], p[22]) ; CMP(p[4], p[13]) ; CMP(p[14], p[23]) ;   \
+    CMP(p[5], p[23]) ; CMP(p[5], p[14]) ; CMP(p[15], p[24]) ;   \
+    CMP(p[6], p[24]) ; CMP(p[6], p[15]) ; CMP(p[7], p[16]) ;    \
+    CMP(p[7], p[19]) ; CMP(p[13], p[21]) ; CMP(p[15], p[23]) ;  \
+    CMP(p[7], p[13]) ; CMP(p[7], p[15]) ; CMP(p[1], p[9]) ;     \
+    CMP(p[3], p[11]) ; CMP(p[5], p[17]) ; CMP(p[11], p[17]) ;   \
+    CMP(p[9], p[17]) ; CMP(p[4], p[10]) ; CMP(p[6], p[12]) ;    \
+    CMP(p[7], p[14]) ; CMP(p[4], p[6]) ; CMP(p[4], p[7]) ;      \
+    CMP(p[12], p[14]) ; CMP(p[10], p[14]) ; CMP(p[6], p[7]) ;   \
+    CMP(p[10], p[12]) ; CMP(p[6], p[10]) ; CMP(p[6], p[17]) ;   \
+    CMP(p[12], p[17]) ; CMP(p[7], p[17]) ; CMP(p[7], p[10]) ;   \
+    CMP(p[12], p[18]) ; CMP(p[7], p[12]) ; CMP(p[10], p[18]) ;  \
+    CMP(p[12], p[20]) ; CMP(p[10], p[20]) ; CMP(p[10], p[12]) ;
+
 __attribute__((always_inline)) T1 get_median_3 (T1 *p)
 {
-    OP(p[1], p[2]); OP(p[4], p[5]); OP(p[7], p[8]); OP(p[0], p[1]); 
-    OP(p[3], p[4]); OP(p[6], p[7]); OP(p[1], p[2]); OP(p[4], p[5]); 
-    OP(p[7], p[8]); OP(p[0], p[3]); OP(p[5], p[8]); OP(p[4], p[7]); 
-    OP(p[3], p[6]); OP(p[1], p[4]); OP(p[2], p[5]); OP(p[4], p[7]); 
-    OP(p[4], p[2]); OP(p[6], p[4]); OP(p[4], p[2]); 
+    MEDIAN_3_NETWORK(OP, p)
 
     return p[4];
 }
 
 __attribute__((always_inline))  T1 get_median_5(T1 *p)
 {
-    OP(p[0], p[1]) ; OP(p[3], p[4]) ; OP(p[2], p[4]) ;
-    OP(p[2], p[3]) ; OP(p[6], p[7]) ; OP(p[5], p[7]) ;
-    OP(p[5], p[6]) ; OP(p[9], p[10]) ; OP(p[8], p[10]) ;
-    OP(p[8], p[9]) ; OP(p[12], p[13]) ; OP(p[11], p[13]) ;
-    OP(p[11], p[12]) ; OP(p[15], p[16]) ; OP(p[14], p[16]) ;
-    OP(p[14], p[15]) ; OP(p[18], p[19]) ; OP(p[17], p[19]) ;
-    OP(p[17], p[18]) ; OP(p[21], p[22]) ; OP(p[20], p[22]) ;
-    OP(p[20], p[21]) ; OP(p[23], p[24]) ; OP(p[2], p[5]) ;
-    OP(p[3], p[6]) ; OP(p[0], p[6]) ; OP(p[0], p[3]) ;
-    OP(p[4], p[7]) ; OP(p[1], p[7]) ; OP(p[1], p[4]) ;
-    OP(p[11], p[14]) ; OP(p[8], p[14]) ; OP(p[8], p[11]) ;
-    OP(p[12], p[15]) ; OP(p[9], p[15]) ; OP(p[9], p[12]) ;
-    OP(p[13], p[16]) ; OP(p[10], p[16]) ; OP(p[10], p[13]) ;
-    OP(p[20], p[23]) ; OP(p[17], p[23]) ; OP(p[17], p[20]) ;
-    OP(p[21], p[24]) ; OP(p[18], p[24]) ; OP(p[18], p[21]) ;
-    OP(p[19], p[22]) ; OP(p[8], p[17]) ; OP(p[9], p[18]) ;
-    OP(p[0], p[18]) ; OP(p[0], p[9]) ; OP(p[10], p[19]) ;
-    OP(p[1], p[19]) ; OP(p[1], p[10]) ; OP(p[11], p[20]) ;
-    OP(p[2], p[20]) ; OP(p[2], p[11]) ; OP(p[12], p[21]) ;
-    OP(p[3], p[21]) ; OP(p[3], p[12]) ; OP(p[13], p[22]) ;
-    OP(p[4], p[22]) ; OP(p[4], p[13]) ; OP(p[14], p[23]) ;
-    OP(p[5], p[23]) ; OP(p[5], p[14]) ; OP(p[15], p[24]) ;
-    OP(p[6], p[24]) ; OP(p[6], p[15]) ; OP(p[7], p[16]) ;
-    OP(p[7], p[19]) ; OP(p[13], p[21]) ; OP(p[15], p[23]) ;
-    OP(p[7], p[13]) ; OP(p[7], p[15]) ; OP(p[1], p[9]) ;
-    OP(p[3], p[11]) ; OP(p[5], p[17]) ; OP(p[11], p[17]) ;
-    OP(p[9], p[17]) ; OP(p[4], p[10]) ; OP(p[6], p[12]) ;
-    OP(p[7], p[14]) ; OP(p[4], p[6]) ; OP(p[4], p[7]) ;
-    OP(p[12], p[14]) ; OP(p[10], p[14]) ; OP(p[6], p[7]) ;
-    OP(p[10], p[12]) ; OP(p[6], p[10]) ; OP(p[6], p[17]) ;
-    OP(p[12], p[17]) ; OP(p[7], p[17]) ; OP(p[7], p[10]) ;
-    OP(p[12], p[18]) ; OP(p[7], p[12]) ; OP(p[10], p[18]) ;
-    OP(p[12], p[20]) ; OP(p[10], p[20]) ; OP(p[10], p[12]) ;
+    MEDIAN_5_NETWORK(OP, p)
 
     return (p[12]);
 }
 
+#if PIX_WIDTH == 8
+/***************************************************************************************
+* Packed 8 bit variant: four horizontally adjacent outputs share one uchar4, so every
+* compare-exchange does a per-byte min/max on four windows at once.
+***************************************************************************************/
+#define OP4(a,b) {  uchar4 mid=a; a=min(a,b); b=max(mid,b);}
+
+__attribute__((always_inline)) uchar4 get_median_3_packed(uchar4 *p)
+{
+    MEDIAN_3_NETWORK(OP4, p)
+
+    return p[4];
+}
+
+__attribute__((always_inline)) uchar4 get_median_5_packed(uchar4 *p)
+{
+    MEDIAN_5_NETWORK(OP4, p)
+
+    return p[12];
+}
+#endif
+
 __kernel 
 __attribute__((reqd_work_group_size(LOCAL_XRES, LOCAL_YRES, 1)))
 void medianFilter(
@@ -90,7 +174,11 @@ void medianFilter(
                     __global T1 *output,
                     uint nWidth,
                     uint nHeight,
-                    uint nExWidth
+                    uint nExWidth,
+                    uint nOutPitch,
+                    uint nOutOffset,
+                    uint nOutBorder,
+                    uint nOutHalo
                     )
 {    
     int filterRadius = FILTERSIZE / 2;
@@ -98,9 +186,9 @@ void medianFilter(
     int col = get_global_id(0);
     int row = get_global_id(1);
 
-    if (col >= nWidth || row >= nHeight) return;
+    if (col >= IMG_WIDTH || row >= IMG_HEIGHT) return;
 
-    int xsize = nExWidth;
+    int xsize = IMG_PITCH;
 	
     int start_col, start_row;
     
@@ -174,5 +262,138 @@ void medianFilter(
     /***************************************************************************************
     * Save Output
     ***************************************************************************************/
-    output[row * nWidth + col] = out_val;
-}
\ No newline at end of file
+    output[nOutOffset + row * nOutPitch + col] = out_val;
+
+    if (nOutBorder != OUT_BORDER_NONE)
+        store_border(output, nOutPitch, nOutOffset, nOutBorder, nOutHalo,
+                     IMG_WIDTH, IMG_HEIGHT, row, col, out_val);
+}
+
+/***************************************************************************************
+* CPU device variant.
+* Each work-item filters CPU_SEGMENT consecutive pixels of one row. The column loop has
+* no data dependent branches, so the CPU OpenCL compiler can vectorize it across
+* neighbouring output pixels instead of emulating a 16x16 work-group with LDS.
+***************************************************************************************/
+__kernel
+void medianFilterCpu(
+                    __global const T1 *input,
+                    __global T1 *output,
+                    uint nWidth,
+                    uint nHeight,
+                    uint nExWidth,
+                    uint nOutPitch,
+                    uint nOutOffset,
+                    uint nOutBorder,
+                    uint nOutHalo
+                    )
+{
+    int row = get_global_id(1);
+    int start_col = get_global_id(0) * CPU_SEGMENT;
+
+    if (start_col >= IMG_WIDTH || row >= IMG_HEIGHT) return;
+
+    int end_col = min(start_col + CPU_SEGMENT, (int)IMG_WIDTH);
+
+    __global const T1 *in_row = input + row * IMG_PITCH;
+    __global T1 *out_row = output + nOutOffset + row * nOutPitch;
+
+    for (int col = start_col; col < end_col; col++) {
+        T1 private_input[FILTERSIZE * FILTERSIZE];
+
+#pragma unroll FILTERSIZE
+        for (int i = 0; i < FILTERSIZE; i++) {
+#pragma unroll FILTERSIZE
+            for (int j = 0; j < FILTERSIZE; j++) {
+                private_input[i * FILTERSIZE + j] = in_row[i * IMG_PITCH + col + j];
+            }
+        }
+
+#if FILTERSIZE == 3
+        out_row[col] = get_median_3(private_input);
+#else
+        out_row[col] = get_median_5(private_input);
+#endif
+    }
+
+    /***************************************************************************************
+    * Border fill is kept out of the vectorizable loop, only edge pixels own border.
+    ***************************************************************************************/
+    if (nOutBorder != OUT_BORDER_NONE) {
+        for (int col = start_col; col < end_col; col++)
+            store_border(output, nOutPitch, nOutOffset, nOutBorder, nOutHalo,
+                         IMG_WIDTH, IMG_HEIGHT, row, col, out_row[col]);
+    }
+}
+
+#if PIX_WIDTH == 8
+/***************************************************************************************
+* Packed 8 bit kernel. Each work-item produces 4 adjacent output pixels of a row.
+* Window element (i, j) of the 4 outputs is a single unaligned uchar4 load.
+***************************************************************************************/
+__kernel
+__attribute__((reqd_work_group_size(LOCAL_XRES, LOCAL_YRES, 1)))
+void medianFilterPacked(
+                    __global const uchar *input,
+                    __global uchar *output,
+                    uint nWidth,
+                    uint nHeight,
+                    uint nExWidth,
+                    uint nOutPitch,
+                    uint nOutOffset,
+                    uint nOutBorder,
+                    uint nOutHalo
+                    )
+{
+    int col = get_global_id(0) * 4;
+    int row = get_global_id(1);
+
+    if (col >= IMG_WIDTH || row >= IMG_HEIGHT) return;
+
+    uchar4 private_input[FILTERSIZE * FILTERSIZE];
+
+    /***************************************************************************************
+    * A vector load of the last group in a row could run past the end of the padded
+    * buffer, so lanes beyond the image width repeat the last valid pixel instead.
+    ***************************************************************************************/
+    int last = min(3, (int)IMG_WIDTH - 1 - col);
+
+#pragma unroll FILTERSIZE
+    for (int i = 0; i < FILTERSIZE; i++) {
+#pragma unroll FILTERSIZE
+        for (int j = 0; j < FILTERSIZE; j++) {
+            __global const uchar *src = input + (row + i) * IMG_PITCH + col + j;
+            if (last == 3)
+                private_input[i * FILTERSIZE + j] = vload4(0, src);
+            else
+                private_input[i * FILTERSIZE + j] = (uchar4)(src[0], src[min(1, last)],
+                                                             src[min(2, last)], src[last]);
+        }
+    }
+
+#if FILTERSIZE == 3
+    uchar4 out_val = get_median_3_packed(private_input);
+#else
+    uchar4 out_val = get_median_5_packed(private_input);
+#endif
+
+    /***************************************************************************************
+    * Save Output. The last group of a row may be partial.
+    ***************************************************************************************/
+    __global uchar *out = output + nOutOffset + row * nOutPitch + col;
+    if (last == 3) {
+        vstore4(out_val, 0, out);
+    } else {
+        out[0] = out_val.s0;
+        if (last > 0) out[1] = out_val.s1;
+        if (last > 1) out[2] = out_val.s2;
+    }
+
+    if (nOutBorder != OUT_BORDER_NONE) {
+        uchar vals[4] = { out_val.s0, out_val.s1, out_val.s2, out_val.s3 };
+        for (int k = 0; k <= last; k++)
+            store_border(output, nOutPitch, nOutOffset, nOutBorder, nOutHalo,
+                         IMG_WIDTH, IMG_HEIGHT, row, col + k, vals[k]);
+    }
+}
+#endif
\ No newline at end of file
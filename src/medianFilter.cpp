@@ -31,81 +31,371 @@
  ********************************************************************************
  */
 #include "medianFilter.h"
+
+/**
+ *******************************************************************************
+ *  @fn     buildProgram
+ *  @brief  Builds an OpenCL program and dumps the build log on failure
+ *
+ *  @param[in] program   : program created from source or binary
+ *  @param[in] oclDevice : device to build for
+ *  @param[in] option    : build options
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+static bool buildProgram(cl_program program, cl_device_id oclDevice,
+                const char *option)
+{
+    cl_int err = clBuildProgram(program, 1, &(oclDevice), option, NULL, NULL);
+    if (err != CL_SUCCESS)
+    {
+        char *buildLog = NULL;
+        size_t buildLogSize = 0;
+
+        clGetProgramBuildInfo(program, oclDevice,
+                        CL_PROGRAM_BUILD_LOG, buildLogSize, buildLog,
+                        &buildLogSize);
+        buildLog = (char *) malloc(buildLogSize);
+        clGetProgramBuildInfo(program, oclDevice,
+                        CL_PROGRAM_BUILD_LOG, buildLogSize, buildLog, NULL);
+
+        printf("%s\n", buildLog);
+        free(buildLog);
+
+        CHECK_RESULT(false, "clBuildProgram failed with Error code = %d", err);
+    }
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     getBinaryCacheName
+ *  @brief  Builds the name of the program binary cache file. The name is a hash
+ *          of the device, the driver version, the build options and the kernel
+ *          source, so every resolution and configuration gets its own binary
+ *          and an edited medianFilter.cl never loads a stale one.
+ *
+ *  @param[in] oclDevice : device the binary is built for
+ *  @param[in] option    : build options
+ *  @param[in] source    : kernel source
+ *  @param[in] sourceSize : length of source
+ *  @param[out] name     : cache file name
+ *  @param[in] nameSize  : size of name buffer
+ *
+ *  @return void
+ *******************************************************************************
+ */
+static void getBinaryCacheName(cl_device_id oclDevice, const char *option,
+                const char *source, size_t sourceSize, char *name, size_t nameSize)
+{
+    char deviceName[256] = { 0 };
+    char driverVersion[256] = { 0 };
+    clGetDeviceInfo(oclDevice, CL_DEVICE_NAME, sizeof(deviceName) - 1, deviceName, NULL);
+    clGetDeviceInfo(oclDevice, CL_DRIVER_VERSION, sizeof(driverVersion) - 1, driverVersion, NULL);
+
+    const char *keys[3] = { deviceName, driverVersion, option };
+    unsigned long long hash = 5381;
+    for (int k = 0; k < 3; k++)
+    {
+        for (const char *c = keys[k]; *c; c++)
+            hash = hash * 33 + (unsigned char)*c;
+    }
+    for (size_t i = 0; i < sourceSize; i++)
+        hash = hash * 33 + (unsigned char)source[i];
+    snprintf(name, nameSize, "medianFilter_%016llx.bin", hash);
+}
+
+/**
+ *******************************************************************************
+ *  @fn     loadProgramBinary
+ *  @brief  Creates a program from a cached binary if the cache file exists
+ *
+ *  @param[in] oclCtx    : pointer to the Ocl context
+ *  @param[in] oclDevice : pointer to the ocl device
+ *  @param[in] filename  : cache file name
+ *  @param[out] program  : created program
+ *
+ *  @return bool : true if the program was created; otherwise false.
+ *******************************************************************************
+ */
+static bool loadProgramBinary(cl_context oclCtx, cl_device_id oclDevice,
+                const char *filename, cl_program *program)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return false;
+
+    fseek(fp, 0L, SEEK_END);
+    size_t binarySize = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    unsigned char *binary = (unsigned char *) malloc(binarySize);
+    if (binary == NULL || fread(binary, 1, binarySize, fp) != binarySize)
+    {
+        free(binary);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    cl_int err, binaryStatus;
+    *program = clCreateProgramWithBinary(oclCtx, 1, &oclDevice, &binarySize,
+                    (const unsigned char **) &binary, &binaryStatus, &err);
+    free(binary);
+
+    if (err != CL_SUCCESS)
+        return false;
+    if (binaryStatus != CL_SUCCESS)
+    {
+        clReleaseProgram(*program);
+        return false;
+    }
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     saveProgramBinary
+ *  @brief  Writes the binary of a built single device program to a file
+ *
+ *  @param[in] program  : built program
+ *  @param[in] filename : cache file name
+ *
+ *  @return void
+ *******************************************************************************
+ */
+static void saveProgramBinary(cl_program program, const char *filename)
+{
+    size_t binarySize = 0;
+    cl_int err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+                    sizeof(size_t), &binarySize, NULL);
+    if (err != CL_SUCCESS || binarySize == 0)
+        return;
+
+    unsigned char *binary = (unsigned char *) malloc(binarySize);
+    if (binary == NULL)
+        return;
+
+    err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *),
+                    &binary, NULL);
+    if (err == CL_SUCCESS)
+    {
+        FILE *fp = fopen(filename, "wb");
+        if (fp != NULL)
+        {
+            fwrite(binary, 1, binarySize, fp);
+            fclose(fp);
+        }
+    }
+    free(binary);
+}
+
+/**
+ *******************************************************************************
+ *  @fn     isPackedKernel
+ *  @brief  Checks whether the configuration selects the packed 8 bit kernel
+ *
+ *  @param[in] config : compile time configuration of the kernel
+ *
+ *  @return bool : true if the packed kernel is used; otherwise false.
+ *******************************************************************************
+ */
+static bool isPackedKernel(const MedianKernelConfig *config)
+{
+    return !(config->deviceType & CL_DEVICE_TYPE_CPU) && config->usePacked
+                    && config->bitWidth == 8;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     getMedianFilterKernelName
+ *  @brief  Selects the kernel variant for the configuration
+ *
+ *  @param[in] config : compile time configuration of the kernel
+ *
+ *  @return const char * : name of the kernel function
+ *******************************************************************************
+ */
+static const char *getMedianFilterKernelName(const MedianKernelConfig *config)
+{
+    if (config->deviceType & CL_DEVICE_TYPE_CPU)
+        return MEDIANFILTER_KERNEL_CPU;
+    if (isPackedKernel(config))
+        return MEDIANFILTER_KERNEL_PACKED;
+    return MEDIANFILTER_KERNEL;
+}
+
 /**
  *******************************************************************************
  *  @fn     buildKernelMedianFilter
- *  @brief  This function builds the OpenCL median filter kernel
+ *  @brief  This function builds the OpenCL median filter kernel. Kernels with
+ *          a fixed resolution are cached as binaries in the working directory
+ *          when config->cacheBinary is set.
  *
  *  @param[in] oclCtx        : pointer to the Ocl context
  *  @param[in] oclDevice     : pointer to the ocl device
  *  @param[out] medianFilter : pointer to the kernel
- *  @param[in] filtSize      : Filter size if set to = 3 - 3x3 Median filter
- *                                                   = 5 - 5x5 Median filter
- *  @param[in] bitWidth      : Bytes per pixel
- *  @param[in] useLds        : Should the OpenCL kernel use LDS memory for input
+ *  @param[in] config        : compile time configuration of the kernel
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
 bool buildMedianFilterKernel(cl_context oclCtx, cl_device_id oclDevice,
-                cl_kernel *medianFilter, cl_uint filtSize, cl_uint bitWidth,
-                cl_int useLds)
+                cl_kernel *medianFilter, const MedianKernelConfig *config)
 {
     const char *filename = MEDIANFILTER_KERNEL_SOURCE;
 
-    filename = MEDIANFILTER_KERNEL_SOURCE;
-
     cl_int err;
     cl_program programMedianFitler;
-    char *source;
-    size_t sourceSize;
-    err = convertToString(filename, &source, &sourceSize);
-    CHECK_RESULT(err != CL_SUCCESS, "Error reading file %s ", filename);
-
-    programMedianFitler
-                    = clCreateProgramWithSource(oclCtx, 1,
-                                    (const char **) &source,
-                                    (const size_t *) &sourceSize, &err);
-    CHECK_RESULT(err != CL_SUCCESS,
-                    "clCreateProgramWithSource failed with Error code = %d",
-                    err);
 
     /**************************************************************************
-     * Build the kernel and check for errors. If errors are found, it will be  *
-     * dumped into buildlog.txt                                                *
+     * Build options. A fixed resolution turns the dimensions and the pitch   *
+     * into compile time constants.                                           *
      **************************************************************************/
-    char option[256];
-    sprintf(option, "-DPIX_WIDTH=%d -DFILTERSIZE=%d -DLOCAL_XRES=%d -DLOCAL_YRES=%d -DUSE_LDS=%d",
-                    bitWidth, filtSize, LOCAL_XRES, LOCAL_YRES, useLds);
-    err = clBuildProgram(programMedianFitler, 1, &(oclDevice), option, NULL,
-                    NULL);
-    free(source);
-    if (err != CL_SUCCESS)
+    char option[512];
+    int len = sprintf(option, "-DPIX_WIDTH=%d -DFILTERSIZE=%d -DLOCAL_XRES=%d -DLOCAL_YRES=%d -DUSE_LDS=%d -DCPU_SEGMENT=%d",
+                    config->bitWidth, config->filtSize, LOCAL_XRES, LOCAL_YRES,
+                    config->useLds, CPU_SEGMENT);
+    if (config->fixedWidth)
     {
-        char *buildLog = NULL;
-        size_t buildLogSize = 0;
+        sprintf(option + len, " -DFIXED_WIDTH=%du -DFIXED_HEIGHT=%du -DFIXED_PITCH=%du",
+                        config->fixedWidth, config->fixedHeight, config->fixedPitch);
+    }
 
-        clGetProgramBuildInfo(programMedianFitler, oclDevice,
-                        CL_PROGRAM_BUILD_LOG, buildLogSize, buildLog,
-                        &buildLogSize);
-        buildLog = (char *) malloc(buildLogSize);
-        clGetProgramBuildInfo(programMedianFitler, oclDevice,
-                        CL_PROGRAM_BUILD_LOG, buildLogSize, buildLog, NULL);
+    /* The source is read even for a cached binary, it is part of the cache key */
+    char *source;
+    size_t sourceSize;
+    err = convertToString(filename, &source, &sourceSize);
+    CHECK_RESULT(err != CL_SUCCESS || source == NULL, "Error reading file %s ", filename);
 
-        printf("%s\n", buildLog);
-        free(buildLog);
+    char cacheName[64];
+    bool fromCache = false;
+    bool useCache = config->fixedWidth && config->cacheBinary;
+    if (useCache)
+    {
+        getBinaryCacheName(oclDevice, option, source, sourceSize, cacheName,
+                        sizeof(cacheName));
+        if (loadProgramBinary(oclCtx, oclDevice, cacheName, &programMedianFitler))
+        {
+            fromCache = buildProgram(programMedianFitler, oclDevice, option);
+            if (!fromCache)
+                clReleaseProgram(programMedianFitler);
+        }
+    }
+
+    if (fromCache)
+        free(source);
+    else
+    {
+        programMedianFitler
+                        = clCreateProgramWithSource(oclCtx, 1,
+                                        (const char **) &source,
+                                        (const size_t *) &sourceSize, &err);
+        free(source);
+        CHECK_RESULT(err != CL_SUCCESS,
+                        "clCreateProgramWithSource failed with Error code = %d",
+                        err);
 
-        clReleaseProgram(programMedianFitler);
-        CHECK_RESULT(false, "clCreateProgram failed with Error code = %d", err);
+        if (!buildProgram(programMedianFitler, oclDevice, option))
+        {
+            clReleaseProgram(programMedianFitler);
+            return false;
+        }
 
+        if (useCache)
+            saveProgramBinary(programMedianFitler, cacheName);
     }
 
-    *medianFilter = clCreateKernel(programMedianFitler, MEDIANFILTER_KERNEL,
-                    &err);
+    const char *kernelName = getMedianFilterKernelName(config);
+    *medianFilter = clCreateKernel(programMedianFitler, kernelName, &err);
     clReleaseProgram(programMedianFitler);
+    CHECK_RESULT(err != CL_SUCCESS,
+                    "clCreateKernel(%s) failed with Error code = %d", kernelName, err);
+    return true;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     createMedianFilterKernelInstance
+ *  @brief  Creates another kernel object of the program of a built kernel. 
+ *          Kernel arguments are not shared, so each host thread launching 
+ *          the filter concurrently needs its own instance.
+ *
+ *  @param[in] medianFilter  : kernel built with buildMedianFilterKernel
+ *  @param[out] instance     : new kernel object
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool createMedianFilterKernelInstance(cl_kernel medianFilter, cl_kernel *instance)
+{
+    cl_int err;
+    cl_program program;
+    char kernelName[64];
+
+    err = clGetKernelInfo(medianFilter, CL_KERNEL_PROGRAM, sizeof(program), &program, NULL);
+    CHECK_RESULT(err != CL_SUCCESS, "clGetKernelInfo failed with Error code = %d", err);
+    err = clGetKernelInfo(medianFilter, CL_KERNEL_FUNCTION_NAME, sizeof(kernelName), kernelName, NULL);
+    CHECK_RESULT(err != CL_SUCCESS, "clGetKernelInfo failed with Error code = %d", err);
+
+    *instance = clCreateKernel(program, kernelName, &err);
+    CHECK_RESULT(err != CL_SUCCESS,
+                    "clCreateKernel(%s) failed with Error code = %d", kernelName, err);
     return true;
 }
 
+/**
+ *******************************************************************************
+ *  @fn     printMedianFilterKernelInfo
+ *  @brief  Prints the resource usage the compiler reported for the kernel
+ *
+ *  @param[in] medianFilter : median filter kernel
+ *  @param[in] oclDevice    : device the kernel was built for
+ *
+ *  @return void
+ *******************************************************************************
+ */
+void printMedianFilterKernelInfo(cl_kernel medianFilter, cl_device_id oclDevice)
+{
+    cl_ulong privateMemSize = 0;
+    cl_ulong localMemSize = 0;
+    size_t workGroupSize = 0;
+
+    clGetKernelWorkGroupInfo(medianFilter, oclDevice, CL_KERNEL_PRIVATE_MEM_SIZE,
+                    sizeof(cl_ulong), &privateMemSize, NULL);
+    clGetKernelWorkGroupInfo(medianFilter, oclDevice, CL_KERNEL_LOCAL_MEM_SIZE,
+                    sizeof(cl_ulong), &localMemSize, NULL);
+    clGetKernelWorkGroupInfo(medianFilter, oclDevice, CL_KERNEL_WORK_GROUP_SIZE,
+                    sizeof(size_t), &workGroupSize, NULL);
+
+    printf("\tKernel resources: private memory %llu bytes, local memory %llu bytes, max work-group size %u\n",
+                    (unsigned long long)privateMemSize, (unsigned long long)localMemSize,
+                    (cl_uint)workGroupSize);
+}
+
+/**
+ *******************************************************************************
+ *  @fn     initMedianOutputLayout
+ *  @brief  Describes an output of the given width surrounded by a halo
+ *
+ *  @param[out] layout : output layout
+ *  @param[in] width   : Image width
+ *  @param[in] halo    : width of the border around the image, 0 for an
+ *                       unpadded output
+ *  @param[in] border  : OUT_BORDER_* fill of the halo
+ *
+ *  @return void
+ *******************************************************************************
+ */
+void initMedianOutputLayout(MedianOutputLayout *layout, cl_uint width,
+                cl_uint halo, cl_uint border)
+{
+    layout->pitch = width + 2 * halo;
+    layout->offset = halo * layout->pitch + halo;
+    layout->halo = halo;
+    layout->border = halo ? border : OUT_BORDER_NONE;
+}
+
 /**
  *******************************************************************************
  *  @fn     setMedianFilterKernelArgs
@@ -117,13 +407,14 @@ bool buildMedianFilterKernel(cl_context oclCtx, cl_device_id oclDevice,
  *  @param[in] width        : Image width
  *  @param[in] height       : Image height
  *  @param[in] paddedWidth  : padded width of the image
+ *  @param[in] outLayout    : layout of output
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
 bool setMedianFilterKernelArgs(cl_kernel medianFilter, cl_mem input,
                 cl_mem output, cl_uint width, cl_uint height,
-                cl_uint paddedWidth)
+                cl_uint paddedWidth, const MedianOutputLayout *outLayout)
 {
     int cnt = 0;
     cl_int err = 0;
@@ -133,6 +424,10 @@ bool setMedianFilterKernelArgs(cl_kernel medianFilter, cl_mem input,
     err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(width));
     err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(height));
     err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(paddedWidth));
+    err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(outLayout->pitch));
+    err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(outLayout->offset));
+    err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(outLayout->border));
+    err |= clSetKernelArg(medianFilter, cnt++, sizeof(cl_int), &(outLayout->halo));
 
     CHECK_RESULT(err != CL_SUCCESS,
                     "clSetKernelArg failed with Error code = %d", err);
@@ -140,6 +435,38 @@ bool setMedianFilterKernelArgs(cl_kernel medianFilter, cl_mem input,
 
 }
 
+/**
+ *******************************************************************************
+ *  @fn     setMedianFilterKernelIoArgs
+ *  @brief  Re-targets the kernel to another input/output pair, leaving the
+ *          image dimensions untouched. Used between passes of an iterated 
+ *          filter.
+ *
+ *  @param[in] medianFilter : pointer to median filter kernel
+ *  @param[in] input        : Ocl memory containing padded input 
+ *  @param[out] output      : Ocl memory to hold output 
+ *  @param[in] outLayout    : layout of output
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool setMedianFilterKernelIoArgs(cl_kernel medianFilter, cl_mem input,
+                cl_mem output, const MedianOutputLayout *outLayout)
+{
+    cl_int err = 0;
+
+    err = clSetKernelArg(medianFilter, 0, sizeof(cl_mem), &(input));
+    err |= clSetKernelArg(medianFilter, 1, sizeof(cl_mem), &(output));
+    err |= clSetKernelArg(medianFilter, 5, sizeof(cl_int), &(outLayout->pitch));
+    err |= clSetKernelArg(medianFilter, 6, sizeof(cl_int), &(outLayout->offset));
+    err |= clSetKernelArg(medianFilter, 7, sizeof(cl_int), &(outLayout->border));
+    err |= clSetKernelArg(medianFilter, 8, sizeof(cl_int), &(outLayout->halo));
+
+    CHECK_RESULT(err != CL_SUCCESS,
+                    "clSetKernelArg failed with Error code = %d", err);
+    return true;
+}
+
 /**
  *******************************************************************************
  *  @fn     runMedianFilterKernel
@@ -149,17 +476,38 @@ bool setMedianFilterKernelArgs(cl_kernel medianFilter, cl_mem input,
  *  @param[in] medianFilter    : pointer to the row processing kernel
  *  @param[in] width           : X dimention
  *  @param[in] height          : Y dimention
+ *  @param[in] config          : configuration the kernel was built with
  *
  *  @return bool : true if successful; otherwise false.
  *******************************************************************************
  */
 bool runMedianFilterKernel(cl_command_queue oclQueue, cl_kernel medianFilter,
-                cl_uint width, cl_uint height, cl_event *ev)
+                cl_uint width, cl_uint height, const MedianKernelConfig *config,
+                cl_event *ev)
 {
     cl_int err;
     size_t localWorkSize[2] = { LOCAL_XRES, LOCAL_YRES };
     size_t globalWorkSize[2];
 
+    if (config->deviceType & CL_DEVICE_TYPE_CPU)
+    {
+        /**********************************************************************
+         * One work-item per CPU_SEGMENT pixels of a row. Work-group size is 
+         * left to the runtime.
+         **********************************************************************/
+        globalWorkSize[0] = (width + CPU_SEGMENT - 1) / CPU_SEGMENT;
+        globalWorkSize[1] = height;
+
+        err = clEnqueueNDRangeKernel(oclQueue, medianFilter, 2, NULL,
+                        globalWorkSize, NULL, 0, NULL, ev);
+        CHECK_RESULT(err != CL_SUCCESS,
+                        "clEnqueueNDRangeKernel failed with Error code = %d", err);
+        return true;
+    }
+
+    if (isPackedKernel(config))
+        width = (width + PACKED_PIXELS - 1) / PACKED_PIXELS;
+
     globalWorkSize[0] = (width + localWorkSize[0] - 1) / localWorkSize[0];
     globalWorkSize[0] *= localWorkSize[0];
     globalWorkSize[1] = (height + localWorkSize[1] - 1) / localWorkSize[1];
@@ -172,3 +520,214 @@ bool runMedianFilterKernel(cl_command_queue oclQueue, cl_kernel medianFilter,
 
     return true;
 }
+
+/**
+ *******************************************************************************
+ *  @fn     enqueueMedianFilterImage
+ *  @brief  Filters the ROI of a host image into the ROI of another. The ROI 
+ *          and its halo are uploaded straight from the caller's buffer into 
+ *          input, packed with a pitch of width + filtSize - 1, and the result
+ *          is read from output, packed with a pitch of width, straight into 
+ *          the destination ROI. Where the source halo is thinner than 
+ *          filtSize / 2, e.g. for an unpadded image, only the missing border
+ *          strips are uploaded from a small zero filled staging buffer. The
+ *          kernel arguments must be set for these buffers and pitches. 
+ *          Returns when dst holds the result.
+ *
+ *  @param[in] oclQueue        : command queue
+ *  @param[in] medianFilter    : kernel with its arguments set
+ *  @param[in] input           : device input of the kernel
+ *  @param[in] output          : device output of the kernel
+ *  @param[in] src             : source, padded or not
+ *  @param[in] dst             : destination of the same size
+ *  @param[in] config          : configuration the kernel was built with
+ *  @param[out] ev             : kernel event if not NULL
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool enqueueMedianFilterImage(cl_command_queue oclQueue, cl_kernel medianFilter,
+                cl_mem input, cl_mem output, const MedianImage *src, const MedianImage *dst,
+                const MedianKernelConfig *config, cl_event *ev)
+{
+    if (!checkMedianImages(src, dst, config->filtSize))
+        return false;
+
+    cl_int err;
+    size_t bytesPerPixel = src->bitWidth / 8;
+    cl_uint radius = config->filtSize / 2;
+    size_t paddedWidth = src->width + config->filtSize - 1;
+    size_t devicePitch = paddedWidth * bytesPerPixel;
+
+    /* Halo present in the caller's buffer on each side */
+    size_t left = (src->haloLeft < radius) ? src->haloLeft : radius;
+    size_t top = (src->haloTop < radius) ? src->haloTop : radius;
+    size_t right = (src->haloRight < radius) ? src->haloRight : radius;
+    size_t bottom = (src->haloBottom < radius) ? src->haloBottom : radius;
+
+    size_t deviceOrigin[3] = { (radius - left) * bytesPerPixel, radius - top, 0 };
+    size_t srcOrigin[3] = { (src->x - left) * bytesPerPixel, src->y - top, 0 };
+    size_t srcRegion[3] = { (src->width + left + right) * bytesPerPixel,
+                    src->height + top + bottom, 1 };
+    err = clEnqueueWriteBufferRect(oclQueue, input, CL_FALSE, deviceOrigin, srcOrigin,
+                    srcRegion, devicePitch, 0, src->pitch * bytesPerPixel, 0,
+                    src->data, 0, NULL, NULL);
+    CHECK_RESULT(err != CL_SUCCESS, "clEnqueueWriteBufferRect failed with Error code = %d", err);
+
+    /**************************************************************************
+    * Missing border strips: rows above and below across the padded width, 
+    * columns left and right beside the uploaded rows. They are staged in one
+    * buffer that lives until the blocking read below.
+    ***************************************************************************/
+    size_t strips[4][4] = {
+        { 0, 0, paddedWidth, radius - top },
+        { 0, radius + src->height + bottom, paddedWidth, radius - bottom },
+        { 0, radius - top, radius - left, src->height + top + bottom },
+        { radius + src->width + right, radius - top, radius - right, src->height + top + bottom } };
+    size_t stagingSize = 0;
+    for (int i = 0; i < 4; i++)
+        stagingSize += strips[i][2] * strips[i][3];
+
+    cl_uchar *staging = NULL;
+    if (stagingSize)
+    {
+        staging = (cl_uchar *)malloc(stagingSize * bytesPerPixel);
+        CHECK_RESULT(staging == NULL, "Malloc failed.\n");
+    }
+
+    cl_uchar *strip = staging;
+    for (int i = 0; i < 4 && err == CL_SUCCESS; i++)
+    {
+        size_t x = strips[i][0], y = strips[i][1], w = strips[i][2], h = strips[i][3];
+        if (w == 0 || h == 0)
+            continue;
+
+        fillMedianHalo(src, (cl_int)x - (cl_int)radius, (cl_int)y - (cl_int)radius,
+                        (cl_uint)w, (cl_uint)h, strip, w);
+        size_t stripDevice[3] = { x * bytesPerPixel, y, 0 };
+        size_t stripHost[3] = { 0, 0, 0 };
+        size_t stripRegion[3] = { w * bytesPerPixel, h, 1 };
+        err = clEnqueueWriteBufferRect(oclQueue, input, CL_FALSE, stripDevice, stripHost,
+                        stripRegion, devicePitch, 0, w * bytesPerPixel, 0, strip, 0, NULL, NULL);
+        strip += w * h * bytesPerPixel;
+    }
+
+    bool filtered = (err == CL_SUCCESS)
+                    && runMedianFilterKernel(oclQueue, medianFilter, src->width, src->height,
+                                    config, ev);
+    if (filtered)
+    {
+        size_t outputOrigin[3] = { 0, 0, 0 };
+        size_t dstOrigin[3] = { dst->x * bytesPerPixel, dst->y, 0 };
+        size_t dstRegion[3] = { dst->width * bytesPerPixel, dst->height, 1 };
+        err = clEnqueueReadBufferRect(oclQueue, output, CL_TRUE, outputOrigin, dstOrigin,
+                        dstRegion, dst->width * bytesPerPixel, 0, dst->pitch * bytesPerPixel, 0,
+                        dst->data, 0, NULL, NULL);
+    }
+    else
+    {
+        clFinish(oclQueue);
+    }
+    free(staging);
+    CHECK_RESULT(err != CL_SUCCESS, "Uploading or reading back the image failed with Error code = %d",
+                    err);
+    return filtered;
+}
+
+/**
+ *******************************************************************************
+ *  @fn     enqueueMedianBorder
+ *  @brief  Forms the halo of a padded device image from its interior in a 
+ *          MEDIAN_BORDER_* mode, e.g. between iterated passes. Replicate, 
+ *          reflect-101 and wrap copy single rows and columns inside the 
+ *          buffer; the columns beside the image go first, so the rows copied
+ *          afterwards carry the corners along. A constant border is written
+ *          from a small staging buffer. Only the halo is touched.
+ *
+ *  @param[in] oclQueue  : command queue
+ *  @param[in] buffer    : padded image
+ *  @param[in] layout    : pitch and halo of the buffer
+ *  @param[in] width     : image width
+ *  @param[in] height    : image height
+ *  @param[in] bitWidth  : 8 or 16 bit samples
+ *  @param[in] mode      : MEDIAN_BORDER_*
+ *  @param[in] value     : pixel of MEDIAN_BORDER_CONSTANT
+ *
+ *  @return bool : true if successful; otherwise false.
+ *******************************************************************************
+ */
+bool enqueueMedianBorder(cl_command_queue oclQueue, cl_mem buffer,
+                const MedianOutputLayout *layout, cl_uint width, cl_uint height,
+                cl_uint bitWidth, cl_uint mode, cl_uint value)
+{
+    cl_int err = CL_SUCCESS;
+    size_t bytesPerPixel = bitWidth / 8;
+    size_t pitchBytes = layout->pitch * bytesPerPixel;
+    cl_int halo = layout->halo;
+
+    if (halo == 0)
+        return true;
+
+    if (mode == MEDIAN_BORDER_CONSTANT)
+    {
+        size_t strips[4][4] = {
+            { 0, 0, layout->pitch, (size_t)halo },
+            { 0, halo + height, layout->pitch, (size_t)halo },
+            { 0, (size_t)halo, (size_t)halo, height },
+            { halo + width, (size_t)halo, (size_t)halo, height } };
+        size_t count = (layout->pitch > height) ? layout->pitch * halo : height * halo;
+        cl_uchar *staging = (cl_uchar *)malloc(count * bytesPerPixel);
+        CHECK_RESULT(staging == NULL, "Malloc failed.\n");
+        for (size_t i = 0; i < count; i++)
+        {
+            if (bytesPerPixel == 1)
+                staging[i] = (cl_uchar)value;
+            else
+                ((cl_ushort *)staging)[i] = (cl_ushort)value;
+        }
+
+        size_t hostOrigin[3] = { 0, 0, 0 };
+        for (int i = 0; i < 4 && err == CL_SUCCESS; i++)
+        {
+            size_t bufferOrigin[3] = { strips[i][0] * bytesPerPixel, strips[i][1], 0 };
+            size_t region[3] = { strips[i][2] * bytesPerPixel, strips[i][3], 1 };
+            err = clEnqueueWriteBufferRect(oclQueue, buffer, CL_FALSE, bufferOrigin, hostOrigin,
+                            region, pitchBytes, 0, strips[i][2] * bytesPerPixel, 0, staging,
+                            0, NULL, NULL);
+        }
+        clFinish(oclQueue);
+        free(staging);
+        CHECK_RESULT(err != CL_SUCCESS, "clEnqueueWriteBufferRect failed with Error code = %d", err);
+        return true;
+    }
+
+    size_t column[3] = { bytesPerPixel, height, 1 };
+    for (cl_int k = 1; k <= halo && err == CL_SUCCESS; k++)
+    {
+        cl_int cols[2][2] = { { -k, mapMedianBorder(-k, width, mode) },
+                        { (cl_int)width - 1 + k, mapMedianBorder(width - 1 + k, width, mode) } };
+        for (int i = 0; i < 2 && err == CL_SUCCESS; i++)
+        {
+            size_t dstOrigin[3] = { (halo + cols[i][0]) * bytesPerPixel, (size_t)halo, 0 };
+            size_t srcOrigin[3] = { (halo + cols[i][1]) * bytesPerPixel, (size_t)halo, 0 };
+            err = clEnqueueCopyBufferRect(oclQueue, buffer, buffer, srcOrigin, dstOrigin, column,
+                            pitchBytes, 0, pitchBytes, 0, 0, NULL, NULL);
+        }
+    }
+
+    size_t row[3] = { pitchBytes, 1, 1 };
+    for (cl_int k = 1; k <= halo && err == CL_SUCCESS; k++)
+    {
+        cl_int rows[2][2] = { { -k, mapMedianBorder(-k, height, mode) },
+                        { (cl_int)height - 1 + k, mapMedianBorder(height - 1 + k, height, mode) } };
+        for (int i = 0; i < 2 && err == CL_SUCCESS; i++)
+        {
+            size_t dstOrigin[3] = { 0, (size_t)(halo + rows[i][0]), 0 };
+            size_t srcOrigin[3] = { 0, (size_t)(halo + rows[i][1]), 0 };
+            err = clEnqueueCopyBufferRect(oclQueue, buffer, buffer, srcOrigin, dstOrigin, row,
+                            pitchBytes, 0, pitchBytes, 0, 0, NULL, NULL);
+        }
+    }
+    CHECK_RESULT(err != CL_SUCCESS, "clEnqueueCopyBufferRect failed with Error code = %d", err);
+    return true;
+}
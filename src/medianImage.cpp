@@ -0,0 +1,429 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <medianImage.cpp>
+*
+* @brief Pitched image descriptors with a region of interest and the extent 
+*        of the valid halo around it. Engines filter images without a full
+*        halo in place: the interior is read straight from the caller's 
+*        buffer and only thin border strips are copied with their halo,
+*        which is computed on the fly in the selected border mode.
+*
+********************************************************************************
+*/
+#include "medianImage.h"
+#include "macros.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+*******************************************************************************
+*  @fn     initMedianImage
+*  @brief  Describes a whole buffer without halo and with a zero border
+*
+*  @param[out] image    : descriptor
+*  @param[in] data      : first pixel
+*  @param[in] width     : width in pixels
+*  @param[in] height    : height in pixels
+*  @param[in] pitch     : row pitch in pixels, 0 for width
+*  @param[in] bitWidth  : 8 or 16 bit samples
+*
+*  @return void
+*******************************************************************************
+*/
+void initMedianImage(MedianImage *image, cl_uchar *data, cl_uint width, cl_uint height,
+                size_t pitch, cl_uint bitWidth)
+{
+    image->data = data;
+    image->pitch = pitch ? pitch : width;
+    image->bitWidth = bitWidth;
+    image->x = 0;
+    image->y = 0;
+    image->width = width;
+    image->height = height;
+    /* Pitch padding is not image content and never read as halo */
+    image->haloLeft = 0;
+    image->haloTop = 0;
+    image->haloRight = 0;
+    image->haloBottom = 0;
+    image->borderMode = MEDIAN_BORDER_CONSTANT;
+    image->borderValue = 0;
+}
+
+/**
+*******************************************************************************
+*  @fn     setMedianImageBorder
+*  @brief  Selects how neighbours beyond the ROI and halo are formed
+*
+*  @param[in/out] image  : descriptor
+*  @param[in] mode       : MEDIAN_BORDER_*
+*  @param[in] value      : pixel of MEDIAN_BORDER_CONSTANT
+*
+*  @return void
+*******************************************************************************
+*/
+void setMedianImageBorder(MedianImage *image, cl_uint mode, cl_uint value)
+{
+    image->borderMode = mode;
+    image->borderValue = value;
+}
+
+/**
+*******************************************************************************
+*  @fn     initPaddedMedianImage
+*  @brief  Describes a padded buffer, e.g. the input of readInput, whose ROI 
+*          is surrounded by a border of the given width on all sides
+*
+*  @param[out] image    : descriptor
+*  @param[in] data      : top left pixel of the border
+*  @param[in] width     : ROI width in pixels
+*  @param[in] height    : ROI height in pixels
+*  @param[in] pitch     : row pitch in pixels, 0 for width + 2 * border
+*  @param[in] bitWidth  : 8 or 16 bit samples
+*  @param[in] border    : border width
+*
+*  @return void
+*******************************************************************************
+*/
+void initPaddedMedianImage(MedianImage *image, cl_uchar *data, cl_uint width,
+                cl_uint height, size_t pitch, cl_uint bitWidth, cl_uint border)
+{
+    initMedianImage(image, data, width, height, pitch ? pitch : width + 2 * border, bitWidth);
+    image->x = border;
+    image->y = border;
+    image->haloLeft = border;
+    image->haloTop = border;
+    image->haloRight = border;
+    image->haloBottom = border;
+}
+
+/**
+*******************************************************************************
+*  @fn     getMedianImageView
+*  @brief  Describes a sub-rectangle of the ROI of an image. The rest of the
+*          image and its halo become the halo of the view.
+*
+*  @param[in] image    : image
+*  @param[in] x        : left column of the view in the ROI of image
+*  @param[in] y        : top row of the view in the ROI of image
+*  @param[in] width    : view width
+*  @param[in] height   : view height
+*  @param[out] view    : view descriptor sharing the buffer of image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool getMedianImageView(const MedianImage *image, cl_uint x, cl_uint y, cl_uint width,
+                cl_uint height, MedianImage *view)
+{
+    CHECK_RESULT(width == 0 || height == 0 || x > image->width - width
+                    || y > image->height - height || width > image->width
+                    || height > image->height,
+                    "View %dx%d at (%d, %d) is outside the %dx%d image", width, height, x, y,
+                    image->width, image->height);
+
+    *view = *image;
+    view->x = image->x + x;
+    view->y = image->y + y;
+    view->width = width;
+    view->height = height;
+    view->haloLeft = image->haloLeft + x;
+    view->haloTop = image->haloTop + y;
+    view->haloRight = image->haloRight + (image->width - x - width);
+    view->haloBottom = image->haloBottom + (image->height - y - height);
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     checkMedianImages
+*  @brief  Checks that a source and destination can be filtered: same size
+*          and sample type, and a supported filter size
+*
+*  @param[in] src         : source
+*  @param[in] dst         : destination
+*  @param[in] filterSize  : filter size
+*
+*  @return bool : true if they fit; otherwise false.
+*******************************************************************************
+*/
+bool checkMedianImages(const MedianImage *src, const MedianImage *dst, cl_uint filterSize)
+{
+    cl_uint radius = filterSize / 2;
+    CHECK_RESULT(src->width != dst->width || src->height != dst->height,
+                    "Source %dx%d and destination %dx%d differ in size", src->width,
+                    src->height, dst->width, dst->height);
+    CHECK_RESULT(src->bitWidth != dst->bitWidth, "Source and destination differ in bit width");
+    CHECK_RESULT(radius == 0, "Unsupported filter size %d", filterSize);
+    CHECK_RESULT(src->borderMode > MEDIAN_BORDER_WRAP, "Unknown border mode %d",
+                    src->borderMode);
+    return true;
+}
+
+/* True if the rows [row, row + height) of byte columns [col, col + width)
+ * meet the rows [0, srcHeight) of byte columns [0, srcWidth) */
+static bool overlapRect(intptr_t col, intptr_t row, intptr_t width, intptr_t height,
+                intptr_t srcWidth, intptr_t srcHeight)
+{
+    return col < srcWidth && col + width > 0 && row < srcHeight && row + height > 0;
+}
+
+/**
+*******************************************************************************
+*  @fn     overlapMedianImages
+*  @brief  Checks whether filtering src into dst would overwrite pixels still
+*          to be read: the ROI of dst meets the ROI of src or the part of its
+*          halo within filterSize / 2. Rows of the same pitch are compared
+*          exactly, so e.g. the two halves of one buffer do not overlap;
+*          otherwise the byte spans of the two are compared.
+*
+*  @param[in] src         : source
+*  @param[in] dst         : destination
+*  @param[in] filterSize  : filter size
+*
+*  @return bool : true if they overlap; otherwise false.
+*******************************************************************************
+*/
+bool overlapMedianImages(const MedianImage *src, const MedianImage *dst, cl_uint filterSize)
+{
+    if (src->width == 0 || src->height == 0 || dst->width == 0 || dst->height == 0)
+        return false;
+
+    cl_uint radius = filterSize / 2;
+    cl_uint left = (src->haloLeft < radius) ? src->haloLeft : radius;
+    cl_uint top = (src->haloTop < radius) ? src->haloTop : radius;
+    cl_uint right = (src->haloRight < radius) ? src->haloRight : radius;
+    cl_uint bottom = (src->haloBottom < radius) ? src->haloBottom : radius;
+
+    /* Both rectangles in bytes, dst relative to the first byte read of src */
+    intptr_t srcPixel = src->bitWidth / 8;
+    intptr_t dstPixel = dst->bitWidth / 8;
+    intptr_t srcPitch = (intptr_t)src->pitch * srcPixel;
+    intptr_t dstPitch = (intptr_t)dst->pitch * dstPixel;
+    intptr_t srcWidth = (intptr_t)(left + src->width + right) * srcPixel;
+    intptr_t srcHeight = top + src->height + bottom;
+    intptr_t dstWidth = (intptr_t)dst->width * dstPixel;
+    intptr_t dstHeight = dst->height;
+    intptr_t offset = (intptr_t)getMedianImagePixel(dst, 0, 0)
+                    - (intptr_t)getMedianImagePixel(src, -(cl_int)left, -(cl_int)top);
+
+    if (srcPitch != dstPitch)
+    {
+        intptr_t srcSpan = (srcHeight - 1) * srcPitch + srcWidth;
+        intptr_t dstSpan = (dstHeight - 1) * dstPitch + dstWidth;
+        return offset < srcSpan && offset + dstSpan > 0;
+    }
+
+    intptr_t row = offset / srcPitch;
+    intptr_t col = offset % srcPitch;
+    if (col < 0)
+    {
+        col += srcPitch;
+        row--;
+    }
+
+    /* A dst row may run past the end of a src row into the next one */
+    if (overlapRect(col, row, dstWidth, dstHeight, srcWidth, srcHeight))
+        return true;
+    return col + dstWidth > srcPitch && overlapRect(col - srcPitch, row + 1, dstWidth,
+                    dstHeight, srcWidth, srcHeight);
+}
+
+/**
+*******************************************************************************
+*  @fn     fillMedianHalo
+*  @brief  Copies a rectangle of an image into out. The rectangle is relative
+*          to the ROI and may extend past the ROI and its halo; pixels beyond
+*          the halo are formed by the border mode of the image.
+*
+*  @param[in] image     : image
+*  @param[in] col       : left column relative to the ROI
+*  @param[in] row       : top row relative to the ROI
+*  @param[in] width     : rectangle width
+*  @param[in] height    : rectangle height
+*  @param[out] out      : width x height pixels
+*  @param[in] outPitch  : row pitch of out in pixels
+*
+*  @return void
+*******************************************************************************
+*/
+void fillMedianHalo(const MedianImage *image, cl_int col, cl_int row, cl_uint width,
+                cl_uint height, cl_uchar *out, size_t outPitch)
+{
+    switch (image->borderMode)
+    {
+    case MEDIAN_BORDER_REPLICATE:
+        copyMedianHalo<MEDIAN_BORDER_REPLICATE>(image, col, row, width, height, out, outPitch);
+        break;
+    case MEDIAN_BORDER_REFLECT_101:
+        copyMedianHalo<MEDIAN_BORDER_REFLECT_101>(image, col, row, width, height, out, outPitch);
+        break;
+    case MEDIAN_BORDER_WRAP:
+        copyMedianHalo<MEDIAN_BORDER_WRAP>(image, col, row, width, height, out, outPitch);
+        break;
+    default:
+        copyMedianHalo<MEDIAN_BORDER_CONSTANT>(image, col, row, width, height, out, outPitch);
+        break;
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     fillMedianImageBorder
+*  @brief  Overwrites the halo of an image in memory with its border, formed
+*          from the ROI alone by the border mode of the image. Only the halo 
+*          is written, e.g. the padding of readInput.
+*
+*  @param[in] image : padded image
+*
+*  @return void
+*******************************************************************************
+*/
+void fillMedianImageBorder(const MedianImage *image)
+{
+    MedianImage roi = *image;
+    roi.haloLeft = 0;
+    roi.haloTop = 0;
+    roi.haloRight = 0;
+    roi.haloBottom = 0;
+
+    cl_int left = image->haloLeft, top = image->haloTop;
+    cl_int width = image->width, height = image->height;
+    for (cl_int y = 0; y < height; y++)
+    {
+        if (image->haloLeft)
+            fillMedianHalo(&roi, -left, y, image->haloLeft, 1,
+                            getMedianImagePixel(image, -left, y), image->pitch);
+        if (image->haloRight)
+            fillMedianHalo(&roi, width, y, image->haloRight, 1,
+                            getMedianImagePixel(image, width, y), image->pitch);
+    }
+
+    cl_uint rowPixels = image->haloLeft + image->width + image->haloRight;
+    if (image->haloTop)
+        fillMedianHalo(&roi, -left, -top, rowPixels, image->haloTop,
+                        getMedianImagePixel(image, -left, -top), image->pitch);
+    if (image->haloBottom)
+        fillMedianHalo(&roi, -left, height, rowPixels, image->haloBottom,
+                        getMedianImagePixel(image, -left, height), image->pitch);
+}
+
+/**
+*******************************************************************************
+*  @fn     filterStrip
+*  @brief  Filters a rectangle of the ROI from a copy of it and its halo
+*
+*  @param[in] src         : source
+*  @param[in] dst         : destination
+*  @param[in] filterSize  : filter size
+*  @param[in] x           : left column of the strip in the ROI
+*  @param[in] y           : top row of the strip in the ROI
+*  @param[in] width       : strip width
+*  @param[in] height      : strip height
+*  @param[in] filter      : engine
+*  @param[in] arg         : engine argument
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool filterStrip(const MedianImage *src, const MedianImage *dst, cl_uint filterSize,
+                cl_uint x, cl_uint y, cl_uint width, cl_uint height, MedianRegionFilter filter,
+                void *arg)
+{
+    if (width == 0 || height == 0)
+        return true;
+
+    cl_int radius = filterSize / 2;
+    size_t pitch = width + filterSize - 1;
+    cl_uchar *halo = (cl_uchar *)malloc(pitch * (height + filterSize - 1) * (src->bitWidth / 8));
+    CHECK_RESULT(halo == NULL, "Malloc failed.\n");
+    fillMedianHalo(src, (cl_int)x - radius, (cl_int)y - radius, (cl_uint)pitch,
+                    height + filterSize - 1, halo, pitch);
+
+    MedianImage stripSrc, stripDst;
+    initPaddedMedianImage(&stripSrc, halo, width, height, pitch, src->bitWidth, radius);
+    bool filtered = getMedianImageView(dst, x, y, width, height, &stripDst)
+                    && filter(&stripSrc, &stripDst, filterSize, arg);
+    free(halo);
+    return filtered;
+}
+
+/**
+*******************************************************************************
+*  @fn     runMedianFilterRegions
+*  @brief  Runs an engine over an image whose halo may be thinner than 
+*          filterSize / 2, e.g. an unpadded buffer. The interior, whose 
+*          neighbours all lie in the ROI or halo, is filtered straight from
+*          the caller's buffer. Only the remaining border strips, at most 
+*          filterSize / 2 pixels thick, are copied with a halo formed by the
+*          border mode.
+*
+*  @param[in] src         : source
+*  @param[in] dst         : destination of the same size
+*  @param[in] filterSize  : filter size
+*  @param[in] filter      : engine for sources with a full halo
+*  @param[in] arg         : engine argument
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runMedianFilterRegions(const MedianImage *src, const MedianImage *dst,
+                cl_uint filterSize, MedianRegionFilter filter, void *arg)
+{
+    if (!checkMedianImages(src, dst, filterSize))
+        return false;
+
+    /* Columns x0..x1 and rows y0..y1 of the ROI have a full neighbourhood */
+    cl_uint radius = filterSize / 2;
+    cl_uint left = (src->haloLeft < radius) ? radius - src->haloLeft : 0;
+    cl_uint top = (src->haloTop < radius) ? radius - src->haloTop : 0;
+    cl_uint right = (src->haloRight < radius) ? radius - src->haloRight : 0;
+    cl_uint bottom = (src->haloBottom < radius) ? radius - src->haloBottom : 0;
+    if (left + top + right + bottom == 0)
+        return filter(src, dst, filterSize, arg);
+
+    cl_uint x0 = (left < src->width) ? left : src->width;
+    cl_uint y0 = (top < src->height) ? top : src->height;
+    cl_uint x1 = (src->width - x0 > right) ? src->width - right : x0;
+    cl_uint y1 = (src->height - y0 > bottom) ? src->height - bottom : y0;
+
+    if (x1 > x0 && y1 > y0)
+    {
+        MedianImage srcInterior, dstInterior;
+        if (!getMedianImageView(src, x0, y0, x1 - x0, y1 - y0, &srcInterior)
+                        || !getMedianImageView(dst, x0, y0, x1 - x0, y1 - y0, &dstInterior)
+                        || !filter(&srcInterior, &dstInterior, filterSize, arg))
+            return false;
+    }
+
+    return filterStrip(src, dst, filterSize, 0, 0, src->width, y0, filter, arg)
+                    && filterStrip(src, dst, filterSize, 0, y1, src->width, src->height - y1,
+                                    filter, arg)
+                    && filterStrip(src, dst, filterSize, 0, y0, x0, y1 - y0, filter, arg)
+                    && filterStrip(src, dst, filterSize, x1, y0, src->width - x1, y1 - y0,
+                                    filter, arg);
+}
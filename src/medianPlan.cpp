@@ -0,0 +1,299 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <medianPlan.cpp>
+*
+* @brief Plan and execute API of the median filter. A plan fixes the image 
+*        geometry, sample type, filter size and engine, and owns everything
+*        an execution needs, so filtering many images of one size allocates
+*        nothing per image. Executions check a context out of the plan's pool,
+*        which makes a plan safe to share between threads.
+*
+********************************************************************************
+*/
+#include "medianPlan.h"
+#include "cpuMedianFilter.h"
+#include <string.h>
+
+/**
+*******************************************************************************
+*  @fn     createMedianPlan
+*  @brief  Creates a plan. The source of executeMedianPlan is a padded image
+*          with a filterSize / 2 border on all sides, as produced by 
+*          readInput; the destination is width x height without padding.
+*          executeMedianPlanImage also takes unpadded sources.
+*
+*  @param[in] width           : image width
+*  @param[in] height          : image height
+*  @param[in] pitch           : row pitch of the padded source in pixels, 0 
+*                               for width + filterSize - 1
+*  @param[in] type            : MEDIAN_TYPE_8U or MEDIAN_TYPE_16U
+*  @param[in] filterSize      : 3 or 5
+*  @param[in] engine          : MEDIAN_ENGINE_*
+*  @param[in] numContexts     : number of concurrent executions, 0 for 1
+*  @param[in] flags           : MEDIAN_PLAN_* options of the OpenCL engine; the
+*                               program is built, never cached in a file
+*  @param[in] infoDeviceOcl   : initialized OpenCL device for 
+*                               MEDIAN_ENGINE_OPENCL, otherwise unused
+*  @param[out] plan           : the plan, release with destroyMedianPlan
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createMedianPlan(cl_uint width, cl_uint height, cl_uint pitch, cl_uint type,
+                cl_uint filterSize, cl_uint engine, cl_uint numContexts, cl_uint flags,
+                DeviceInfo *infoDeviceOcl, MedianPlan *plan)
+{
+    memset(plan, 0, sizeof(MedianPlan));
+    CHECK_RESULT(width == 0 || height == 0, "Invalid image size %dx%d", width, height);
+    CHECK_RESULT(!(type == MEDIAN_TYPE_8U || type == MEDIAN_TYPE_16U),
+                    "Un-supported type, only 8 and 16 bits are supported");
+    CHECK_RESULT(!(filterSize == 3 || filterSize == 5),
+                    "Unsupported filter size %d, only 3 and 5 are supported", filterSize);
+    if (pitch == 0)
+        pitch = width + filterSize - 1;
+    CHECK_RESULT(pitch < width + filterSize - 1, "Pitch %d is below %d", pitch,
+                    width + filterSize - 1);
+
+    plan->width = width;
+    plan->height = height;
+    plan->pitch = pitch;
+    plan->type = type;
+    plan->filterSize = filterSize;
+    plan->engine = engine;
+    plan->device = infoDeviceOcl;
+    if (!createMedianContextPool(numContexts ? numContexts : 1, &plan->pool))
+        return false;
+
+    size_t bytesPerPixel = type / 8;
+    switch (engine)
+    {
+    case MEDIAN_ENGINE_OPENCL:
+    {
+        CHECK_RESULT(infoDeviceOcl == NULL, "The OpenCL engine needs a device");
+        plan->config.filtSize = filterSize;
+        plan->config.bitWidth = type;
+        plan->config.useLds = 0;
+        plan->config.deviceType = infoDeviceOcl->mDeviceType;
+        plan->config.usePacked = (flags & MEDIAN_PLAN_PACKED) != 0;
+        bool fixedRes = (flags & MEDIAN_PLAN_FIXED_RES) != 0;
+        plan->config.fixedWidth = fixedRes ? width : 0;
+        plan->config.fixedHeight = fixedRes ? height : 0;
+        plan->config.fixedPitch = fixedRes ? width + filterSize - 1 : 0;
+        plan->config.cacheBinary = 0;
+        if (!buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                        &plan->kernel, &plan->config))
+            return false;
+
+        /* Arguments are set once per context; executions only enqueue. The
+         * device buffers are packed whatever the pitch of the host images. */
+        MedianOutputLayout layout;
+        initMedianOutputLayout(&layout, width, 0, OUT_BORDER_NONE);
+        for (cl_uint i = 0; i < plan->pool.numContexts; i++)
+        {
+            MedianContext *context = &plan->pool.contexts[i];
+            cl_int err;
+            context->queue = clCreateCommandQueue(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                            0, &err);
+            CHECK_RESULT(err != CL_SUCCESS, "clCreateCommandQueue failed. Err code = %d", err);
+            if (!createMedianFilterKernelInstance(plan->kernel, &context->kernel))
+                return false;
+
+            context->input = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_READ_ONLY,
+                            (size_t)(width + filterSize - 1) * (height + filterSize - 1)
+                                            * bytesPerPixel, NULL, &err);
+            CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+            context->output = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_WRITE_ONLY,
+                            (size_t)width * height * bytesPerPixel, NULL, &err);
+            CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+
+            if (!setMedianFilterKernelArgs(context->kernel, context->input, context->output,
+                            width, height, width + filterSize - 1, &layout))
+                return false;
+        }
+        return true;
+    }
+    case MEDIAN_ENGINE_IPP:
+        for (cl_uint i = 0; i < plan->pool.numContexts; i++)
+        {
+            if (!initIppMedianFilter(filterSize, width, height, type,
+                            &plan->pool.contexts[i].ippBuffer))
+                return false;
+        }
+        return true;
+    case MEDIAN_ENGINE_CPU:
+    case MEDIAN_ENGINE_CPU_TILED:
+        return true;
+    case MEDIAN_ENGINE_TEMPLATE:
+        return median::getFilterTable(type, filterSize, filterSize, &plan->filters);
+    default:
+        CHECK_RESULT(true, "Unknown engine %d", engine);
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     executeMedianPlan
+*  @brief  Filters one padded image laid out as described to createMedianPlan
+*
+*  @param[in] plan  : plan created by createMedianPlan
+*  @param[in] src   : top left pixel of the padded source
+*  @param[out] dst  : width x height output
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool executeMedianPlan(const MedianPlan *plan, const cl_uchar *src, cl_uchar *dst)
+{
+    MedianImage srcImage, dstImage;
+    initPaddedMedianImage(&srcImage, (cl_uchar *)src, plan->width, plan->height, plan->pitch,
+                    plan->type, plan->filterSize / 2);
+    initMedianImage(&dstImage, dst, plan->width, plan->height, 0, plan->type);
+    return executeMedianPlanImage(plan, &srcImage, &dstImage);
+}
+
+/**
+*******************************************************************************
+*  @fn     executeMedianPlanImage
+*  @brief  Filters the ROI of src into the ROI of dst, e.g. regions of the 
+*          caller's frame buffers, without copies on the host. The ROIs have
+*          the size of the plan. Neighbours are read from the halo of src;
+*          where it is thinner than filterSize / 2, e.g. for an unpadded 
+*          image, they are formed by its border mode. Any number of threads 
+*          may execute a plan at once; beyond the number of contexts they wait
+*          for each other. The cpu engine filters in place when src and dst
+*          describe the same ROI of one buffer; other overlaps are rejected.
+*
+*  @param[in] plan  : plan created by createMedianPlan
+*  @param[in] src   : source image or view
+*  @param[in] dst   : destination image or view
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool executeMedianPlanImage(const MedianPlan *plan, const MedianImage *src,
+                const MedianImage *dst)
+{
+    CHECK_RESULT(src->width != plan->width || src->height != plan->height
+                    || src->bitWidth != plan->type,
+                    "A %dx%d %d bit image does not fit a %dx%d %d bit plan", src->width,
+                    src->height, src->bitWidth, plan->width, plan->height, plan->type);
+    if (!checkMedianImages(src, dst, plan->filterSize))
+        return false;
+
+    bool inPlace = src->data == dst->data && src->pitch == dst->pitch && src->x == dst->x
+                    && src->y == dst->y;
+    CHECK_RESULT(inPlace && plan->engine != MEDIAN_ENGINE_CPU,
+                    "Only the cpu engine filters in place");
+    CHECK_RESULT(!inPlace && overlapMedianImages(src, dst, plan->filterSize),
+                    "Source and destination overlap without describing the same ROI");
+
+    /* The native engine keeps no state */
+    if (plan->engine == MEDIAN_ENGINE_CPU && inPlace)
+        return runCpuMedianFilterInPlace(src, plan->filterSize);
+    if (plan->engine == MEDIAN_ENGINE_CPU)
+        return runCpuMedianFilterImage(src, dst, plan->filterSize);
+    if (plan->engine == MEDIAN_ENGINE_CPU_TILED)
+        return runCpuMedianFilterTiled(src, dst, plan->filterSize, CPU_MEDIAN_TILE);
+    if (plan->engine == MEDIAN_ENGINE_TEMPLATE)
+    {
+        CHECK_RESULT(src->borderMode > MEDIAN_BORDER_WRAP, "Unknown border mode %d",
+                        src->borderMode);
+        return plan->filters.run[src->borderMode](src, dst);
+    }
+
+    MedianContext *context = acquireMedianContext(&plan->pool);
+    bool executed;
+    if (plan->engine == MEDIAN_ENGINE_OPENCL)
+        executed = enqueueMedianFilterImage(context->queue, context->kernel, context->input,
+                        context->output, src, dst, &plan->config, NULL);
+    else
+        executed = runIppMedianFilterImage(src, dst, plan->filterSize, context->ippBuffer);
+
+    releaseMedianContext(&plan->pool, context);
+    return executed;
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyMedianPlan
+*  @brief  Releases what the plan created
+*
+*  @param[in/out] plan : plan, may be partially created
+*
+*  @return void
+*******************************************************************************
+*/
+void destroyMedianPlan(MedianPlan *plan)
+{
+    for (cl_uint i = 0; i < plan->pool.numContexts; i++)
+    {
+        MedianContext *context = &plan->pool.contexts[i];
+        if (context->input)
+            clReleaseMemObject(context->input);
+        if (context->output)
+            clReleaseMemObject(context->output);
+        if (context->kernel)
+            clReleaseKernel(context->kernel);
+        if (context->queue)
+            clReleaseCommandQueue(context->queue);
+        if (context->ippBuffer)
+            ippFree(context->ippBuffer);
+    }
+    destroyMedianContextPool(&plan->pool);
+    if (plan->kernel)
+        clReleaseKernel(plan->kernel);
+    memset(plan, 0, sizeof(MedianPlan));
+}
+
+/**
+*******************************************************************************
+*  @fn     getMedianEngineName
+*  @brief  Name of an engine, as accepted by the -engine option
+*
+*  @param[in] engine : MEDIAN_ENGINE_*
+*
+*  @return const char* : engine name
+*******************************************************************************
+*/
+const char *getMedianEngineName(cl_uint engine)
+{
+    switch (engine)
+    {
+    case MEDIAN_ENGINE_OPENCL:
+        return "ocl";
+    case MEDIAN_ENGINE_IPP:
+        return "ipp";
+    case MEDIAN_ENGINE_CPU:
+        return "cpu";
+    case MEDIAN_ENGINE_CPU_TILED:
+        return "cputiled";
+    case MEDIAN_ENGINE_TEMPLATE:
+        return "template";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,444 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <planarFilter.cpp>
+*
+* @brief Filters the planes of planar YUV video frames. Each plane has its own
+*        size, command queue, kernel instance and buffers, which are created
+*        once and reused for every frame; the planes of a frame are filtered 
+*        on concurrent host threads.
+*
+********************************************************************************
+*/
+#include "planarFilter.h"
+#include "y4mIO.h"
+#include "ippMedianFilter.h"
+#include <string.h>
+#include <stdlib.h>
+#include <thread>
+
+/******************************************************************************
+* Per plane resources                                                         *
+******************************************************************************/
+typedef struct PlaneWorker
+{
+    cl_uint width;
+    cl_uint height;
+    cl_uint paddedWidth;
+    cl_int filtered;            /**< The plane is filtered, not copied through */
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem input;
+    cl_mem output;
+    cl_uchar *inputPlane;       /**< Padded plane, its zero border is never written */
+    cl_uchar *oclPlane;
+    cl_uchar *ippPlane;
+    Ipp8u *ippBuffer;
+    cl_uint mismatches;
+    double kernelTime;
+    bool failed;
+} PlaneWorker;
+
+/**
+*******************************************************************************
+*  @fn     createPlaneWorker
+*  @brief  Creates the buffers of one plane and, if it is filtered, its queue,
+*          kernel instance and ipp resources. The kernel arguments do not 
+*          change between frames and are set here.
+*
+*  @param[in] infoDeviceOcl  : OpenCL context and device
+*  @param[in] medianFilter   : built kernel
+*  @param[in] width          : plane width
+*  @param[in] height         : plane height
+*  @param[in] filterSize     : filter size
+*  @param[in] bitWidth       : 8 bit or 16 bit
+*  @param[in] filtered       : the plane is filtered
+*  @param[in] verify         : allocate the ipp resources
+*  @param[out] worker        : plane resources
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool createPlaneWorker(DeviceInfo *infoDeviceOcl, cl_kernel medianFilter,
+                cl_uint width, cl_uint height, cl_uint filterSize, cl_uint bitWidth,
+                cl_int filtered, cl_uint verify, PlaneWorker *worker)
+{
+    cl_int err;
+    size_t bytesPerPixel = bitWidth / 8;
+
+    memset(worker, 0, sizeof(*worker));
+    worker->width = width;
+    worker->height = height;
+    worker->paddedWidth = width + filterSize - 1;
+    worker->filtered = filtered;
+
+    size_t inputSize = (size_t)worker->paddedWidth * (height + filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)width * height * bytesPerPixel;
+
+    worker->inputPlane = (cl_uchar *)calloc(inputSize, 1);
+    CHECK_RESULT(worker->inputPlane == NULL, "Malloc failed.\n");
+    if (!filtered)
+        return true;
+
+    worker->queue = clCreateCommandQueue(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    CL_QUEUE_PROFILING_ENABLE, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateCommandQueue failed. Err code = %d", err);
+
+    if (!createMedianFilterKernelInstance(medianFilter, &worker->kernel))
+        return false;
+
+    worker->input = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_READ_ONLY, inputSize, NULL, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+    worker->output = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_WRITE_ONLY, outputSize, NULL, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+
+    MedianOutputLayout layout;
+    initMedianOutputLayout(&layout, width, 0, OUT_BORDER_NONE);
+    if (!setMedianFilterKernelArgs(worker->kernel, worker->input, worker->output, width,
+                    height, worker->paddedWidth, &layout))
+        return false;
+
+    worker->oclPlane = (cl_uchar *)malloc(outputSize);
+    CHECK_RESULT(worker->oclPlane == NULL, "Malloc failed.\n");
+
+    if (verify)
+    {
+        worker->ippPlane = (cl_uchar *)malloc(outputSize);
+        CHECK_RESULT(worker->ippPlane == NULL, "Malloc failed.\n");
+        initIppMedianFilter(filterSize, width, height, bitWidth, &worker->ippBuffer);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyPlaneWorker
+*  @brief  Releases the resources of one plane
+*
+*  @param[in/out] worker : plane resources
+*
+*  @return void
+*******************************************************************************
+*/
+static void destroyPlaneWorker(PlaneWorker *worker)
+{
+    free(worker->inputPlane);
+    free(worker->oclPlane);
+    free(worker->ippPlane);
+    if (worker->ippBuffer)
+        ippFree(worker->ippBuffer);
+    if (worker->input)
+        clReleaseMemObject(worker->input);
+    if (worker->output)
+        clReleaseMemObject(worker->output);
+    if (worker->kernel)
+        clReleaseKernel(worker->kernel);
+    if (worker->queue)
+        clReleaseCommandQueue(worker->queue);
+}
+
+/**
+*******************************************************************************
+*  @fn     filterPlane
+*  @brief  Filters the current frame of one plane, and verifies it against
+*          ipp. Sets worker->failed on error.
+*
+*  @param[in/out] worker  : plane resources
+*  @param[in] config      : kernel configuration
+*  @param[in] verify      : run ipp and compare
+*
+*  @return void
+*******************************************************************************
+*/
+static void filterPlane(PlaneWorker *worker, const MedianKernelConfig *config, cl_uint verify)
+{
+    cl_int status;
+    cl_uint filterSize = config->filtSize;
+    size_t bytesPerPixel = config->bitWidth / 8;
+    size_t inputSize = (size_t)worker->paddedWidth * (worker->height + filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)worker->width * worker->height * bytesPerPixel;
+
+    status = clEnqueueWriteBuffer(worker->queue, worker->input, CL_FALSE, 0, inputSize,
+                    worker->inputPlane, 0, NULL, NULL);
+    cl_event ev;
+    if (status != CL_SUCCESS || !runMedianFilterKernel(worker->queue, worker->kernel,
+                    worker->width, worker->height, config, &ev))
+    {
+        worker->failed = true;
+        return;
+    }
+    status = clEnqueueReadBuffer(worker->queue, worker->output, CL_TRUE, 0, outputSize,
+                    worker->oclPlane, 0, NULL, NULL);
+
+    cl_ulong timeStart, timeEnd;
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_START, sizeof(timeStart), &timeStart, NULL);
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_END, sizeof(timeEnd), &timeEnd, NULL);
+    worker->kernelTime += (double)((timeEnd - timeStart) * (1.0e-6));
+    clReleaseEvent(ev);
+
+    if (status != CL_SUCCESS)
+    {
+        worker->failed = true;
+        return;
+    }
+
+    if (verify)
+    {
+        if (!runIppMedianFilter(worker->inputPlane, filterSize, worker->ippPlane,
+                        worker->width, worker->height, config->bitWidth, worker->ippBuffer))
+            worker->failed = true;
+        else if (memcmp(worker->oclPlane, worker->ippPlane, outputSize) != 0)
+            worker->mismatches++;
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     writePlanes
+*  @brief  Writes a frame made of the given result of the filtered planes and
+*          the input of the others
+*
+*  @param[in/out] writer  : output stream
+*  @param[in] workers     : plane resources
+*  @param[in] filterSize  : filter size
+*  @param[in] useIpp      : write the ipp results instead of the OpenCL ones
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool writePlanes(Y4mStream *writer, const PlaneWorker *workers, cl_uint filterSize,
+                bool useIpp)
+{
+    cl_uchar *planes[Y4M_MAX_PLANES];
+    cl_uint pitches[Y4M_MAX_PLANES];
+    cl_uint filterRadius = filterSize / 2;
+
+    for (cl_uint p = 0; p < writer->numPlanes; p++)
+    {
+        const PlaneWorker *worker = &workers[p];
+        if (worker->filtered)
+        {
+            planes[p] = useIpp ? worker->ippPlane : worker->oclPlane;
+            pitches[p] = worker->width;
+        }
+        else
+        {
+            planes[p] = worker->inputPlane + ((size_t)filterRadius * worker->paddedWidth
+                            + filterRadius) * writer->bytesPerSample;
+            pitches[p] = worker->paddedWidth;
+        }
+    }
+    return writeY4mFrame(writer, planes, pitches);
+}
+
+/**
+*******************************************************************************
+*  @fn     closeY4mVideo
+*  @brief  Closes the input, kernel and outputs of runY4m, at its end or after
+*          a failed setup
+*
+*  @param[in/out] y4m       : input video
+*  @param[in] medianFilter  : built kernel
+*  @param[in/out] oclWriter : OpenCL output, or NULL if not created
+*  @param[in/out] ippWriter : ipp output, or NULL if not created
+*
+*  @return bool : true if the outputs were completed; otherwise false.
+*******************************************************************************
+*/
+static bool closeY4mVideo(Y4mStream *y4m, cl_kernel medianFilter, Y4mStream *oclWriter,
+                Y4mStream *ippWriter)
+{
+    bool ok = true;
+    clReleaseKernel(medianFilter);
+    closeY4m(y4m);
+    if (oclWriter)
+        ok = closeY4m(oclWriter) && ok;
+    if (ippWriter)
+        ok = closeY4m(ippWriter) && ok;
+    return ok;
+}
+
+/**
+*******************************************************************************
+*  @fn     runY4m
+*  @brief  Filters every frame of a Y4M video. The luma plane is always 
+*          filtered, the chroma planes if filterChroma is set; the planes of
+*          a frame are filtered concurrently, each on its own queue.
+*
+*  @param[in/out] infoDeviceOcl  : Structure which holds openCL related params
+*  @param[in] inputVideo         : input Y4M name
+*  @param[in] medianOutputVideo  : OpenCL output Y4M name
+*  @param[in] ippOutputVideo     : ipp output Y4M name
+*  @param[in] filterSize         : filter size (only 3 and 5 are currently supported)
+*  @param[in] deviceNum          : device on which to run OpenCL kernels
+*  @param[in] useLds             : Should the OpenCL kernel use LDS memory for input
+*  @param[in] usePacked          : Use the packed kernel for 8 bit input
+*  @param[in] filterChroma       : Filter the U and V planes as well
+*  @param[in] verify             : Run ipp on every plane and compare
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runY4m(DeviceInfo *infoDeviceOcl, const char *inputVideo,
+                const char *medianOutputVideo, const char *ippOutputVideo,
+                cl_uint filterSize, cl_uint deviceNum, cl_int useLds, cl_int usePacked,
+                cl_int filterChroma, cl_uint verify)
+{
+    Y4mStream y4m;
+    timer videoTimer;
+    timerStart(&videoTimer);
+
+    if (!openY4m(inputVideo, &y4m))
+        return false;
+
+    if (initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        closeY4m(&y4m);
+        return false;
+    }
+
+    /* Samples of more than 8 bits are filtered in 16 bit buffers */
+    cl_uint bitWidth = 8 * y4m.bytesPerSample;
+
+    MedianKernelConfig config;
+    config.filtSize = filterSize;
+    config.bitWidth = bitWidth;
+    config.useLds = useLds;
+    config.deviceType = infoDeviceOcl->mDeviceType;
+    config.usePacked = usePacked;
+    config.fixedWidth = 0;
+    config.fixedHeight = 0;
+    config.fixedPitch = 0;
+    config.cacheBinary = 0;
+
+    cl_kernel medianFilter;
+    if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    &medianFilter, &config) == false)
+    {
+        printf("Error in buildMedianFilterKernel.\n");
+        closeY4m(&y4m);
+        return false;
+    }
+
+    Y4mStream oclWriter, ippWriter;
+    if (!createY4mWriter(medianOutputVideo, &y4m, &oclWriter))
+    {
+        closeY4mVideo(&y4m, medianFilter, NULL, NULL);
+        return false;
+    }
+    if (verify && !createY4mWriter(ippOutputVideo, &y4m, &ippWriter))
+    {
+        closeY4mVideo(&y4m, medianFilter, &oclWriter, NULL);
+        return false;
+    }
+
+    printf("Executing Median filter on the %s of a Y4M video", 
+                    (filterChroma && y4m.numPlanes > 1) ? "Y, U and V planes" : "Y plane");
+    printf("\n\tFilter size: %dx%d\n\tInput video: %d bit samples, %d planes\n\tInput video resolution: %dx%d, chroma %dx%d\n",
+                    filterSize, filterSize, y4m.sampleBits, y4m.numPlanes, y4m.width, y4m.height,
+                    y4m.planeWidth[1], y4m.planeHeight[1]);
+    printMedianFilterKernelInfo(medianFilter, infoDeviceOcl->mDevice);
+    printf("\n\n");
+
+    /**************************************************************************
+    * Plane resources are sized once and reused for every frame
+    ***************************************************************************/
+    PlaneWorker workers[Y4M_MAX_PLANES];
+    memset(workers, 0, sizeof(workers));
+    bool ok = true;
+    for (cl_uint p = 0; p < y4m.numPlanes && ok; p++)
+        ok = createPlaneWorker(infoDeviceOcl, medianFilter, y4m.planeWidth[p],
+                        y4m.planeHeight[p], filterSize, bitWidth, p == 0 || filterChroma,
+                        verify, &workers[p]);
+
+    cl_uchar *planes[Y4M_MAX_PLANES];
+    cl_uint pitches[Y4M_MAX_PLANES];
+    cl_uint filterRadius = filterSize / 2;
+    for (cl_uint p = 0; p < y4m.numPlanes; p++)
+    {
+        planes[p] = workers[p].inputPlane + ((size_t)filterRadius * workers[p].paddedWidth
+                        + filterRadius) * y4m.bytesPerSample;
+        pitches[p] = workers[p].paddedWidth;
+    }
+
+    /**************************************************************************
+    * Read a frame into the padded planes, filter the planes concurrently and
+    * write the frame
+    ***************************************************************************/
+    cl_uint frames = 0;
+    bool endOfStream = false;
+    while (ok && readY4mFrame(&y4m, planes, pitches, &endOfStream) && !endOfStream)
+    {
+        std::thread threads[Y4M_MAX_PLANES];
+        for (cl_uint p = 1; p < y4m.numPlanes; p++)
+        {
+            if (workers[p].filtered)
+                threads[p] = std::thread(filterPlane, &workers[p], &config, verify);
+        }
+        filterPlane(&workers[0], &config, verify);
+        for (cl_uint p = 1; p < y4m.numPlanes; p++)
+        {
+            if (threads[p].joinable())
+                threads[p].join();
+        }
+
+        for (cl_uint p = 0; p < y4m.numPlanes; p++)
+            ok = ok && !workers[p].failed;
+        ok = ok && writePlanes(&oclWriter, workers, filterSize, false);
+        if (verify)
+            ok = ok && writePlanes(&ippWriter, workers, filterSize, true);
+        frames++;
+    }
+    ok = ok && endOfStream;
+
+    cl_uint mismatches = 0;
+    double kernelTime = 0;
+    for (cl_uint p = 0; p < y4m.numPlanes; p++)
+    {
+        mismatches += workers[p].mismatches;
+        kernelTime += workers[p].kernelTime;
+        destroyPlaneWorker(&workers[p]);
+    }
+
+    ok = closeY4mVideo(&y4m, medianFilter, &oclWriter, verify ? &ippWriter : NULL) && ok;
+
+    CHECK_RESULT(!ok, "Filtering the video failed after %d frames", frames);
+
+    double totalTime = 1000 * timerCurrent(&videoTimer);
+    printf("Filtered %d frames, %f msec of OpenCL kernel time over all planes\n", frames, kernelTime);
+    printf("Total time taken including file I/O is %f msec\n\n", totalTime);
+    printf("OpenCL Median Filter output written to %s\n", medianOutputVideo);
+    if (verify)
+    {
+        printf("ipp Median filter Output written to %s\n", ippOutputVideo);
+        if (mismatches)
+            printf("\nVerification failed in %d planes!!\n\n", mismatches);
+        else
+            printf("\nVerification succeeded!!\n\n");
+    }
+    return true;
+}
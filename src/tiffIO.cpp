@@ -0,0 +1,564 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <tiffIO.cpp>
+*
+* @brief Contains functions to read and write uncompressed striped and tiled
+*        TIFF files a tile at a time
+*
+********************************************************************************
+*/
+#include "tiffIO.h"
+#include <string.h>
+#include <stdlib.h>
+
+/******************************************************************************
+* TIFF tags and field types                                                   *
+******************************************************************************/
+#define TIFF_TAG_IMAGE_WIDTH        256
+#define TIFF_TAG_IMAGE_LENGTH       257
+#define TIFF_TAG_BITS_PER_SAMPLE    258
+#define TIFF_TAG_COMPRESSION        259
+#define TIFF_TAG_PHOTOMETRIC        262
+#define TIFF_TAG_STRIP_OFFSETS      273
+#define TIFF_TAG_SAMPLES_PER_PIXEL  277
+#define TIFF_TAG_ROWS_PER_STRIP     278
+#define TIFF_TAG_STRIP_BYTE_COUNTS  279
+#define TIFF_TAG_PLANAR_CONFIG      284
+#define TIFF_TAG_TILE_WIDTH         322
+#define TIFF_TAG_TILE_LENGTH        323
+#define TIFF_TAG_TILE_OFFSETS       324
+#define TIFF_TAG_TILE_BYTE_COUNTS   325
+
+#define TIFF_TYPE_SHORT             3
+#define TIFF_TYPE_LONG              4
+
+/******************************************************************************
+* Field readers for both byte orders                                          *
+******************************************************************************/
+static inline cl_uint readTiff16(const cl_uchar *p, cl_int bigEndian)
+{
+    return bigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+static inline cl_uint readTiff32(const cl_uchar *p, cl_int bigEndian)
+{
+    return bigEndian ? (readTiff16(p, 1) << 16) | readTiff16(p + 2, 1)
+                     : readTiff16(p, 0) | (readTiff16(p + 2, 0) << 16);
+}
+
+/******************************************************************************
+* Little endian field writers and IFD entries of the writer                   *
+******************************************************************************/
+static inline void writeTiff16(cl_uchar *p, cl_uint v)
+{
+    p[0] = (cl_uchar)v;
+    p[1] = (cl_uchar)(v >> 8);
+}
+
+static inline void writeTiff32(cl_uchar *p, cl_uint v)
+{
+    writeTiff16(p, v);
+    writeTiff16(p + 2, v >> 16);
+}
+
+static cl_uchar *writeTiffEntry(cl_uchar *p, cl_uint tag, cl_uint type, cl_uint count,
+                cl_uint value)
+{
+    writeTiff16(p, tag);
+    writeTiff16(p + 2, type);
+    writeTiff32(p + 4, count);
+    writeTiff32(p + 8, 0);
+    if (type == TIFF_TYPE_SHORT && count == 1)
+        writeTiff16(p + 8, value);
+    else
+        writeTiff32(p + 8, value);
+    return p + 12;
+}
+
+/******************************************************************************
+* Location of the values of one IFD entry                                     *
+******************************************************************************/
+typedef struct TiffField
+{
+    cl_uint type;
+    cl_uint count;
+    const cl_uchar *values;
+} TiffField;
+
+/**
+*******************************************************************************
+*  @fn     getTiffField
+*  @brief  Locates the values of an IFD entry, inline or at their offset
+*
+*  @param[in] tiff      : file being opened
+*  @param[in] entry     : IFD entry
+*  @param[out] field    : type, count and location of the values
+*
+*  @return bool : true if the values are inside the file; otherwise false.
+*******************************************************************************
+*/
+static bool getTiffField(const TiffImage *tiff, const cl_uchar *entry, TiffField *field)
+{
+    field->type = readTiff16(entry + 2, tiff->bigEndian);
+    field->count = readTiff32(entry + 4, tiff->bigEndian);
+
+    /* BYTE, ASCII, SHORT, LONG, RATIONAL, SBYTE, UNDEFINED, SSHORT, SLONG, 
+       SRATIONAL, FLOAT, DOUBLE */
+    static const size_t typeSizes[13] = { 1, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8 };
+    size_t typeSize = (field->type < 13) ? typeSizes[field->type] : 1;
+    size_t bytes = typeSize * field->count;
+    if (bytes <= 4)
+    {
+        field->values = entry + 8;
+        return true;
+    }
+
+    size_t offset = readTiff32(entry + 8, tiff->bigEndian);
+    field->values = tiff->file.data + offset;
+    return offset + bytes <= tiff->file.size;
+}
+
+/**
+*******************************************************************************
+*  @fn     getTiffValue
+*  @brief  Reads one SHORT or LONG value of an IFD entry
+*
+*  @param[in] tiff      : file being opened
+*  @param[in] field     : entry values
+*  @param[in] index     : value index
+*
+*  @return cl_uint : value
+*******************************************************************************
+*/
+static cl_uint getTiffValue(const TiffImage *tiff, const TiffField *field, cl_uint index)
+{
+    if (field->type == TIFF_TYPE_SHORT)
+        return readTiff16(field->values + 2 * index, tiff->bigEndian);
+    if (field->type == TIFF_TYPE_LONG)
+        return readTiff32(field->values + 4 * index, tiff->bigEndian);
+    return field->values[index];
+}
+
+/**
+*******************************************************************************
+*  @fn     openTiff
+*  @brief  Maps a TIFF file and parses its first IFD. Uncompressed, chunky 
+*          (or single sample) striped and tiled files with 8 or 16 bits per 
+*          sample are supported. Pixel data is not touched.
+*
+*  @param[in] filename  : TIFF file name
+*  @param[out] tiff     : parsed image
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openTiff(const char *filename, TiffImage *tiff)
+{
+    tiff->chunkOffsets = NULL;
+    if (!mapFile(filename, &tiff->file))
+        return false;
+
+    const cl_uchar *data = tiff->file.data;
+    size_t size = tiff->file.size;
+
+    bool validHeader = (size >= 8) && ((data[0] == 'I' && data[1] == 'I')
+                    || (data[0] == 'M' && data[1] == 'M'));
+    tiff->bigEndian = (data[0] == 'M');
+    if (!validHeader || readTiff16(data + 2, tiff->bigEndian) != 42)
+    {
+        closeTiff(tiff);
+        CHECK_RESULT(true, "%s is not a TIFF file", filename);
+    }
+
+    size_t ifd = readTiff32(data + 4, tiff->bigEndian);
+    cl_uint numEntries = (ifd + 2 <= size) ? readTiff16(data + ifd, tiff->bigEndian) : 0;
+    if (numEntries == 0 || ifd + 2 + 12 * numEntries > size)
+    {
+        closeTiff(tiff);
+        CHECK_RESULT(true, "%s has no valid image directory", filename);
+    }
+
+    cl_uint compression = 1, planarConfig = 1, rowsPerStrip = 0;
+    cl_uint tileWidth = 0, tileLength = 0;
+    TiffField offsets = { 0, 0, NULL };
+    bool fieldsValid = true;
+
+    tiff->width = 0;
+    tiff->height = 0;
+    tiff->bitsPerSample = 1;
+    tiff->samplesPerPixel = 1;
+
+    for (cl_uint i = 0; i < numEntries; i++)
+    {
+        const cl_uchar *entry = data + ifd + 2 + 12 * i;
+        TiffField field;
+        fieldsValid = getTiffField(tiff, entry, &field) && fieldsValid;
+        if (!fieldsValid)
+            break;
+
+        switch (readTiff16(entry, tiff->bigEndian))
+        {
+        case TIFF_TAG_IMAGE_WIDTH:      tiff->width = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_IMAGE_LENGTH:     tiff->height = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_BITS_PER_SAMPLE:  tiff->bitsPerSample = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_COMPRESSION:      compression = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_SAMPLES_PER_PIXEL: tiff->samplesPerPixel = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_ROWS_PER_STRIP:   rowsPerStrip = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_PLANAR_CONFIG:    planarConfig = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_TILE_WIDTH:       tileWidth = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_TILE_LENGTH:      tileLength = getTiffValue(tiff, &field, 0); break;
+        case TIFF_TAG_STRIP_OFFSETS:
+        case TIFF_TAG_TILE_OFFSETS:     offsets = field; break;
+        default: break;
+        }
+    }
+
+    if (!fieldsValid || tiff->width == 0 || tiff->height == 0 || offsets.values == NULL
+                    || compression != 1 || (planarConfig != 1 && tiff->samplesPerPixel > 1)
+                    || !(tiff->bitsPerSample == 8 || tiff->bitsPerSample == 16))
+    {
+        closeTiff(tiff);
+        CHECK_RESULT(true, "Only uncompressed, chunky 8 and 16 bit TIFF files are supported");
+    }
+
+    tiff->tiled = (tileWidth != 0 && tileLength != 0);
+    tiff->chunkWidth = tiff->tiled ? tileWidth : tiff->width;
+    tiff->chunkHeight = tiff->tiled ? tileLength
+                    : (rowsPerStrip == 0 || rowsPerStrip > tiff->height) ? tiff->height : rowsPerStrip;
+    tiff->chunksAcross = (tiff->width + tiff->chunkWidth - 1) / tiff->chunkWidth;
+    tiff->chunksDown = (tiff->height + tiff->chunkHeight - 1) / tiff->chunkHeight;
+
+    cl_uint numChunks = tiff->chunksAcross * tiff->chunksDown;
+    if (offsets.count < numChunks)
+    {
+        closeTiff(tiff);
+        CHECK_RESULT(true, "%s has %d chunk offsets, %d expected", filename, offsets.count, numChunks);
+    }
+
+    tiff->chunkOffsets = (size_t *)malloc(numChunks * sizeof(size_t));
+    CHECK_RESULT(tiff->chunkOffsets == NULL, "Malloc failed.\n");
+
+    /* Strips are full width, so the last strip may be shorter; tiles are always whole */
+    size_t pixelBytes = tiff->samplesPerPixel * tiff->bitsPerSample / 8;
+    for (cl_uint i = 0; i < numChunks; i++)
+    {
+        cl_uint chunkRow = i / tiff->chunksAcross;
+        cl_uint rows = tiff->tiled ? tiff->chunkHeight
+                        : tiff->height - chunkRow * tiff->chunkHeight;
+        if (rows > tiff->chunkHeight)
+            rows = tiff->chunkHeight;
+
+        tiff->chunkOffsets[i] = getTiffValue(tiff, &offsets, i);
+        if (tiff->chunkOffsets[i] + (size_t)rows * tiff->chunkWidth * pixelBytes > size)
+        {
+            closeTiff(tiff);
+            CHECK_RESULT(true, "%s is truncated", filename);
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     decodeTiffRegion
+*  @brief  Decodes one sample of a rectangle of the image into a pitched 
+*          single channel buffer, crossing chunk boundaries as needed. The 
+*          rectangle must lie inside the image. Little endian 16 bit single
+*          sample rows are copied without conversion; 16 bit samples are 
+*          reduced to their 8 most significant bits for 8 bit destinations.
+*
+*  @param[in] tiff      : image opened with openTiff
+*  @param[in] channel   : sample of the pixel to decode
+*  @param[in] x0        : left column of the rectangle
+*  @param[in] y0        : top row of the rectangle
+*  @param[in] width     : rectangle width
+*  @param[in] height    : rectangle height
+*  @param[out] dst      : destination of pixel (x0, y0)
+*  @param[in] dstPitch  : destination row pitch in pixels
+*  @param[in] bitWidth  : 8 or 16 bit destination
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool decodeTiffRegion(const TiffImage *tiff, cl_uint channel, cl_uint x0, cl_uint y0,
+                cl_uint width, cl_uint height, cl_uchar *dst, size_t dstPitch,
+                cl_uint bitWidth)
+{
+    CHECK_RESULT(channel >= tiff->samplesPerPixel, "Invalid channel %d", channel);
+    CHECK_RESULT(x0 + width > tiff->width || y0 + height > tiff->height,
+                    "Region is out of the image");
+
+    cl_uint bytesPerSample = tiff->bitsPerSample / 8;
+    cl_uint pixelBytes = tiff->samplesPerPixel * bytesPerSample;
+    cl_uint hi = tiff->bigEndian ? 0 : 1;      /* Byte of the 8 most significant bits */
+    bool copy16 = (tiff->samplesPerPixel == 1 && !tiff->bigEndian);
+
+    for (cl_uint y = y0; y < y0 + height; y++)
+    {
+        cl_uint chunkY = y / tiff->chunkHeight;
+        size_t rowInChunk = (size_t)(y % tiff->chunkHeight) * tiff->chunkWidth;
+
+        for (cl_uint x = x0; x < x0 + width; )
+        {
+            cl_uint chunkX = x / tiff->chunkWidth;
+            cl_uint colInChunk = x % tiff->chunkWidth;
+            cl_uint run = tiff->chunkWidth - colInChunk;
+            if (run > x0 + width - x)
+                run = x0 + width - x;
+
+            const cl_uchar *src = tiff->file.data
+                            + tiff->chunkOffsets[chunkY * tiff->chunksAcross + chunkX]
+                            + (rowInChunk + colInChunk) * pixelBytes + channel * bytesPerSample;
+            size_t dstIndex = (y - y0) * dstPitch + (x - x0);
+
+            if (bitWidth == 8)
+            {
+                cl_uchar *row = dst + dstIndex;
+                if (bytesPerSample == 1)
+                {
+                    for (cl_uint i = 0; i < run; i++)
+                        row[i] = src[i * pixelBytes];
+                }
+                else
+                {
+                    for (cl_uint i = 0; i < run; i++)
+                        row[i] = src[i * pixelBytes + hi];
+                }
+            }
+            else
+            {
+                cl_ushort *row = (cl_ushort *)dst + dstIndex;
+                if (bytesPerSample == 1)
+                {
+                    for (cl_uint i = 0; i < run; i++)
+                        row[i] = src[i * pixelBytes];
+                }
+                else if (copy16)
+                {
+                    /* Little endian samples are the host layout of cl_ushort */
+                    memcpy(row, src, run * sizeof(cl_ushort));
+                }
+                else
+                {
+                    for (cl_uint i = 0; i < run; i++)
+                        row[i] = (cl_ushort)((src[i * pixelBytes + hi] << 8) | src[i * pixelBytes + 1 - hi]);
+                }
+            }
+            x += run;
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     closeTiff
+*  @brief  Unmaps a TIFF opened with openTiff
+*
+*  @param[in/out] tiff : image
+*
+*  @return void
+*******************************************************************************
+*/
+void closeTiff(TiffImage *tiff)
+{
+    free(tiff->chunkOffsets);
+    tiff->chunkOffsets = NULL;
+    unmapFile(&tiff->file);
+}
+
+/**
+*******************************************************************************
+*  @fn     createTiffWriter
+*  @brief  Creates a single sample, uncompressed TIFF at its final size and
+*          writes its header and image directory. Chunks are reserved at 
+*          fixed offsets behind the directory and filled by writeTiffChunk.
+*
+*  @param[in] filename      : output file name
+*  @param[in] width         : image width
+*  @param[in] height        : image height
+*  @param[in] bitsPerSample : 8 or 16
+*  @param[in] tiled         : write tiles instead of strips
+*  @param[in] chunkWidth    : tile width, ignored for strips
+*  @param[in] chunkHeight   : tile length, or rows per strip
+*  @param[out] writer       : writer state
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createTiffWriter(const char *filename, cl_uint width, cl_uint height,
+                cl_uint bitsPerSample, cl_int tiled, cl_uint chunkWidth,
+                cl_uint chunkHeight, TiffWriter *writer)
+{
+    writer->width = width;
+    writer->height = height;
+    writer->bitsPerSample = bitsPerSample;
+    writer->tiled = tiled;
+    writer->chunkWidth = tiled ? chunkWidth : width;
+    writer->chunkHeight = chunkHeight;
+    writer->chunksAcross = (width + writer->chunkWidth - 1) / writer->chunkWidth;
+    writer->chunksDown = (height + chunkHeight - 1) / chunkHeight;
+    writer->chunkBytes = (size_t)writer->chunkWidth * chunkHeight * bitsPerSample / 8;
+
+    cl_uint numChunks = writer->chunksAcross * writer->chunksDown;
+    cl_uint numEntries = tiled ? 11 : 10;
+    size_t ifdSize = 2 + 12 * numEntries + 4;
+    size_t offsetsPos = 8 + ifdSize;
+    size_t countsPos = offsetsPos + 4 * numChunks;
+
+    /* Chunks start page aligned behind the directory and its arrays */
+    writer->dataOffset = (countsPos + 4 * numChunks + 4095) & ~(size_t)4095;
+    size_t fileSize = writer->dataOffset + numChunks * writer->chunkBytes;
+    CHECK_RESULT(fileSize > 0xffffffffull, "%s would exceed the 4 GB limit of TIFF", filename);
+
+    if (!createMappedFile(filename, fileSize, &writer->file))
+        return false;
+
+    cl_uchar *data = writer->file.data;
+    data[0] = 'I';
+    data[1] = 'I';
+    writeTiff16(data + 2, 42);
+    writeTiff32(data + 4, 8);
+
+    /* Single values are stored in the entry instead of an array */
+    cl_uint offsetsValue = (numChunks == 1) ? (cl_uint)writer->dataOffset : (cl_uint)offsetsPos;
+    cl_uint countsValue = (numChunks == 1) ? (cl_uint)writer->chunkBytes : (cl_uint)countsPos;
+
+    cl_uchar *entry = data + 10;
+    writeTiff16(data + 8, numEntries);
+    entry = writeTiffEntry(entry, TIFF_TAG_IMAGE_WIDTH, TIFF_TYPE_LONG, 1, width);
+    entry = writeTiffEntry(entry, TIFF_TAG_IMAGE_LENGTH, TIFF_TYPE_LONG, 1, height);
+    entry = writeTiffEntry(entry, TIFF_TAG_BITS_PER_SAMPLE, TIFF_TYPE_SHORT, 1, bitsPerSample);
+    entry = writeTiffEntry(entry, TIFF_TAG_COMPRESSION, TIFF_TYPE_SHORT, 1, 1);
+    entry = writeTiffEntry(entry, TIFF_TAG_PHOTOMETRIC, TIFF_TYPE_SHORT, 1, 1);
+    if (tiled)
+    {
+        entry = writeTiffEntry(entry, TIFF_TAG_SAMPLES_PER_PIXEL, TIFF_TYPE_SHORT, 1, 1);
+        entry = writeTiffEntry(entry, TIFF_TAG_PLANAR_CONFIG, TIFF_TYPE_SHORT, 1, 1);
+        entry = writeTiffEntry(entry, TIFF_TAG_TILE_WIDTH, TIFF_TYPE_LONG, 1, writer->chunkWidth);
+        entry = writeTiffEntry(entry, TIFF_TAG_TILE_LENGTH, TIFF_TYPE_LONG, 1, chunkHeight);
+        entry = writeTiffEntry(entry, TIFF_TAG_TILE_OFFSETS, TIFF_TYPE_LONG, numChunks, offsetsValue);
+        entry = writeTiffEntry(entry, TIFF_TAG_TILE_BYTE_COUNTS, TIFF_TYPE_LONG, numChunks, countsValue);
+    }
+    else
+    {
+        entry = writeTiffEntry(entry, TIFF_TAG_STRIP_OFFSETS, TIFF_TYPE_LONG, numChunks, offsetsValue);
+        entry = writeTiffEntry(entry, TIFF_TAG_SAMPLES_PER_PIXEL, TIFF_TYPE_SHORT, 1, 1);
+        entry = writeTiffEntry(entry, TIFF_TAG_ROWS_PER_STRIP, TIFF_TYPE_LONG, 1, chunkHeight);
+        entry = writeTiffEntry(entry, TIFF_TAG_STRIP_BYTE_COUNTS, TIFF_TYPE_LONG, numChunks, countsValue);
+        entry = writeTiffEntry(entry, TIFF_TAG_PLANAR_CONFIG, TIFF_TYPE_SHORT, 1, 1);
+    }
+    writeTiff32(entry, 0);
+
+    if (numChunks > 1)
+    {
+        for (cl_uint i = 0; i < numChunks; i++)
+        {
+            /* The last strip only holds the remaining rows */
+            cl_uint rows = height - (i / writer->chunksAcross) * chunkHeight;
+            size_t bytes = (tiled || rows >= chunkHeight) ? writer->chunkBytes
+                            : (size_t)rows * writer->chunkWidth * bitsPerSample / 8;
+            writeTiff32(data + offsetsPos + 4 * i, (cl_uint)(writer->dataOffset + i * writer->chunkBytes));
+            writeTiff32(data + countsPos + 4 * i, (cl_uint)bytes);
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     writeTiffChunk
+*  @brief  Writes the pixels of one chunk. Tiles crossing the image border are
+*          zero filled beyond it. Different chunks may be written concurrently.
+*
+*  @param[in/out] writer : writer created with createTiffWriter
+*  @param[in] chunkX     : chunk column
+*  @param[in] chunkY     : chunk row
+*  @param[in] src        : first pixel of the chunk, clipped to the image
+*  @param[in] srcPitch   : source row pitch in pixels
+*  @param[in] bitWidth   : 8 or 16 bit source
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool writeTiffChunk(TiffWriter *writer, cl_uint chunkX, cl_uint chunkY,
+                const cl_uchar *src, size_t srcPitch, cl_uint bitWidth)
+{
+    CHECK_RESULT(chunkX >= writer->chunksAcross || chunkY >= writer->chunksDown,
+                    "Chunk %d, %d is out of the image", chunkX, chunkY);
+
+    cl_uint cols = writer->width - chunkX * writer->chunkWidth;
+    cl_uint rows = writer->height - chunkY * writer->chunkHeight;
+    if (cols > writer->chunkWidth)
+        cols = writer->chunkWidth;
+    if (rows > writer->chunkHeight)
+        rows = writer->chunkHeight;
+
+    cl_uint bytesPerSample = writer->bitsPerSample / 8;
+    cl_uchar *chunk = writer->file.data + writer->dataOffset
+                    + (size_t)(chunkY * writer->chunksAcross + chunkX) * writer->chunkBytes;
+
+    for (cl_uint y = 0; y < rows; y++)
+    {
+        cl_uchar *dst = chunk + (size_t)y * writer->chunkWidth * bytesPerSample;
+        const cl_uchar *row8 = src + y * srcPitch;
+        const cl_ushort *row16 = (const cl_ushort *)src + y * srcPitch;
+
+        if (bytesPerSample * 8 == bitWidth)
+        {
+            memcpy(dst, (bitWidth == 8) ? row8 : (const cl_uchar *)row16, cols * bytesPerSample);
+        }
+        else if (bytesPerSample == 1)
+        {
+            /* 8 bit samples filtered in a 16 bit buffer */
+            for (cl_uint x = 0; x < cols; x++)
+                dst[x] = (cl_uchar)row16[x];
+        }
+        else
+        {
+            for (cl_uint x = 0; x < cols; x++)
+                writeTiff16(dst + 2 * x, row8[x]);
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     closeTiffWriter
+*  @brief  Unmaps the file of a TiffWriter
+*
+*  @param[in/out] writer : writer created with createTiffWriter
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool closeTiffWriter(TiffWriter *writer)
+{
+    unmapFile(&writer->file);
+    return true;
+}
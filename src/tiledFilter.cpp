@@ -0,0 +1,486 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <tiledFilter.cpp>
+*
+* @brief Filters TIFF images tile by tile on several host threads, striped
+*        images in bands of rows. Each thread decodes a tile or band and its
+*        halo from the file mapping, filters it with its own command queue 
+*        and kernel instance, and writes the result into the mapped output 
+*        file.
+*
+********************************************************************************
+*/
+#include "tiledFilter.h"
+#include "tiffIO.h"
+#include "ippMedianFilter.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+/* Most pixels in a band of a striped image, whatever its RowsPerStrip */
+#define TILED_BAND_PIXELS   (1 << 20)
+
+/******************************************************************************
+* State shared by all tile workers. The chunks of the job are the tiles of a *
+* tiled input, or bands of at most TILED_BAND_PIXELS of a striped one.       *
+******************************************************************************/
+typedef struct TileJob
+{
+    const TiffImage *tiff;
+    cl_uint chunkWidth;
+    cl_uint chunkHeight;
+    cl_uint chunksAcross;
+    cl_uint chunksDown;
+    TiffWriter *oclWriter;
+    TiffWriter *ippWriter;
+    const MedianKernelConfig *config;
+    cl_uint filterSize;
+    cl_uint bitWidth;
+    cl_uint verify;
+    std::atomic<cl_uint> nextChunk;     /**< Next chunk to be claimed */
+    std::atomic<bool> failed;
+} TileJob;
+
+/******************************************************************************
+* Per thread resources, sized for one chunk and its halo                      *
+******************************************************************************/
+typedef struct TileWorker
+{
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem input;
+    cl_mem output;
+    cl_uchar *inputTile;        /**< Padded tile */
+    cl_uchar *oclTile;
+    cl_uchar *ippTile;
+    Ipp8u *ippBuffer;
+    cl_uint tiles;
+    cl_uint mismatches;
+    double kernelTime;
+} TileWorker;
+
+/**
+*******************************************************************************
+*  @fn     filterTile
+*  @brief  Decodes, filters and writes one chunk of the job. The halo is 
+*          read from the neighbouring chunks; outside the image it is zero, 
+*          as in the padded input of the whole image filter.
+*
+*  @param[in/out] job    : shared state
+*  @param[in/out] worker : resources of the calling thread
+*  @param[in] chunk      : chunk index, row major
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool filterTile(TileJob *job, TileWorker *worker, cl_uint chunk)
+{
+    const TiffImage *tiff = job->tiff;
+    cl_int status;
+
+    cl_uint chunkX = chunk % job->chunksAcross;
+    cl_uint chunkY = chunk / job->chunksAcross;
+    cl_uint x0 = chunkX * job->chunkWidth;
+    cl_uint y0 = chunkY * job->chunkHeight;
+    cl_uint width = (tiff->width - x0 < job->chunkWidth) ? tiff->width - x0 : job->chunkWidth;
+    cl_uint height = (tiff->height - y0 < job->chunkHeight) ? tiff->height - y0 : job->chunkHeight;
+
+    cl_uint filterRadius = job->filterSize / 2;
+    cl_uint paddedWidth = width + 2 * filterRadius;
+    size_t bytesPerPixel = job->bitWidth / 8;
+
+    /**************************************************************************
+    * Clip the tile and its halo to the image and decode it into the padded 
+    * tile buffer
+    ***************************************************************************/
+    cl_uint srcX0 = (x0 > filterRadius) ? x0 - filterRadius : 0;
+    cl_uint srcY0 = (y0 > filterRadius) ? y0 - filterRadius : 0;
+    cl_uint srcX1 = (x0 + width + filterRadius < tiff->width) ? x0 + width + filterRadius : tiff->width;
+    cl_uint srcY1 = (y0 + height + filterRadius < tiff->height) ? y0 + height + filterRadius : tiff->height;
+
+    memset(worker->inputTile, 0, (height + 2 * filterRadius) * paddedWidth * bytesPerPixel);
+    if (!decodeTiffRegion(tiff, 0, srcX0, srcY0, srcX1 - srcX0, srcY1 - srcY0,
+                    worker->inputTile + ((srcY0 + filterRadius - y0) * paddedWidth
+                                    + (srcX0 + filterRadius - x0)) * bytesPerPixel,
+                    paddedWidth, job->bitWidth))
+        return false;
+
+    /**************************************************************************
+    * Filter the tile on the device
+    ***************************************************************************/
+    status = clEnqueueWriteBuffer(worker->queue, worker->input, CL_FALSE, 0,
+                    (height + 2 * filterRadius) * paddedWidth * bytesPerPixel,
+                    worker->inputTile, 0, NULL, NULL);
+    CHECK_RESULT(status != CL_SUCCESS, "Error in clEnqueueWriteBuffer. Status: %d\n", status);
+
+    MedianOutputLayout layout;
+    initMedianOutputLayout(&layout, width, 0, OUT_BORDER_NONE);
+    if (!setMedianFilterKernelArgs(worker->kernel, worker->input, worker->output,
+                    width, height, paddedWidth, &layout))
+        return false;
+
+    cl_event ev;
+    if (!runMedianFilterKernel(worker->queue, worker->kernel, width, height, job->config, &ev))
+        return false;
+
+    status = clEnqueueReadBuffer(worker->queue, worker->output, CL_TRUE, 0,
+                    width * height * bytesPerPixel, worker->oclTile, 0, NULL, NULL);
+    CHECK_RESULT(status != CL_SUCCESS, "Error in clEnqueueReadBuffer. Status: %d\n", status);
+
+    cl_ulong timeStart, timeEnd;
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_START, sizeof(timeStart), &timeStart, NULL);
+    clGetEventProfilingInfo(ev, CL_PROFILING_COMMAND_END, sizeof(timeEnd), &timeEnd, NULL);
+    worker->kernelTime += (double)((timeEnd - timeStart) * (1.0e-6));
+    clReleaseEvent(ev);
+
+    if (!writeTiffChunk(job->oclWriter, chunkX, chunkY, worker->oclTile, width, job->bitWidth))
+        return false;
+
+    /**************************************************************************
+    * Verify against ipp on the same padded tile
+    ***************************************************************************/
+    if (job->verify)
+    {
+        if (!runIppMedianFilter(worker->inputTile, job->filterSize, worker->ippTile,
+                        width, height, job->bitWidth, worker->ippBuffer))
+            return false;
+        if (memcmp(worker->oclTile, worker->ippTile, width * height * bytesPerPixel) != 0)
+            worker->mismatches++;
+        if (!writeTiffChunk(job->ippWriter, chunkX, chunkY, worker->ippTile, width, job->bitWidth))
+            return false;
+    }
+
+    worker->tiles++;
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     tileWorkerThread
+*  @brief  Claims and filters chunks until all are done or a worker failed
+*
+*  @param[in/out] job    : shared state
+*  @param[in/out] worker : resources of this thread
+*
+*  @return void
+*******************************************************************************
+*/
+static void tileWorkerThread(TileJob *job, TileWorker *worker)
+{
+    cl_uint numChunks = job->chunksAcross * job->chunksDown;
+
+    while (!job->failed)
+    {
+        cl_uint chunk = job->nextChunk++;
+        if (chunk >= numChunks)
+            break;
+        if (!filterTile(job, worker, chunk))
+            job->failed = true;
+    }
+}
+
+/**
+*******************************************************************************
+*  @fn     createTileWorker
+*  @brief  Creates the queue, kernel instance and buffers of one worker
+*
+*  @param[in] infoDeviceOcl  : OpenCL context and device
+*  @param[in] medianFilter   : built kernel
+*  @param[in] job            : chunk size of the job
+*  @param[in] filterSize     : filter size
+*  @param[in] bitWidth       : 8 bit or 16 bit
+*  @param[in] verify         : allocate the ipp resources
+*  @param[out] worker        : worker resources
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+static bool createTileWorker(DeviceInfo *infoDeviceOcl, cl_kernel medianFilter,
+                const TileJob *job, cl_uint filterSize, cl_uint bitWidth,
+                cl_uint verify, TileWorker *worker)
+{
+    cl_int err;
+    size_t bytesPerPixel = bitWidth / 8;
+    size_t inputSize = (size_t)(job->chunkWidth + filterSize - 1)
+                    * (job->chunkHeight + filterSize - 1) * bytesPerPixel;
+    size_t outputSize = (size_t)job->chunkWidth * job->chunkHeight * bytesPerPixel;
+
+    memset(worker, 0, sizeof(*worker));
+
+    worker->queue = clCreateCommandQueue(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    CL_QUEUE_PROFILING_ENABLE, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateCommandQueue failed. Err code = %d", err);
+
+    if (!createMedianFilterKernelInstance(medianFilter, &worker->kernel))
+        return false;
+
+    worker->input = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_READ_ONLY, inputSize, NULL, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+    worker->output = clCreateBuffer(infoDeviceOcl->mCtx, CL_MEM_WRITE_ONLY, outputSize, NULL, &err);
+    CHECK_RESULT(err != CL_SUCCESS, "clCreateBuffer failed with %d\n", err);
+
+    worker->inputTile = (cl_uchar *)malloc(inputSize);
+    worker->oclTile = (cl_uchar *)malloc(outputSize);
+    CHECK_RESULT(worker->inputTile == NULL || worker->oclTile == NULL, "Malloc failed.\n");
+
+    if (verify)
+    {
+        worker->ippTile = (cl_uchar *)malloc(outputSize);
+        CHECK_RESULT(worker->ippTile == NULL, "Malloc failed.\n");
+        initIppMedianFilter(filterSize, job->chunkWidth, job->chunkHeight, bitWidth,
+                        &worker->ippBuffer);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     destroyTileWorker
+*  @brief  Releases the resources of one worker
+*
+*  @param[in/out] worker : worker resources
+*
+*  @return void
+*******************************************************************************
+*/
+static void destroyTileWorker(TileWorker *worker)
+{
+    free(worker->inputTile);
+    free(worker->oclTile);
+    free(worker->ippTile);
+    if (worker->ippBuffer)
+        ippFree(worker->ippBuffer);
+    if (worker->input)
+        clReleaseMemObject(worker->input);
+    if (worker->output)
+        clReleaseMemObject(worker->output);
+    if (worker->kernel)
+        clReleaseKernel(worker->kernel);
+    if (worker->queue)
+        clReleaseCommandQueue(worker->queue);
+}
+
+/**
+*******************************************************************************
+*  @fn     closeTiledTiff
+*  @brief  Releases the input, kernel and outputs of runTiledTiff, at its end
+*          or after a failed setup
+*
+*  @param[in/out] tiff      : input image
+*  @param[in] medianFilter  : built kernel
+*  @param[in/out] oclWriter : OpenCL output, or NULL if not created
+*  @param[in/out] ippWriter : ipp output, or NULL if not created
+*
+*  @return void
+*******************************************************************************
+*/
+static void closeTiledTiff(TiffImage *tiff, cl_kernel medianFilter, TiffWriter *oclWriter,
+                TiffWriter *ippWriter)
+{
+    clReleaseKernel(medianFilter);
+    closeTiff(tiff);
+    if (oclWriter)
+        closeTiffWriter(oclWriter);
+    if (ippWriter)
+        closeTiffWriter(ippWriter);
+}
+
+/**
+*******************************************************************************
+*  @fn     runTiledTiff
+*  @brief  Filters the first sample of a striped or tiled TIFF chunk by chunk
+*          on numThreads host threads, without materializing the image. Tiled
+*          input is filtered by its tiles. Striped input is filtered in bands
+*          of bounded size, whatever its RowsPerStrip, e.g. a single strip 
+*          holding the whole image. The outputs are single sample TIFF files,
+*          tiled like the input or with one strip per band.
+*
+*  @param[in/out] infoDeviceOcl : Structure which holds openCL related params
+*  @param[in] inputImage        : input TIFF name
+*  @param[in] medianOutputImage : OpenCL output TIFF name
+*  @param[in] ippOutputImage    : ipp output TIFF name
+*  @param[in] filterSize        : filter size (only 3 and 5 are currently supported)
+*  @param[in] bitWidth          : 8 bit or 16 bit
+*  @param[in] deviceNum         : device on which to run OpenCL kernels
+*  @param[in] useLds            : Should the OpenCL kernel use LDS memory for input
+*  @param[in] usePacked         : Use the packed kernel for 8 bit input
+*  @param[in] numThreads        : Number of tile workers
+*  @param[in] verify            : Run ipp on every tile and compare
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool runTiledTiff(DeviceInfo *infoDeviceOcl, const char *inputImage,
+                const char *medianOutputImage, const char *ippOutputImage,
+                cl_uint filterSize, cl_uint bitWidth, cl_uint deviceNum,
+                cl_int useLds, cl_int usePacked, cl_uint numThreads, cl_uint verify)
+{
+    TiffImage tiff;
+    timer tileTimer;
+    timerStart(&tileTimer);
+
+    if (!openTiff(inputImage, &tiff))
+        return false;
+
+    if (initOpenCl(infoDeviceOcl, deviceNum) == false)
+    {
+        printf("Error in initOpenCl.\n");
+        closeTiff(&tiff);
+        return false;
+    }
+
+    MedianKernelConfig config;
+    config.filtSize = filterSize;
+    config.bitWidth = bitWidth;
+    config.useLds = useLds;
+    config.deviceType = infoDeviceOcl->mDeviceType;
+    config.usePacked = usePacked;
+    config.fixedWidth = 0;
+    config.fixedHeight = 0;
+    config.fixedPitch = 0;
+    config.cacheBinary = 0;
+
+    cl_kernel medianFilter;
+    if (buildMedianFilterKernel(infoDeviceOcl->mCtx, infoDeviceOcl->mDevice,
+                    &medianFilter, &config) == false)
+    {
+        printf("Error in buildMedianFilterKernel.\n");
+        closeTiff(&tiff);
+        return false;
+    }
+
+    /**************************************************************************
+    * Tiles are the chunks of the job. Strips may hold the whole image, so 
+    * striped input is cut into bands small enough to keep every thread busy.
+    ***************************************************************************/
+    TileJob job;
+    job.tiff = &tiff;
+    if (numThreads == 0)
+        numThreads = 1;
+    if (tiff.tiled)
+    {
+        job.chunkWidth = tiff.chunkWidth;
+        job.chunkHeight = tiff.chunkHeight;
+    }
+    else
+    {
+        cl_uint bandRows = TILED_BAND_PIXELS / tiff.width;
+        cl_uint threadRows = (tiff.height + numThreads - 1) / numThreads;
+        job.chunkWidth = tiff.width;
+        job.chunkHeight = (bandRows == 0) ? 1 : (bandRows < threadRows) ? bandRows : threadRows;
+    }
+    job.chunksAcross = (tiff.width + job.chunkWidth - 1) / job.chunkWidth;
+    job.chunksDown = (tiff.height + job.chunkHeight - 1) / job.chunkHeight;
+
+    /* 8 bit samples stay 8 bit when filtered in a 16 bit buffer */
+    cl_uint outBits = (bitWidth == 16) ? tiff.bitsPerSample : 8;
+    TiffWriter oclWriter, ippWriter;
+    if (!createTiffWriter(medianOutputImage, tiff.width, tiff.height, outBits, tiff.tiled,
+                    job.chunkWidth, job.chunkHeight, &oclWriter))
+    {
+        closeTiledTiff(&tiff, medianFilter, NULL, NULL);
+        return false;
+    }
+    if (verify && !createTiffWriter(ippOutputImage, tiff.width, tiff.height, outBits,
+                    tiff.tiled, job.chunkWidth, job.chunkHeight, &ippWriter))
+    {
+        /* Nothing was filtered into the OpenCL output yet */
+        closeTiledTiff(&tiff, medianFilter, &oclWriter, NULL);
+        remove(medianOutputImage);
+        return false;
+    }
+
+    cl_uint numChunks = job.chunksAcross * job.chunksDown;
+    if (numThreads > numChunks)
+        numThreads = numChunks;
+
+    printf("Executing Median filter on %d %s of %dx%d with %d threads", numChunks,
+                    tiff.tiled ? "tiles" : "bands", job.chunkWidth, job.chunkHeight, numThreads);
+    printf("\n\tFilter size: %dx%d\n\tInput Image: %d bit, %d samples per pixel\n\tInput Image resolution: %dx%d\n",
+                    filterSize, filterSize, tiff.bitsPerSample, tiff.samplesPerPixel, tiff.width, tiff.height);
+    printMedianFilterKernelInfo(medianFilter, infoDeviceOcl->mDevice);
+    printf("\n\n");
+
+    /**************************************************************************
+    * Run the workers. Chunks are claimed in file order, so the reads of the 
+    * threads advance through the mapping together.
+    ***************************************************************************/
+    job.oclWriter = &oclWriter;
+    job.ippWriter = verify ? &ippWriter : NULL;
+    job.config = &config;
+    job.filterSize = filterSize;
+    job.bitWidth = bitWidth;
+    job.verify = verify;
+    job.nextChunk = 0;
+    job.failed = false;
+
+    std::vector<TileWorker> workers(numThreads);
+    bool created = true;
+    for (cl_uint i = 0; i < numThreads && created; i++)
+        created = createTileWorker(infoDeviceOcl, medianFilter, &job, filterSize, bitWidth,
+                        verify, &workers[i]);
+
+    if (created)
+    {
+        std::vector<std::thread> threads;
+        for (cl_uint i = 0; i < numThreads; i++)
+            threads.push_back(std::thread(tileWorkerThread, &job, &workers[i]));
+        for (cl_uint i = 0; i < numThreads; i++)
+            threads[i].join();
+    }
+
+    cl_uint tiles = 0, mismatches = 0;
+    double kernelTime = 0;
+    for (cl_uint i = 0; i < numThreads; i++)
+    {
+        tiles += workers[i].tiles;
+        mismatches += workers[i].mismatches;
+        kernelTime += workers[i].kernelTime;
+        destroyTileWorker(&workers[i]);
+    }
+
+    closeTiledTiff(&tiff, medianFilter, &oclWriter, verify ? &ippWriter : NULL);
+
+    CHECK_RESULT(!created || job.failed, "Filtering the tiles failed");
+
+    double totalTime = 1000 * timerCurrent(&tileTimer);
+    printf("Filtered %d chunks, %f msec of OpenCL kernel time over all threads\n", tiles, kernelTime);
+    printf("Total time taken including file I/O is %f msec\n\n", totalTime);
+    printf("OpenCL Median Filter output written to %s\n", medianOutputImage);
+    if (verify)
+    {
+        printf("ipp Median filter Output written to %s\n", ippOutputImage);
+        if (mismatches)
+            printf("\nVerification failed in %d chunks!!\n\n", mismatches);
+        else
+            printf("\nVerification succeeded!!\n\n");
+    }
+    return true;
+}
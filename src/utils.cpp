@@ -88,6 +88,145 @@ double timerCurrent(timer* mytimer)
 }
 /**
 *******************************************************************************
+*  @fn     getPeakRss
+*  @brief  Get the peak resident set size of the process
+*
+*  @return size_t : peak resident memory in bytes
+*******************************************************************************
+*/
+size_t getPeakRss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __MACH__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+/**
+*******************************************************************************
+*  @fn     getNumCpus
+*  @brief  Get the number of online logical processors
+*
+*  @return cl_uint : number of processors, at least 1
+*******************************************************************************
+*/
+cl_uint getNumCpus()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cpus > 0) ? (cl_uint)cpus : 1;
+#endif
+}
+/**
+*******************************************************************************
+*  @fn     alignedMalloc
+*  @brief  Allocates memory with the given alignment
+*
+*  @param[in] size       : number of bytes
+*  @param[in] alignment  : power of two alignment in bytes
+*
+*  @return void* : allocated memory, NULL on failure. Free with alignedFree.
+*******************************************************************************
+*/
+void *alignedMalloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+#endif
+}
+/**
+*******************************************************************************
+*  @fn     alignedFree
+*  @brief  Frees memory allocated with alignedMalloc
+*
+*  @param[in] ptr  : memory to free, may be NULL
+*
+*  @return void
+*******************************************************************************
+*/
+void alignedFree(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+/**
+*******************************************************************************
+*  @fn     hugePageMalloc
+*  @brief  Allocates a large buffer backed by transparent huge pages where 
+*          the kernel offers them. The buffer is aligned to and padded up to
+*          whole huge pages and advised with MADV_HUGEPAGE, so one TLB entry
+*          covers 2 MB of it instead of 4 KB. Elsewhere, or when the advice 
+*          is refused, it is an ordinary page aligned buffer.
+*
+*  @param[in] size  : number of bytes
+*
+*  @return void* : allocated memory, NULL on failure. Free with alignedFree.
+*******************************************************************************
+*/
+void *hugePageMalloc(size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (size >= HUGE_PAGE_SIZE)
+    {
+        size_t padded = (size + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+        void *ptr = alignedMalloc(padded, HUGE_PAGE_SIZE);
+        if (ptr != NULL)
+            madvise(ptr, padded, MADV_HUGEPAGE);
+        return ptr;
+    }
+#endif
+    return alignedMalloc(size, 4096);
+}
+/**
+*******************************************************************************
+*  @fn     getHugePageRss
+*  @brief  Get the resident memory of the process backed by huge pages
+*
+*  @return size_t : bytes in transparent huge pages, 0 where unknown
+*******************************************************************************
+*/
+size_t getHugePageRss()
+{
+#ifdef __linux__
+    FILE *smaps = fopen("/proc/self/smaps_rollup", "r");
+    if (smaps == NULL)
+        return 0;
+    char line[256];
+    unsigned long kb = 0;
+    while (fgets(line, sizeof(line), smaps) != NULL)
+    {
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+            break;
+    }
+    fclose(smaps);
+    return (size_t)kb * 1024;
+#else
+    return 0;
+#endif
+}
+/**
+*******************************************************************************
 *  @fn     initOpenCl
 *  @brief  This function creates the opencl context and command queue
 *
@@ -153,6 +292,11 @@ bool initOpenCl(DeviceInfo *infoDeviceOcl, cl_uint deviceNum)
 	}
 #endif
 
+    /* Kernel variant and launch shape are chosen based on the device type */
+    err = clGetDeviceInfo(infoDeviceOcl->mDevice, CL_DEVICE_TYPE, sizeof(cl_device_type),
+                    &infoDeviceOcl->mDeviceType, NULL);
+    CHECK_RESULT(err != CL_SUCCESS, "clGetDeviceInfo failed. Error code = %d", err);
+
     props[1] = (cl_context_properties)platform;
     infoDeviceOcl->mCtx = clCreateContext(props, 1, &infoDeviceOcl->mDevice, NULL, NULL, &err);
     CHECK_RESULT(err != CL_SUCCESS, "clCreateContext failed. Err code = %d", err);
@@ -0,0 +1,274 @@
+/*******************************************************************************
+Copyright 2015 Advanced Micro Devices, Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1   Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+2   Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+/**
+********************************************************************************
+* @file <y4mIO.cpp>
+*
+* @brief Reads and writes YUV4MPEG2 (Y4M) video streams frame by frame. The
+*        planes of a frame are read straight into, and written straight from,
+*        pitched plane buffers.
+*
+********************************************************************************
+*/
+#include "y4mIO.h"
+#include <string.h>
+#include <stdlib.h>
+
+/**
+*******************************************************************************
+*  @fn     parseY4mColorspace
+*  @brief  Sets the plane sizes and sample depth from the C parameter, e.g.
+*          420jpeg, 422, 444p10 or mono
+*
+*  @param[in] colorspace  : value of the C parameter
+*  @param[in/out] y4m     : stream with width and height set
+*
+*  @return bool : true if the colorspace is supported; otherwise false.
+*******************************************************************************
+*/
+static bool parseY4mColorspace(const char *colorspace, Y4mStream *y4m)
+{
+    cl_uint chromaWidth, chromaHeight;
+    const char *depth;
+
+    if (strncmp(colorspace, "mono", 4) == 0)
+    {
+        y4m->numPlanes = 1;
+        depth = colorspace + 4;
+        chromaWidth = chromaHeight = 0;
+    }
+    else
+    {
+        y4m->numPlanes = 3;
+        depth = colorspace + 3;
+        if (strncmp(colorspace, "420", 3) == 0)
+        {
+            chromaWidth = (y4m->width + 1) / 2;
+            chromaHeight = (y4m->height + 1) / 2;
+        }
+        else if (strncmp(colorspace, "422", 3) == 0)
+        {
+            chromaWidth = (y4m->width + 1) / 2;
+            chromaHeight = y4m->height;
+        }
+        else if (strncmp(colorspace, "444", 3) == 0)
+        {
+            chromaWidth = y4m->width;
+            chromaHeight = y4m->height;
+        }
+        else
+        {
+            CHECK_RESULT(true, "Y4M colorspace %s is not supported", colorspace);
+        }
+        /* 420jpeg, 420paldv and 420mpeg2 only differ in chroma siting */
+        if (*depth == 'p')
+            depth++;
+        else if (strcmp(depth, "jpeg") == 0 || strcmp(depth, "paldv") == 0
+                        || strcmp(depth, "mpeg2") == 0)
+            depth += strlen(depth);
+    }
+
+    y4m->sampleBits = (*depth != '\0') ? atoi(depth) : 8;
+    CHECK_RESULT(y4m->sampleBits < 8 || y4m->sampleBits > 16,
+                    "Y4M colorspace %s is not supported", colorspace);
+    y4m->bytesPerSample = (y4m->sampleBits > 8) ? 2 : 1;
+
+    y4m->planeWidth[0] = y4m->width;
+    y4m->planeHeight[0] = y4m->height;
+    for (cl_uint p = 1; p < Y4M_MAX_PLANES; p++)
+    {
+        y4m->planeWidth[p] = chromaWidth;
+        y4m->planeHeight[p] = chromaHeight;
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     openY4m
+*  @brief  Opens a Y4M stream and parses its header. Frames are not read.
+*
+*  @param[in] filename  : Y4M file or pipe name
+*  @param[out] y4m      : stream
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool openY4m(const char *filename, Y4mStream *y4m)
+{
+    memset(y4m, 0, sizeof(*y4m));
+    y4m->fp = fopen(filename, "rb");
+    CHECK_RESULT(y4m->fp == NULL, "Unable to open %s", filename);
+
+    if (fgets(y4m->header, Y4M_MAX_HEADER, y4m->fp) == NULL
+                    || strncmp(y4m->header, "YUV4MPEG2 ", 10) != 0
+                    || strchr(y4m->header, '\n') == NULL)
+    {
+        fclose(y4m->fp);
+        CHECK_RESULT(true, "%s is not a Y4M file", filename);
+    }
+
+    /* Parameters are space separated, each a tag letter and a value */
+    char params[Y4M_MAX_HEADER];
+    const char *colorspace = "420jpeg";
+    strcpy(params, y4m->header + 10);
+    for (char *param = strtok(params, " \n"); param != NULL; param = strtok(NULL, " \n"))
+    {
+        if (param[0] == 'W')
+            y4m->width = atoi(param + 1);
+        else if (param[0] == 'H')
+            y4m->height = atoi(param + 1);
+        else if (param[0] == 'C')
+            colorspace = param + 1;
+    }
+
+    if (y4m->width == 0 || y4m->height == 0 || !parseY4mColorspace(colorspace, y4m))
+    {
+        fclose(y4m->fp);
+        CHECK_RESULT(true, "Unsupported Y4M header in %s", filename);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     readY4mFrame
+*  @brief  Reads the next frame. Rows of plane p are stored pitches[p] 
+*          samples apart starting at planes[p].
+*
+*  @param[in/out] y4m      : stream
+*  @param[in] planes       : destination of each plane
+*  @param[in] pitches      : row pitch of each plane, in samples
+*  @param[out] endOfStream : set when there are no more frames
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool readY4mFrame(Y4mStream *y4m, cl_uchar *planes[Y4M_MAX_PLANES],
+                const cl_uint pitches[Y4M_MAX_PLANES], bool *endOfStream)
+{
+    char line[Y4M_MAX_HEADER];
+
+    *endOfStream = false;
+    if (fgets(line, sizeof(line), y4m->fp) == NULL)
+    {
+        CHECK_RESULT(ferror(y4m->fp), "Error reading the Y4M stream");
+        *endOfStream = true;
+        return true;
+    }
+    CHECK_RESULT(strncmp(line, "FRAME", 5) != 0, "Y4M frame header not found");
+
+    /* Skip frame parameters that do not fit the line buffer */
+    while (strchr(line, '\n') == NULL)
+    {
+        CHECK_RESULT(fgets(line, sizeof(line), y4m->fp) == NULL, "Truncated Y4M frame header");
+    }
+
+    for (cl_uint p = 0; p < y4m->numPlanes; p++)
+    {
+        for (cl_uint row = 0; row < y4m->planeHeight[p]; row++)
+        {
+            cl_uchar *dst = planes[p] + (size_t)row * pitches[p] * y4m->bytesPerSample;
+            CHECK_RESULT(fread(dst, y4m->bytesPerSample, y4m->planeWidth[p], y4m->fp)
+                            != y4m->planeWidth[p], "Truncated Y4M frame");
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     createY4mWriter
+*  @brief  Creates a Y4M stream with the header, and so the frame format, of
+*          another stream
+*
+*  @param[in] filename  : output file or pipe name
+*  @param[in] format    : stream whose header is copied
+*  @param[out] writer   : output stream
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool createY4mWriter(const char *filename, const Y4mStream *format, Y4mStream *writer)
+{
+    *writer = *format;
+    writer->fp = fopen(filename, "wb");
+    CHECK_RESULT(writer->fp == NULL, "Unable to create %s", filename);
+    if (fputs(writer->header, writer->fp) < 0)
+    {
+        closeY4m(writer);
+        CHECK_RESULT(true, "Error writing %s", filename);
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     writeY4mFrame
+*  @brief  Appends a frame. Rows of plane p are read pitches[p] samples apart
+*          starting at planes[p].
+*
+*  @param[in/out] writer  : output stream
+*  @param[in] planes      : source of each plane
+*  @param[in] pitches     : row pitch of each plane, in samples
+*
+*  @return bool : true if successful; otherwise false.
+*******************************************************************************
+*/
+bool writeY4mFrame(Y4mStream *writer, cl_uchar *planes[Y4M_MAX_PLANES],
+                const cl_uint pitches[Y4M_MAX_PLANES])
+{
+    CHECK_RESULT(fputs("FRAME\n", writer->fp) < 0, "Error writing the Y4M stream");
+
+    for (cl_uint p = 0; p < writer->numPlanes; p++)
+    {
+        for (cl_uint row = 0; row < writer->planeHeight[p]; row++)
+        {
+            const cl_uchar *src = planes[p] + (size_t)row * pitches[p] * writer->bytesPerSample;
+            CHECK_RESULT(fwrite(src, writer->bytesPerSample, writer->planeWidth[p], writer->fp)
+                            != writer->planeWidth[p], "Error writing the Y4M stream");
+        }
+    }
+    return true;
+}
+
+/**
+*******************************************************************************
+*  @fn     closeY4m
+*  @brief  Closes a stream opened by openY4m or createY4mWriter
+*
+*  @param[in/out] y4m : stream
+*
+*  @return bool : true if all data reached the file; otherwise false.
+*******************************************************************************
+*/
+bool closeY4m(Y4mStream *y4m)
+{
+    bool closed = true;
+    if (y4m->fp)
+        closed = (fclose(y4m->fp) == 0);
+    y4m->fp = NULL;
+    return closed;
+}